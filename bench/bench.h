@@ -0,0 +1,66 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Minimal benchmark harness. Each result is printed as one JSON object per
+// line so runs can be diffed or collected by scripts.
+namespace bench {
+    // Heap allocations made so far by the whole benchmark binary
+    uint64_t getAllocationCount();
+    
+    // Keep the optimizer from discarding a computed value
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+    
+    // Run `fn` repeatedly for at least `minTimeMs` (and `minIterations`) and
+    // report the mean and worst time and the heap allocations per call.
+    template <typename Fn>
+    void run(const std::string& name, const std::string& param, Fn fn,
+             int minIterations = 5, double minTimeMs = 200.0) {
+        typedef std::chrono::high_resolution_clock Clock;
+        
+        // Warm up caches and any lazily grown buffers
+        fn();
+        
+        long iterations = 0;
+        double totalNs = 0.0;
+        double maxNs = 0.0;
+        uint64_t allocationsBefore = getAllocationCount();
+        
+        while (iterations < minIterations || totalNs < minTimeMs * 1e6) {
+            auto start = Clock::now();
+            fn();
+            auto end = Clock::now();
+            
+            double ns = std::chrono::duration<double, std::nano>(end - start).count();
+            totalNs += ns;
+            if (ns > maxNs) {
+                maxNs = ns;
+            }
+            iterations++;
+        }
+        
+        double allocations = static_cast<double>(getAllocationCount() - allocationsBefore);
+        std::printf("{\"name\":\"%s\",\"param\":\"%s\",\"iterations\":%ld,"
+                    "\"ns_per_op\":%.1f,\"max_ns\":%.1f,\"allocs_per_op\":%.2f}\n",
+                    name.c_str(), param.c_str(), iterations,
+                    totalNs / iterations, maxNs, allocations / iterations);
+        std::fflush(stdout);
+    }
+    
+    // Report a measured quantity that is not a time, such as bytes per tick
+    inline void report(const std::string& name, const std::string& param,
+                       const std::string& metric, double value) {
+        std::printf("{\"name\":\"%s\",\"param\":\"%s\",\"%s\":%.1f}\n",
+                    name.c_str(), param.c_str(), metric.c_str(), value);
+        std::fflush(stdout);
+    }
+}
+
+#endif // BENCH_H
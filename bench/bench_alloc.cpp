@@ -0,0 +1,306 @@
+#include "bench.h"
+#include "game.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Every heap allocation in the benchmark binary goes through these, so a
+// stretch of code can be checked for allocating nothing at all
+namespace {
+    std::atomic<uint64_t> allocations(0);
+    
+    void* allocate(std::size_t size) {
+        allocations++;
+        return std::malloc(size ? size : 1);
+    }
+}
+
+uint64_t bench::getAllocationCount() {
+    return allocations;
+}
+
+void* operator new(std::size_t size) {
+    void* p = allocate(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    const int INTRO_MS = 2100;        // Until the intro takes a key
+    const int WARMUP_MS = 300;        // First frames of play, growing buffers
+    const int STEADY_FRAMES = 1500;   // About a dozen ticks at 1 ms per frame
+    const int STEADY_BOTS = 3;
+    const unsigned int STEADY_SEED = 1;  // Bots and food placed the same way every run
+    
+    // Player one's loop in the growing game: a lap of the rows around the
+    // spawn row of an 80x24 world, which new levels never put obstacles on.
+    // A lap is 124 cells, longer than the snake ever gets here.
+    const int LOOP_LEFT = 10;
+    const int LOOP_RIGHT = 70;
+    const int LOOP_TOP = 11;
+    const int LOOP_BOTTOM = 13;
+    const int GROWING_WARMUP_MOVES = 8;
+    const int GROWING_MOVES = 400;
+    const int FOOD_EVERY_MOVES = 16;  // About 25 meals, the snake growing by 3 each
+    const int MAX_GROWING_FRAMES = 100000;
+    
+    void runFrames(Game& game, int frames) {
+        for (int i = 0; i < frames; i++) {
+            game.runFrame();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    
+    // Heap allocations over STEADY_FRAMES frames, reported under `param`.
+    // Every one of those frames has to be on the `expected` screen, or the
+    // count says nothing about it.
+    bool countAllocations(Game& game, const std::string& param, GameState expected) {
+        uint64_t before = allocations;
+        for (int i = 0; i < STEADY_FRAMES; i++) {
+            runFrames(game, 1);
+            if (game.getState() != expected) {
+                std::fprintf(stderr, "game_steady_allocations: no longer %s after %d frames\n",
+                             param.c_str(), i + 1);
+                return false;
+            }
+        }
+        uint64_t count = allocations - before;
+        
+        bench::report("game_steady_allocations", param, "allocations", static_cast<double>(count));
+        if (count > 0) {
+            std::fprintf(stderr, "game_steady_allocations: %llu heap allocations while %s\n",
+                         static_cast<unsigned long long>(count), param.c_str());
+            return false;
+        }
+        return true;
+    }
+    
+    // The cell after (x, y) going clockwise round the loop
+    void nextOnLoop(int& x, int& y) {
+        if (y == LOOP_TOP && x < LOOP_RIGHT) {
+            x++;
+        } else if (x == LOOP_RIGHT && y < LOOP_BOTTOM) {
+            y++;
+        } else if (y == LOOP_BOTTOM && x > LOOP_LEFT) {
+            x--;
+        } else {
+            y--;
+        }
+    }
+    
+    // Key that keeps a head at (x, y) on the loop, or 0 off its corners
+    int loopKey(int x, int y) {
+        if (y == LOOP_TOP && x == LOOP_RIGHT) {
+            return 's';
+        }
+        if (x == LOOP_RIGHT && y == LOOP_BOTTOM) {
+            return 'a';
+        }
+        if (y == LOOP_BOTTOM && x == LOOP_LEFT) {
+            return 'w';
+        }
+        if (x == LOOP_LEFT && y == LOOP_TOP) {
+            return 'd';
+        }
+        return 0;
+    }
+    
+    // Run a headless game on its own clock until player one has moved
+    // `moves` cells round the loop, dropping food in front of it every
+    // FOOD_EVERY_MOVES moves when `feed` is set. Player one stays a ghost
+    // so the bots cannot end the game early.
+    bool playLoop(Game& game, int moves, bool feed) {
+        const Snake& player = game.getPlayer();
+        int lastX = player.getHeadX();
+        int lastY = player.getHeadY();
+        
+        for (int frame = 0; moves > 0; frame++) {
+            if (frame == MAX_GROWING_FRAMES || game.getState() != GameState::PLAYING) {
+                std::fprintf(stderr, "game_steady_allocations: no longer growing with %d moves to go\n", moves);
+                return false;
+            }
+            
+            int key = loopKey(player.getHeadX(), player.getHeadY());
+            if (key) {
+                game.pressKey(key);
+            }
+            game.runFrame();
+            
+            int delay = game.getFrameDelayMs();
+            game.advanceClock(delay > 0 ? delay : 1);
+            
+            if (player.getHeadX() == lastX && player.getHeadY() == lastY) {
+                continue;
+            }
+            lastX = player.getHeadX();
+            lastY = player.getHeadY();
+            moves--;
+            
+            game.applyItem(ItemKind::GHOST);
+            if (feed && moves % FOOD_EVERY_MOVES == 0) {
+                int x = lastX;
+                int y = lastY;
+                nextOnLoop(x, y);
+                nextOnLoop(x, y);
+                game.placeItem(x, y, ItemKind::FOOD);
+            }
+        }
+        return true;
+    }
+    
+    // Heap allocations over hundreds of moves of a headless game with bots,
+    // player one eating food put in its way and getting many times longer
+    // than it started. None are allowed. The game sets room aside up front
+    // for snake bodies (as many segments as the board holds, fewer for
+    // bots), for the world grid's chunks and for the frames the renderer
+    // holds back. Only going past that room may allocate (a body longer than
+    // its reservation, a world too big to reserve whole, or a terminal
+    // resized larger), and this game does none of those.
+    bool runGrowingPlay(int devNull) {
+        GameOptions options;
+        options.bots = STEADY_BOTS;
+        options.seed = STEADY_SEED;
+        options.headless = true;
+        options.worldWidth = 80;
+        options.worldHeight = 24;
+        Game game(options, devNull);
+        
+        // Past the intro and the menu into a game
+        game.advanceClock(INTRO_MS);
+        game.runFrame();
+        game.pressKey(' ');
+        game.runFrame();
+        game.pressKey('\n');
+        game.runFrame();
+        if (game.getState() != GameState::PLAYING) {
+            std::fprintf(stderr, "game_steady_allocations: the growing game did not start\n");
+            return false;
+        }
+        
+        game.placeSnake(0, LOOP_LEFT + 2, LOOP_TOP, Direction::RIGHT);
+        game.applyItem(ItemKind::GHOST);
+        if (!playLoop(game, GROWING_WARMUP_MOVES, false)) {
+            return false;
+        }
+        
+        size_t startLength = game.getPlayer().getLength();
+        uint64_t before = allocations;
+        if (!playLoop(game, GROWING_MOVES, true)) {
+            return false;
+        }
+        uint64_t count = allocations - before;
+        size_t endLength = game.getPlayer().getLength();
+        
+        bench::report("game_steady_allocations", "growing", "allocations", static_cast<double>(count));
+        if (endLength < startLength * 10) {
+            std::fprintf(stderr, "game_steady_allocations: player one only grew from %zu to %zu segments\n",
+                         startLength, endLength);
+            return false;
+        }
+        if (count > 0) {
+            std::fprintf(stderr, "game_steady_allocations: %llu heap allocations while growing from %zu to %zu segments\n",
+                         static_cast<unsigned long long>(count), startLength, endLength);
+            return false;
+        }
+        return true;
+    }
+    
+    void runFor(Game& game, int ms) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (std::chrono::steady_clock::now() < end) {
+            runFrames(game, 1);
+        }
+    }
+    
+    // Heap allocations while a game plays on its own (the snake moving, bots
+    // steering, food blinking and frames going out to the terminal through
+    // the render thread, as in a real game) and while it sits on the pause
+    // screen
+    bool runSteadyPlay() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            return false;
+        }
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+        
+        // Take whatever the game draws, as a terminal would
+        std::atomic<bool> done(false);
+        std::thread reader([&]() {
+            char data[4096];
+            while (!done) {
+                if (::read(fds[1], data, sizeof(data)) <= 0) {
+                    break;
+                }
+            }
+        });
+        
+        bool ok = true;
+        {
+            GameOptions options;
+            options.bots = STEADY_BOTS;
+            options.seed = STEADY_SEED;
+            Game game(options, fds[0]);
+            game.startRenderThread();
+            
+            // Past the intro and the menu into a game
+            runFor(game, INTRO_MS);
+            ssize_t ignored = ::write(fds[1], " ", 1);
+            runFor(game, 50);
+            ignored = ::write(fds[1], "\r", 1);
+            runFor(game, WARMUP_MS);
+            
+            ok = countAllocations(game, "playing", GameState::PLAYING) && ok;
+            
+            ignored = ::write(fds[1], "p", 1);
+            runFor(game, 50);
+            ok = countAllocations(game, "paused", GameState::PAUSED) && ok;
+            
+            (void)ignored;
+            game.cleanup();
+        }
+        
+        done = true;
+        ::shutdown(fds[0], SHUT_RDWR);
+        reader.join();
+        ::close(fds[0]);
+        ::close(fds[1]);
+        
+        return ok;
+    }
+}
+
+bool runAllocationBenchmarks() {
+    bool ok = runSteadyPlay();
+    
+    int devNull = ::open("/dev/null", O_WRONLY);
+    if (devNull < 0) {
+        return false;
+    }
+    ok = runGrowingPlay(devNull) && ok;
+    ::close(devNull);
+    return ok;
+}
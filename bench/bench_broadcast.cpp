@@ -0,0 +1,175 @@
+#include "bench.h"
+#include "net_socket.h"
+#include "renderer.h"
+#include "spectator_broadcast.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    const int SCREEN_WIDTH = 80;
+    const int SCREEN_HEIGHT = 24;
+    const int FRAMES = 2000;
+    
+    // A score line and a snake-like run of cells that moves every frame
+    template <typename DrawFn>
+    void drawScene(int frame, DrawFn draw) {
+        std::string score = "Score: " + std::to_string(frame * 7);
+        for (size_t i = 0; i < score.size(); i++) {
+            draw(1 + static_cast<int>(i), 0, score[i]);
+        }
+        for (int i = 0; i < 40; i++) {
+            draw(1 + (frame + i) % (SCREEN_WIDTH - 2), 2 + (frame / 4 + i / 8) % (SCREEN_HEIGHT - 3), 'o');
+        }
+    }
+    
+    // What a viewer's terminal shows, rebuilt from the cursor moves, screen
+    // clears and plain characters the Renderer sends
+    struct ViewerScreen {
+        int fd;
+        std::vector<std::string> rows;
+        std::string pending;
+        int x;
+        int y;
+        
+        explicit ViewerScreen(int fd)
+            : fd(fd),
+              rows(SCREEN_HEIGHT, std::string(SCREEN_WIDTH, ' ')),
+              x(0),
+              y(0) {
+        }
+        
+        void drain() {
+            char data[65536];
+            ssize_t count;
+            while ((count = ::read(fd, data, sizeof(data))) > 0) {
+                pending.append(data, static_cast<size_t>(count));
+            }
+            
+            size_t i = 0;
+            while (i < pending.size()) {
+                if (pending[i] != '\033') {
+                    if (y < SCREEN_HEIGHT && x < SCREEN_WIDTH) {
+                        rows[y][x] = pending[i];
+                    }
+                    x++;
+                    i++;
+                    continue;
+                }
+                
+                // Wait for the rest of a split escape sequence
+                size_t end = pending.find_first_of("HJlh", i + 1);
+                if (end == std::string::npos) {
+                    break;
+                }
+                
+                std::string sequence = pending.substr(i + 2, end - i - 2);
+                if (pending[end] == 'H') {
+                    int row = 1, column = 1;
+                    std::sscanf(sequence.c_str(), "%d;%d", &row, &column);
+                    y = row - 1;
+                    x = column - 1;
+                } else if (pending[end] == 'J') {
+                    rows.assign(SCREEN_HEIGHT, std::string(SCREEN_WIDTH, ' '));
+                }
+                i = end + 1;
+            }
+            pending.erase(0, i);
+        }
+    };
+}
+
+bool runBroadcastBenchmarks() {
+    bool ok = true;
+    const int viewerCounts[] = {1, 16, 256};
+    const std::string path = "/tmp/snake_bench_broadcast." + std::to_string(getpid());
+    
+    int devNull = ::open("/dev/null", O_WRONLY);
+    
+    for (int viewerCount : viewerCounts) {
+        std::string param = std::to_string(viewerCount) + " viewers";
+        
+        SpectatorBroadcast broadcast;
+        broadcast.open(path);
+        
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        renderer.setBroadcast(&broadcast);
+        
+        // The last viewer never reads until the end, so it falls behind and
+        // has to be skipped ahead to a keyframe
+        std::vector<ViewerScreen> viewers;
+        for (int i = 0; i < viewerCount; i++) {
+            int fd = connectUnix(path);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            viewers.push_back(ViewerScreen(fd));
+        }
+        
+        std::vector<std::string> expected;
+        double totalNs = 0.0;
+        
+        for (int frame = 0; frame < FRAMES; frame++) {
+            renderer.clear();
+            expected.assign(SCREEN_HEIGHT, std::string(SCREEN_WIDTH, ' '));
+            drawScene(frame, [&](int x, int y, char ch) {
+                renderer.drawChar(x, y, ch);
+                expected[y][x] = ch;
+            });
+            
+            auto start = std::chrono::high_resolution_clock::now();
+            renderer.refresh();
+            auto end = std::chrono::high_resolution_clock::now();
+            totalNs += std::chrono::duration<double, std::nano>(end - start).count();
+            
+            for (int i = 0; i + 1 < viewerCount; i++) {
+                viewers[i].drain();
+            }
+        }
+        
+        std::printf("{\"name\":\"broadcast_frame\",\"param\":\"%s\",\"iterations\":%d,\"ns_per_op\":%.1f}\n",
+                    param.c_str(), FRAMES, totalNs / FRAMES);
+        bench::report("broadcast_bytes_per_viewer_frame", param, "bytes",
+                      static_cast<double>(broadcast.getBytesSent()) / FRAMES / viewerCount);
+        
+        // Let the slow viewer catch up; every viewer must then show exactly
+        // the last frame
+        for (int frame = FRAMES; frame < FRAMES + 4; frame++) {
+            renderer.clear();
+            expected.assign(SCREEN_HEIGHT, std::string(SCREEN_WIDTH, ' '));
+            drawScene(frame, [&](int x, int y, char ch) {
+                renderer.drawChar(x, y, ch);
+                expected[y][x] = ch;
+            });
+            renderer.refresh();
+            
+            for (auto& viewer : viewers) {
+                viewer.drain();
+            }
+        }
+        
+        for (size_t i = 0; i < viewers.size(); i++) {
+            if (viewers[i].rows != expected) {
+                std::fprintf(stderr, "broadcast %s: viewer %d shows the wrong screen\n", param.c_str(), static_cast<int>(i));
+                ok = false;
+                break;
+            }
+        }
+        
+        if (viewerCount > 1 && broadcast.getKeyframesSent() <= viewerCount) {
+            std::fprintf(stderr, "broadcast %s: the slow viewer was never skipped ahead\n", param.c_str());
+            ok = false;
+        }
+        
+        renderer.setBroadcast(nullptr);
+        for (auto& viewer : viewers) {
+            ::close(viewer.fd);
+        }
+    }
+    
+    ::close(devNull);
+    return ok;
+}
@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "high_score_store.h"
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+    const int TABLE_SIZE = 10;
+    
+    std::vector<HighScore> makeTable() {
+        std::vector<HighScore> scores;
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            HighScore entry;
+            entry.name = "Player";
+            entry.score = (TABLE_SIZE - i) * 100;
+            entry.difficulty = static_cast<Difficulty>(i % 4);
+            scores.push_back(entry);
+        }
+        return scores;
+    }
+    
+    bool sameTable(const std::vector<HighScore>& a, const std::vector<HighScore>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].name != b[i].name || a[i].score != b[i].score || a[i].difficulty != b[i].difficulty) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    void putInt(std::string& out, int32_t value) {
+        char bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        out.append(bytes, sizeof(value));
+    }
+    
+    // A table as the game wrote it before the format had a version
+    std::string encodeLegacy(const std::vector<HighScore>& scores, int32_t nameLength) {
+        std::string out;
+        putInt(out, static_cast<int32_t>(scores.size()));
+        for (size_t i = 0; i < scores.size(); i++) {
+            putInt(out, nameLength);
+            out.append(scores[i].name);
+            putInt(out, scores[i].score);
+            putInt(out, static_cast<int32_t>(scores[i].difficulty));
+        }
+        return out;
+    }
+    
+    // Every single flipped byte and every cut-short copy of a good file has
+    // to be turned away, and so does an old file whose name length runs
+    // past its end
+    bool checkCorruption(const std::vector<HighScore>& table) {
+        std::string good = HighScoreStore::encode(table);
+        std::vector<HighScore> scores;
+        bool ok = HighScoreStore::decode(good, scores) && sameTable(scores, table);
+        
+        for (size_t i = 0; i < good.size(); i++) {
+            std::string bad = good;
+            bad[i] = static_cast<char>(bad[i] ^ 0x5A);
+            if (HighScoreStore::decode(bad, scores) || !scores.empty()) {
+                std::fprintf(stderr, "high_score_corruption: accepted a flipped byte at %zu\n", i);
+                ok = false;
+            }
+        }
+        for (size_t size = 0; size < good.size(); size++) {
+            if (HighScoreStore::decode(good.substr(0, size), scores)) {
+                std::fprintf(stderr, "high_score_corruption: accepted a file cut to %zu bytes\n", size);
+                ok = false;
+            }
+        }
+        
+        std::string legacy = encodeLegacy(table, 6);
+        if (!HighScoreStore::decode(legacy, scores) || !sameTable(scores, table)) {
+            std::fprintf(stderr, "high_score_corruption: rejected an old-format file\n");
+            ok = false;
+        }
+        if (HighScoreStore::decode(encodeLegacy(table, 1 << 30), scores) ||
+            HighScoreStore::decode(legacy.substr(0, legacy.size() - 1), scores)) {
+            std::fprintf(stderr, "high_score_corruption: accepted a damaged old-format file\n");
+            ok = false;
+        }
+        return ok;
+    }
+}
+
+bool runHighScoreBenchmarks() {
+    std::vector<HighScore> table = makeTable();
+    bool ok = checkCorruption(table);
+    
+    // What game over pays: the save is only handed to the writer thread
+    std::string path = "/tmp/snake_bench_scores_" + std::to_string(::getpid()) + ".dat";
+    {
+        HighScoreStore store(path);
+        bench::run("high_score_save", "async", [&]() { store.save(table); });
+        store.flush();
+        if (store.getFailedWrites() != 0) {
+            std::fprintf(stderr, "high_score_save: %llu writes failed\n",
+                         static_cast<unsigned long long>(store.getFailedWrites()));
+            ok = false;
+        }
+    }
+    
+    // A fresh store has nothing cached and reads the file
+    std::vector<HighScore> loaded;
+    if (!HighScoreStore(path).load(loaded) || !sameTable(loaded, table)) {
+        std::fprintf(stderr, "high_score_save: the file did not read back\n");
+        ok = false;
+    }
+    std::remove(path.c_str());
+    
+    std::string bytes = HighScoreStore::encode(table);
+    bench::run("high_score_load", "decode", [&]() {
+        HighScoreStore::decode(bytes, loaded);
+        bench::doNotOptimize(loaded);
+    });
+    return ok;
+}
@@ -0,0 +1,29 @@
+// Benchmarks for the game's hot paths. Build and run with `make bench`.
+
+bool runMazeBenchmarks();
+bool runNetBenchmarks();
+bool runBroadcastBenchmarks();
+bool runSnakeBenchmarks();
+bool runRenderBenchmarks();
+bool runTerminalBenchmarks();
+bool runTraceBenchmarks();
+bool runAllocationBenchmarks();
+bool runHighScoreBenchmarks();
+bool runRuleChecks();
+
+int main() {
+    bool ok = true;
+    
+    ok = runMazeBenchmarks() && ok;
+    ok = runNetBenchmarks() && ok;
+    ok = runBroadcastBenchmarks() && ok;
+    ok = runSnakeBenchmarks() && ok;
+    ok = runRenderBenchmarks() && ok;
+    ok = runTerminalBenchmarks() && ok;
+    ok = runTraceBenchmarks() && ok;
+    ok = runAllocationBenchmarks() && ok;
+    ok = runHighScoreBenchmarks() && ok;
+    ok = runRuleChecks() && ok;
+    
+    return ok ? 0 : 1;
+}
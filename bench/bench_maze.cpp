@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "maze_generator.h"
+#include "obstacle_layout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const int LEVEL_CHANGES = 5;
+    
+    // Flood fill from the first free cell and check it reaches every free cell
+    bool isFullyConnected(const std::vector<unsigned char>& cells, int width, int height) {
+        std::vector<unsigned char> seen(cells.size(), 0);
+        std::vector<int> stack;
+        int freeCells = 0;
+        int start = -1;
+        
+        for (size_t i = 0; i < cells.size(); i++) {
+            if (!cells[i]) {
+                freeCells++;
+                if (start < 0) {
+                    start = static_cast<int>(i);
+                }
+            }
+        }
+        
+        if (start < 0) {
+            return true;
+        }
+        
+        int reached = 0;
+        stack.push_back(start);
+        seen[start] = 1;
+        
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            reached++;
+            
+            int x = cell % width;
+            int y = cell / width;
+            const int neighbours[4] = {
+                x > 0 ? cell - 1 : -1,
+                x + 1 < width ? cell + 1 : -1,
+                y > 0 ? cell - width : -1,
+                y + 1 < height ? cell + width : -1
+            };
+            
+            for (int n : neighbours) {
+                if (n >= 0 && !cells[n] && !seen[n]) {
+                    seen[n] = 1;
+                    stack.push_back(n);
+                }
+            }
+        }
+        
+        return reached == freeCells;
+    }
+    
+    // A whole level change on a `width` x `height` layout, as the game runs
+    // it: generating the next layout in the background, then taking out the
+    // old walls and putting in the new ones, a frame's share at a time.
+    // Reports the frames a change takes, their total time and the worst
+    // single frame, which is the hitch a player could see. The worst frame
+    // is the median over the changes, so one descheduled frame on a busy
+    // machine does not stand in for the game's own cost.
+    void runLevelChanges(int width, int height) {
+        typedef std::chrono::steady_clock Clock;
+        std::string param = std::to_string(width) + "x" + std::to_string(height);
+        
+        WorldGrid world;
+        ObstacleLayout layout;
+        GridRect region = {1, 1, width, height};
+        auto canPlace = [&world](int x, int y) { return world.get(x, y) == CellType::EMPTY; };
+        
+        double totalNs = 0.0;
+        long frames = 0;
+        std::vector<double> worstNs;
+        for (int change = 0; change <= LEVEL_CHANGES; change++) {
+            layout.prepare(static_cast<unsigned int>(change + 1), region, 0.45f);
+            layout.beginChange();
+            
+            double worst = 0.0;
+            bool done = false;
+            while (!done) {
+                auto start = Clock::now();
+                done = layout.advance(world, canPlace);
+                double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                totalNs += ns;
+                worst = std::max(worst, ns);
+                frames++;
+            }
+            
+            // The first change only fills an empty world; the rest swap walls
+            if (change == 0) {
+                totalNs = 0.0;
+                frames = 0;
+            } else {
+                worstNs.push_back(worst);
+            }
+        }
+        
+        std::sort(worstNs.begin(), worstNs.end());
+        bench::report("level_change", param, "frames", static_cast<double>(frames) / LEVEL_CHANGES);
+        bench::report("level_change", param, "total_us", totalNs / LEVEL_CHANGES / 1000.0);
+        bench::report("level_change", param, "worst_frame_us", worstNs[worstNs.size() / 2] / 1000.0);
+    }
+}
+
+bool runMazeBenchmarks() {
+    bool ok = true;
+    const int sizes[][2] = {
+        {78, 22}, {200, 60}, {500, 500}, {1000, 1000}
+    };
+    
+    MazeGenerator generator;
+    std::vector<unsigned char> cells;
+    
+    for (const auto& size : sizes) {
+        int w = size[0];
+        int h = size[1];
+        std::string param = std::to_string(w) + "x" + std::to_string(h);
+        unsigned int seed = 1;
+        
+        bench::run("maze_generate", param, [&]() {
+            generator.generate(seed++, w, h, 0.45f, cells);
+            bench::doNotOptimize(cells);
+        });
+        
+        if (!isFullyConnected(cells, w, h)) {
+            std::fprintf(stderr, "maze_generate %s: free cells are not connected\n", param.c_str());
+            ok = false;
+        }
+        
+        // Per-frame cost when the game spreads generation over several frames
+        bench::run("maze_advance_slice", param, [&]() {
+            if (generator.isDone()) {
+                generator.start(seed++, w, h, 0.45f);
+            }
+            generator.advance(ObstacleLayout::MAZE_ROWS_PER_FRAME);
+        });
+        
+        runLevelChanges(w, h);
+    }
+    
+    return ok;
+}
@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "net_client.h"
+#include "net_server.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+    const int WORLD_WIDTH = 200;
+    const int WORLD_HEIGHT = 60;
+    
+    // Every cell the client mirrors must match the server's board
+    bool worldsMatch(const WorldGrid& server, const WorldGrid& client) {
+        for (int y = 0; y < WORLD_HEIGHT; y++) {
+            for (int x = 0; x < WORLD_WIDTH; x++) {
+                if (server.get(x, y) != client.get(x, y) || server.getOwner(x, y) != client.getOwner(x, y)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    // One round on loopback: the server ticks, then every client reads its
+    // update, sometimes turns, and acknowledges
+    void runRound(NetServer& server, std::vector<std::unique_ptr<NetClient>>& clients, utils::Random& random) {
+        server.tick();
+        
+        for (auto& client : clients) {
+            client->receive();
+            if (random.nextBelow(4) == 0) {
+                client->sendDirection(static_cast<Direction>(1 + random.nextBelow(4)));
+            }
+            client->tick();
+        }
+        
+        server.receive();
+    }
+}
+
+bool runNetBenchmarks() {
+    bool ok = true;
+    const int clientCounts[] = {1, 8, 32};
+    const int lossPercents[] = {0, 10};
+    
+    for (int clientCount : clientCounts) {
+        for (int loss : lossPercents) {
+            std::string param = std::to_string(clientCount) + " clients, " + std::to_string(loss) + "% loss";
+            
+            NetServer server(WORLD_WIDTH, WORLD_HEIGHT);
+            server.open(0);
+            server.getSocket().setLinkSimulation(loss, 0);
+            
+            NetAddress address;
+            NetAddress::resolve("127.0.0.1", server.getSocket().getPort(), address);
+            
+            std::vector<std::unique_ptr<NetClient>> clients;
+            for (int i = 0; i < clientCount; i++) {
+                clients.emplace_back(new NetClient());
+                clients.back()->connect(address);
+                clients.back()->getSocket().setLinkSimulation(loss, 0);
+            }
+            
+            utils::Random random(static_cast<uint64_t>(clientCount * 100 + loss));
+            
+            // Let everyone join and pick up a keyframe first
+            for (int i = 0; i < 64; i++) {
+                runRound(server, clients, random);
+            }
+            
+            uint64_t bytesBefore = server.getSocket().getBytesSent();
+            uint32_t tickBefore = server.getTick();
+            
+            bench::run("net_server_round", param, [&]() {
+                runRound(server, clients, random);
+            });
+            
+            double ticks = server.getTick() - tickBefore;
+            double bytes = static_cast<double>(server.getSocket().getBytesSent() - bytesBefore);
+            bench::report("net_bytes_per_client_tick", param, "bytes", bytes / ticks / clientCount);
+            
+            // With the link cleaned up, every client must catch up and hold
+            // exactly the server's board
+            server.getSocket().setLinkSimulation(0, 0);
+            for (auto& client : clients) {
+                client->getSocket().setLinkSimulation(0, 0);
+            }
+            for (int i = 0; i < 8; i++) {
+                runRound(server, clients, random);
+            }
+            server.tick();
+            
+            for (auto& client : clients) {
+                client->receive();
+                if (!client->hasServerState() || client->getTick() != server.getTick() ||
+                    !worldsMatch(server.getWorld(), client->getWorld())) {
+                    std::fprintf(stderr, "net %s: client %d is out of sync (tick %u, server %u)\n",
+                                 param.c_str(), client->getPlayerId(), client->getTick(), server.getTick());
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    
+    return ok;
+}
@@ -0,0 +1,388 @@
+#include "bench.h"
+#include "renderer.h"
+#include "world_view.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    const int SCREEN_WIDTH = 80;
+    const int SCREEN_HEIGHT = 24;
+    const int LARGE_WIDTH = 300;
+    const int LARGE_HEIGHT = 100;
+    const int SLOW_FRAMES = 200;
+    const int SLOW_BYTES_PER_MS = 512;  // Roughly a 4 Mbit/s link
+    const int STALE_FRAMES = 1500;
+    const int STALE_WARMUP_FRAMES = 500;  // Until the link's rate is known
+    const int STALE_BYTES_PER_MS = 64;  // A congested SSH session, ~30 screens/s
+    const int VIEW_WORLD_WIDTH = 300;
+    const int VIEW_WORLD_HEIGHT = 100;
+    
+    void drawFrame(Renderer& renderer, int frame) {
+        renderer.clear();
+        renderer.drawBorder();
+        renderer.drawText(1, 0, "Score: " + std::to_string(frame));
+        int width = renderer.getWidth();
+        int height = renderer.getHeight();
+        for (int i = 0; i < 40; i++) {
+            renderer.drawChar(1 + (frame + i) % (width - 2), 1 + (frame / 4 + i / 8) % (height - 2), 'o');
+        }
+    }
+    
+    // The same frame with the border and score line in cached layers, as the
+    // game draws it; the score only changes every tenth frame
+    void drawLayeredFrame(Renderer& renderer, int frame) {
+        renderer.clear();
+        if (renderer.beginLayer(Layer::BACKGROUND, LayerKey())) {
+            renderer.drawBorder();
+            renderer.endLayer();
+        }
+        if (renderer.beginLayer(Layer::OVERLAY, LayerKey(frame / 10))) {
+            renderer.drawText(1, 0, "Score: " + std::to_string(frame / 10));
+            renderer.endLayer();
+        }
+        int width = renderer.getWidth();
+        int height = renderer.getHeight();
+        for (int i = 0; i < 40; i++) {
+            renderer.drawChar(1 + (frame + i) % (width - 2), 1 + (frame / 4 + i / 8) % (height - 2), 'o');
+        }
+    }
+    
+    // Scenery for a world scrolling under the camera: obstacles on a
+    // diagonal grid, so every cell that scrolls into view has to be looked up
+    char sceneryAt(int x, int y) {
+        return (x + 2 * y) % 7 == 0 ? '#' : ' ';
+    }
+    
+    // The background as the game keeps it while the camera follows the
+    // snake one cell per tick: either drawn in full every frame, or
+    // scrolled with only the new column and three damaged cells drawn
+    void drawScrollingBackground(Renderer& renderer, int frame, bool patch) {
+        int width = renderer.getWidth();
+        int height = renderer.getHeight();
+        renderer.clear();
+        renderer.setViewport(frame, 0);
+        if (patch && renderer.patchLayer(Layer::BACKGROUND, LayerKey())) {
+            renderer.scrollLayer(Layer::BACKGROUND, 1, 0);
+            for (int y = 0; y < height; y++) {
+                renderer.drawWorldChar(frame + width - 1, y, sceneryAt(frame + width - 1, y));
+            }
+            for (int i = 0; i < 3; i++) {
+                renderer.drawWorldChar(frame + width / 2 + i, height / 2, 'o');
+            }
+            renderer.endLayer();
+        } else {
+            if (!patch) {
+                renderer.invalidateLayer(Layer::BACKGROUND);
+            }
+            renderer.beginLayer(Layer::BACKGROUND, LayerKey());
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    renderer.drawWorldChar(frame + x, y, sceneryAt(frame + x, y));
+                }
+            }
+            renderer.endLayer();
+        }
+    }
+    
+    // The game's background drawn in full for one viewport of a world with
+    // walls and two snakes in it: cell by cell through drawWorldChar() as it
+    // used to be, and a row at a time by drawWorldView()
+    void runWorldViewBenchmarks(int devNull, int width, int height) {
+        WorldGrid world;
+        for (int y = 1; y < VIEW_WORLD_HEIGHT - 1; y++) {
+            for (int x = 1; x < VIEW_WORLD_WIDTH - 1; x++) {
+                if (sceneryAt(x, y) == '#') {
+                    world.set(x, y, CellType::OBSTACLE);
+                } else if (y % 10 == 5) {
+                    world.setSnake(x, y, (x / 40) % 2);
+                }
+            }
+        }
+        std::vector<char> ownerChars = {'o', '~'};
+        
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(width, height);
+        renderer.setViewport(VIEW_WORLD_WIDTH / 2 - width / 2, VIEW_WORLD_HEIGHT / 2 - height / 2);
+        std::string size = std::to_string(width) + "x" + std::to_string(height);
+        
+        bench::run("render_world_view", size + " per cell", [&]() {
+            renderer.clear();
+            renderer.drawWorldBorder(VIEW_WORLD_WIDTH, VIEW_WORLD_HEIGHT);
+            GridRect view = {renderer.getViewX(), renderer.getViewY(), width, height};
+            world.forEachInRect(view, [&](int x, int y, CellType type, int owner) {
+                renderer.drawWorldChar(x, y, type == CellType::OBSTACLE ? '#' : ownerChars[owner]);
+            });
+        });
+        
+        bench::run("render_world_view", size + " rows", [&]() {
+            renderer.clear();
+            drawWorldView(renderer, world, VIEW_WORLD_WIDTH, VIEW_WORLD_HEIGHT, ownerChars);
+        });
+    }
+    
+    // Time spent inside refresh() per frame when the terminal only takes a
+    // trickle of bytes, with and without the render thread
+    void runSlowTerminal(bool threaded) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            return;
+        }
+        
+        std::atomic<bool> done(false);
+        std::thread reader([&]() {
+            char data[SLOW_BYTES_PER_MS];
+            while (!done) {
+                if (::read(fds[0], data, sizeof(data)) <= 0) {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        
+        double totalNs = 0.0;
+        double maxNs = 0.0;
+        uint64_t dropped = 0;
+        {
+            Renderer renderer;
+            renderer.setOutput(fds[1]);
+            renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+            if (threaded) {
+                renderer.startRenderThread();
+            }
+            
+            for (int frame = 0; frame < SLOW_FRAMES; frame++) {
+                drawFrame(renderer, frame);
+                
+                auto start = std::chrono::high_resolution_clock::now();
+                renderer.refresh();
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+                totalNs += ns;
+                maxNs = std::max(maxNs, ns);
+                
+                // A game frame's worth of simulation between refreshes
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+            
+            dropped = renderer.getDroppedFrames();
+        }
+        
+        // The reader is still draining, so the render thread has finished
+        done = true;
+        ::close(fds[1]);
+        reader.join();
+        ::close(fds[0]);
+        
+        std::string param = threaded ? "render thread" : "direct";
+        std::printf("{\"name\":\"render_refresh_slow_terminal\",\"param\":\"%s\",\"iterations\":%d,"
+                    "\"ns_per_op\":%.1f,\"max_ns\":%.1f}\n",
+                    param.c_str(), SLOW_FRAMES, totalNs / SLOW_FRAMES, maxNs);
+        bench::report("render_dropped_frames", param, "frames", static_cast<double>(dropped));
+    }
+    
+    // How far behind the game the screen is when a terminal (a pty read in
+    // small slices) takes fewer screens per second than the game draws.
+    // The reader finds the newest "Score: N" it has been sent and compares
+    // it with the frame being drawn right then. The first second, while the
+    // writer learns the link's rate, is left out.
+    void runStaleness(bool threaded) {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+            return;
+        }
+        int slave = ::open(ptsname(master), O_RDWR | O_NOCTTY);
+        if (slave < 0) {
+            ::close(master);
+            return;
+        }
+        
+        struct termios raw;
+        tcgetattr(slave, &raw);
+        cfmakeraw(&raw);
+        tcsetattr(slave, TCSANOW, &raw);
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+        
+        std::atomic<int> drawing(0);
+        std::atomic<bool> measuring(false);
+        std::atomic<bool> done(false);
+        double staleTotal = 0.0;
+        int staleMax = 0;
+        int samples = 0;
+        
+        std::thread reader([&]() {
+            const std::string marker = "Score: ";
+            std::string seen;
+            int lastShown = -1;
+            char data[STALE_BYTES_PER_MS];
+            while (!done) {
+                ssize_t count = ::read(master, data, sizeof(data));
+                if (count > 0) {
+                    seen.append(data, static_cast<size_t>(count));
+                    
+                    // A read is smaller than a screen, so it holds at most
+                    // one complete score
+                    size_t at = seen.rfind(marker);
+                    size_t end = at == std::string::npos ? at : seen.find_first_not_of("0123456789", at + marker.size());
+                    if (end != std::string::npos && end > at + marker.size()) {
+                        int shown = std::atoi(seen.c_str() + at + marker.size());
+                        if (shown != lastShown && measuring) {
+                            int stale = drawing - shown;
+                            staleTotal += stale;
+                            staleMax = std::max(staleMax, stale);
+                            samples++;
+                            lastShown = shown;
+                        }
+                        seen.erase(0, end);
+                    }
+                    
+                    // Keep only what may be the start of the next score
+                    if (seen.size() > marker.size() + 8) {
+                        seen.erase(0, seen.size() - marker.size() - 8);
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        
+        {
+            Renderer renderer;
+            renderer.setOutput(slave);
+            renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+            if (threaded) {
+                renderer.startRenderThread();
+            }
+            
+            // Draw at 500 frames per second, letting held-back output out
+            // between frames as the game loop would
+            for (int frame = 0; frame < STALE_FRAMES; frame++) {
+                drawing = frame;
+                measuring = frame >= STALE_WARMUP_FRAMES;
+                drawFrame(renderer, frame);
+                renderer.refresh();
+                
+                auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(2);
+                while (std::chrono::steady_clock::now() < next) {
+                    int wait = renderer.getOutputWaitMs();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(wait < 0 ? 2 : std::min(wait, 2)));
+                    renderer.flushOutput();
+                }
+            }
+            measuring = false;
+        }
+        
+        // The reader is still draining, so cleanup's last writes got through
+        done = true;
+        reader.join();
+        ::close(slave);
+        ::close(master);
+        
+        std::string param = threaded ? "render thread" : "direct";
+        bench::report("render_staleness", param, "mean_frames", samples > 0 ? staleTotal / samples : 0.0);
+        bench::report("render_staleness", param, "max_frames", static_cast<double>(staleMax));
+        bench::report("render_screens_shown", param, "screens", static_cast<double>(samples));
+    }
+}
+
+bool runRenderBenchmarks() {
+    int devNull = ::open("/dev/null", O_WRONLY);
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        int frame = 0;
+        bench::run("render_refresh", "direct", [&]() {
+            drawFrame(renderer, frame++);
+            renderer.refresh();
+        });
+    }
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        renderer.startRenderThread();
+        int frame = 0;
+        bench::run("render_refresh", "render thread", [&]() {
+            drawFrame(renderer, frame++);
+            renderer.refresh();
+        });
+    }
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(LARGE_WIDTH, LARGE_HEIGHT);
+        int frame = 0;
+        bench::run("render_refresh", "300x100", [&]() {
+            drawFrame(renderer, frame++);
+            renderer.refresh();
+        });
+    }
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        int frame = 0;
+        bench::run("render_refresh", "cached layers", [&]() {
+            drawLayeredFrame(renderer, frame++);
+            renderer.refresh();
+        });
+    }
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(LARGE_WIDTH, LARGE_HEIGHT);
+        int frame = 0;
+        bench::run("render_world_layer", "full redraw 300x100", [&]() {
+            drawScrollingBackground(renderer, frame++, false);
+        });
+    }
+    
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(LARGE_WIDTH, LARGE_HEIGHT);
+        int frame = 0;
+        bench::run("render_world_layer", "scroll + damage 300x100", [&]() {
+            drawScrollingBackground(renderer, frame++, true);
+        });
+    }
+    
+    // A terminal dragged between two sizes it has had before: the screen
+    // block is reused and every frame after a resize is a full redraw
+    {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(LARGE_WIDTH, LARGE_HEIGHT);
+        int frame = 0;
+        bench::run("render_resize", "80x24 <-> 300x100", [&]() {
+            bool large = renderer.getWidth() != LARGE_WIDTH;
+            renderer.resize(large ? LARGE_WIDTH : SCREEN_WIDTH, large ? LARGE_HEIGHT : SCREEN_HEIGHT);
+            drawFrame(renderer, frame++);
+            renderer.refresh();
+        });
+    }
+    
+    runWorldViewBenchmarks(devNull, SCREEN_WIDTH, SCREEN_HEIGHT);
+    runWorldViewBenchmarks(devNull, 120, 40);
+    runWorldViewBenchmarks(devNull, LARGE_WIDTH, LARGE_HEIGHT);
+    
+    ::close(devNull);
+    
+    runSlowTerminal(false);
+    runSlowTerminal(true);
+    runStaleness(false);
+    runStaleness(true);
+    return true;
+}
@@ -0,0 +1,85 @@
+#include "game.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    const int INTRO_MS = 2100;         // Until the intro takes a key
+    const int PLAY_AFTER_GHOST_MS = 10000;
+    const int GHOST_MS = 5000;         // Matches the game's power-up length
+    const int MAX_FRAMES = 100000;
+    
+    // Run frames on the game's own clock until `ms` of it have passed or
+    // the round ends; false if the board's rules were broken on the way
+    bool play(Game& game, int ms) {
+        for (int frame = 0, elapsed = 0; frame < MAX_FRAMES && elapsed < ms; frame++) {
+            game.runFrame();
+            const char* violation = game.checkInvariants();
+            if (violation) {
+                std::fprintf(stderr, "rules: %s\n", violation);
+                return false;
+            }
+            if (game.getState() != GameState::PLAYING) {
+                return true;
+            }
+            
+            int delay = game.getFrameDelayMs();
+            delay = delay > 0 ? delay : 1;
+            game.advanceClock(delay);
+            elapsed += delay;
+        }
+        return true;
+    }
+    
+    // A bot that meets player one head-on while the player is a ghost dies,
+    // and the player plays on once the ghost wears off. The bot runs along
+    // the top row into the player with the other bot's body under it, so
+    // it has nowhere else to go.
+    bool checkGhostHeadOn(int devNull) {
+        GameOptions options;
+        options.bots = 2;
+        options.seed = 1;
+        options.headless = true;
+        options.worldWidth = 80;
+        options.worldHeight = 24;
+        Game game(options, devNull);
+        
+        // Past the intro and the menu into a game
+        game.advanceClock(INTRO_MS);
+        game.runFrame();
+        game.pressKey(' ');
+        game.runFrame();
+        game.pressKey('\n');
+        game.runFrame();
+        if (game.getState() != GameState::PLAYING) {
+            std::fprintf(stderr, "rules_ghost_head_on: the game did not start\n");
+            return false;
+        }
+        
+        game.placeSnake(0, 40, 1, Direction::RIGHT);
+        game.placeSnake(1, 42, 1, Direction::LEFT);
+        game.placeSnake(2, 40, 2, Direction::LEFT);
+        game.applyItem(ItemKind::GHOST);
+        
+        if (!play(game, GHOST_MS + PLAY_AFTER_GHOST_MS)) {
+            return false;
+        }
+        if (game.getState() != GameState::PLAYING) {
+            std::fprintf(stderr, "rules_ghost_head_on: player one died after the ghost wore off, at (%d, %d)\n",
+                         game.getPlayer().getHeadX(), game.getPlayer().getHeadY());
+            return false;
+        }
+        return true;
+    }
+}
+
+bool runRuleChecks() {
+    int devNull = ::open("/dev/null", O_WRONLY);
+    if (devNull < 0) {
+        return false;
+    }
+    
+    bool ok = checkGhostHeadOn(devNull);
+    ::close(devNull);
+    return ok;
+}
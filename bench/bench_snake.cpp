@@ -0,0 +1,253 @@
+#include "bench.h"
+#include "item_pool.h"
+#include "renderer.h"
+#include "snake.h"
+#include "utils.h"
+#include "world_grid.h"
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    const int SNAKE_LENGTHS[] = {16, 256, 4096, 65536};
+    const int FILL_PERCENTS[] = {0, 50, 90, 99};
+    const int ITEM_COUNTS[] = {1, 100, 1000};
+    const int DEATH_DURATION_MS = 1000;  // As the game plays it
+    const int DEATH_FRAME_MS = 10;
+    
+    struct BoardSize {
+        int width;
+        int height;
+    };
+    const BoardSize BOARD_SIZES[] = {{80, 24}, {300, 100}};
+    
+    // A square loop with room for the whole snake. Followed round and
+    // round, the snake keeps its length and never runs into itself.
+    struct Course {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+    
+    Course makeCourse(int length) {
+        int side = length / 4 + 4;
+        Course course = {1, 1, side, side};
+        return course;
+    }
+    
+    void steer(Snake& snake, const Course& course) {
+        int x = snake.getHeadX();
+        int y = snake.getHeadY();
+        switch (snake.getDirection()) {
+            case Direction::RIGHT:
+                if (x >= course.right) {
+                    snake.changeDirection(Direction::DOWN);
+                }
+                break;
+            case Direction::DOWN:
+                if (y >= course.bottom) {
+                    snake.changeDirection(Direction::LEFT);
+                }
+                break;
+            case Direction::LEFT:
+                if (x <= course.left) {
+                    snake.changeDirection(Direction::UP);
+                }
+                break;
+            case Direction::UP:
+                if (y <= course.top) {
+                    snake.changeDirection(Direction::RIGHT);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    // A snake of about `length` segments on the course, with or without a
+    // grid, after one full lap so every grid chunk it touches exists
+    void buildSnake(Snake& snake, WorldGrid* grid, const Course& course, int length) {
+        if (grid) {
+            snake.setGrid(grid, 0);
+        }
+        snake.initialize(course.left + 2, course.top);
+        
+        int pending = 0;  // Segments still to come from grow()
+        while (snake.getLength() < static_cast<size_t>(length)) {
+            if (static_cast<int>(snake.getLength()) + pending < length) {
+                snake.grow();
+                pending += 3;
+            }
+            size_t before = snake.getLength();
+            steer(snake, course);
+            snake.step();
+            if (snake.getLength() > before) {
+                pending--;
+            }
+        }
+        
+        int lap = 2 * (course.right - course.left + course.bottom - course.top);
+        for (int i = 0; i < lap; i++) {
+            steer(snake, course);
+            snake.step();
+        }
+    }
+    
+    std::string lengthParam(int length, const char* variant) {
+        return "length " + std::to_string(length) + " " + variant;
+    }
+    
+    std::string boardParam(const BoardSize& board, const std::string& rest) {
+        return std::to_string(board.width) + "x" + std::to_string(board.height) + " " + rest;
+    }
+    
+    // Movement, self-collision and occupancy queries, answered from the
+    // grid as the game does and by walking the body
+    void runMovementBenchmarks(int length, bool withGrid) {
+        const char* variant = withGrid ? "grid" : "scan";
+        Course course = makeCourse(length);
+        WorldGrid grid;
+        Snake snake;
+        buildSnake(snake, withGrid ? &grid : nullptr, course, length);
+        
+        bench::run("snake_update", lengthParam(length, variant), [&]() {
+            steer(snake, course);
+            snake.update();
+        });
+        
+        bench::run("snake_check_self_collision", lengthParam(length, variant), [&]() {
+            bench::doNotOptimize(snake.checkSelfCollision());
+        });
+        
+        // A cell just off the course, so a scan has to look at every segment
+        bench::run("snake_contains_position", lengthParam(length, variant), [&]() {
+            bench::doNotOptimize(snake.containsPosition(course.right + 1, course.bottom + 1));
+        });
+    }
+    
+    // Blowing up the part of the snake on screen, then every frame of the
+    // death animation in turn, into a screen that is never sent anywhere
+    void runDeathBenchmark(int devNull, const BoardSize& board, int length) {
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(board.width, board.height);
+        
+        Course course = makeCourse(length);
+        WorldGrid grid;
+        Snake snake;
+        buildSnake(snake, &grid, course, length);
+        
+        // The screen as the game would show it, around the head
+        GridRect area = {snake.getHeadX() - board.width / 2 - ParticlePool::MAX_RADIUS,
+                         snake.getHeadY() - board.height / 2 - ParticlePool::MAX_RADIUS,
+                         board.width + 2 * ParticlePool::MAX_RADIUS, board.height + 2 * ParticlePool::MAX_RADIUS};
+        renderer.setViewport(area.x + ParticlePool::MAX_RADIUS, area.y + ParticlePool::MAX_RADIUS);
+        std::string param = boardParam(board, "length " + std::to_string(length));
+        
+        ParticlePool particles;
+        bench::run("snake_emit_death", param, [&]() {
+            particles.clear();
+            snake.emitDeath(particles, area, DEATH_DURATION_MS);
+        });
+        
+        bench::run("snake_render_death", param, [&]() {
+            renderer.clear();
+            particles.advance(DEATH_FRAME_MS);
+            if (particles.getTime() >= DEATH_DURATION_MS) {
+                particles.seek(0);
+            }
+            particles.render(renderer);
+        });
+    }
+    
+    // A snake going round its course on a board scattered with `count`
+    // items off the course: what it ate is one lookup however many there
+    // are, and a frame draws every item through the shared glow table
+    void runItemBenchmark(int devNull, int count) {
+        const BoardSize board = BOARD_SIZES[1];
+        Renderer renderer;
+        renderer.setOutput(devNull);
+        renderer.initialize(board.width, board.height);
+        
+        Course course = makeCourse(SNAKE_LENGTHS[0]);
+        WorldGrid grid;
+        Snake snake;
+        buildSnake(snake, &grid, course, SNAKE_LENGTHS[0]);
+        
+        ItemPool items;
+        items.setGrid(&grid);
+        GridRect area = {course.right + 2, 1, board.width - course.right - 3, board.height - 2};
+        for (int i = 0; i < count; i++) {
+            GridPoint cell;
+            if (grid.findEmptyCell(area, cell)) {
+                items.add(cell.x, cell.y, static_cast<ItemKind>(i % static_cast<int>(ItemKind::COUNT)), 0);
+            }
+        }
+        std::string param = std::to_string(count) + " items";
+        
+        bench::run("snake_check_food_collision", param, [&]() {
+            steer(snake, course);
+            snake.step();
+            bench::doNotOptimize(snake.checkFoodCollision());
+        });
+        
+        bench::run("items_render", param, [&]() {
+            renderer.clear();
+            items.advance(DEATH_FRAME_MS);
+            items.render(renderer);
+        });
+        
+        // Eating the oldest item and placing a new one, as a busy board does
+        bench::run("items_replace", param, [&]() {
+            GridPoint cell = {items.getX(0), items.getY(0)};
+            ItemKind kind = items.getKind(0);
+            items.remove(0);
+            items.add(cell.x, cell.y, kind, 0);
+        });
+    }
+    
+    // Placing food on a board whose inside is this full of obstacles
+    void runFoodBenchmark(const BoardSize& board, int fillPercent) {
+        WorldGrid grid;
+        utils::Random random(static_cast<uint64_t>(fillPercent + 1));
+        for (int y = 1; y < board.height - 1; y++) {
+            for (int x = 1; x < board.width - 1; x++) {
+                if (random.nextBelow(100) < static_cast<uint32_t>(fillPercent)) {
+                    grid.set(x, y, CellType::OBSTACLE);
+                }
+            }
+        }
+        
+        GridRect area = {1, 1, board.width - 2, board.height - 2};
+        bench::run("game_generate_food", boardParam(board, std::to_string(fillPercent) + "% full"), [&]() {
+            GridPoint cell;
+            bench::doNotOptimize(grid.findEmptyCell(area, cell));
+        });
+    }
+}
+
+bool runSnakeBenchmarks() {
+    for (int length : SNAKE_LENGTHS) {
+        runMovementBenchmarks(length, true);
+        runMovementBenchmarks(length, false);
+    }
+    
+    int devNull = ::open("/dev/null", O_WRONLY);
+    for (const BoardSize& board : BOARD_SIZES) {
+        for (int length : SNAKE_LENGTHS) {
+            runDeathBenchmark(devNull, board, length);
+        }
+    }
+    for (int count : ITEM_COUNTS) {
+        runItemBenchmark(devNull, count);
+    }
+    ::close(devNull);
+    
+    for (const BoardSize& board : BOARD_SIZES) {
+        for (int fillPercent : FILL_PERCENTS) {
+            runFoodBenchmark(board, fillPercent);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,244 @@
+#include "bench.h"
+#include "renderer.h"
+#include "virtual_terminal.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    const int GOLDEN_FRAMES = 300;
+    const int MAX_FLUSHES = 1000;  // Per frame, before the output is called stuck
+    const int RESIZE_EVERY = 20;   // Frames between resizes in the resize case
+    const char GOLDEN_TEXT[] = "GOLDEN";
+    const int GOLDEN_X = 10;
+    const int GOLDEN_Y = 5;
+    
+    // Everything the renderer has sent so far, into the terminal
+    void drain(int fd, VirtualTerminal& terminal) {
+        char data[65536];
+        ssize_t count;
+        while ((count = ::read(fd, data, sizeof(data))) > 0) {
+            terminal.feed(data, static_cast<size_t>(count));
+        }
+    }
+    
+    // Show the frame drawn so far, including anything the renderer held
+    // back for a busy terminal
+    bool present(Renderer& renderer, int fd, VirtualTerminal& terminal) {
+        renderer.refresh();
+        drain(fd, terminal);
+        for (int i = 0; renderer.getOutputWaitMs() >= 0; i++) {
+            if (i == MAX_FLUSHES) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(renderer.getOutputWaitMs()));
+            renderer.flushOutput();
+            drain(fd, terminal);
+        }
+        return true;
+    }
+    
+    // Cells where the rebuilt screen differs from the frame the renderer
+    // meant to show; the first is printed if `report` is set
+    int countMismatches(const Renderer& renderer, const VirtualTerminal& terminal, bool report,
+                        const std::string& param, int frame) {
+        if (terminal.getWidth() != renderer.getWidth() || terminal.getHeight() != renderer.getHeight()) {
+            return renderer.getWidth() * renderer.getHeight();
+        }
+        
+        int mismatches = 0;
+        for (int y = 0; y < renderer.getHeight(); y++) {
+            for (int x = 0; x < renderer.getWidth(); x++) {
+                if (terminal.getChar(x, y) != renderer.getChar(x, y)) {
+                    if (report && mismatches == 0) {
+                        std::fprintf(stderr, "terminal_golden %s: frame %d shows '%c' at %d,%d instead of '%c'\n",
+                                     param.c_str(), frame, terminal.getChar(x, y), x, y, renderer.getChar(x, y));
+                    }
+                    mismatches++;
+                }
+            }
+        }
+        return mismatches;
+    }
+    
+    void drawDots(Renderer& renderer, int frame) {
+        int width = renderer.getWidth();
+        int height = renderer.getHeight();
+        for (int i = 0; i < 40; i++) {
+            renderer.drawChar(1 + (frame + i) % (width - 2), 1 + (frame / 4 + i / 8) % (height - 2), 'o');
+        }
+    }
+    
+    // A plain frame like the game's, with text at a known place
+    void drawPlainFrame(Renderer& renderer, VirtualTerminal&, int frame) {
+        renderer.clear();
+        renderer.drawBorder();
+        renderer.drawText(1, 0, "Score: " + std::to_string(frame));
+        renderer.drawText(GOLDEN_X, GOLDEN_Y, GOLDEN_TEXT);
+        drawDots(renderer, frame);
+    }
+    
+    // Border and score from cached layers, with a menu box over the play
+    // area for a stretch of frames
+    void drawLayeredFrame(Renderer& renderer, VirtualTerminal&, int frame) {
+        renderer.clear();
+        if (renderer.beginLayer(Layer::BACKGROUND, LayerKey())) {
+            renderer.drawBorder();
+            renderer.endLayer();
+        }
+        drawDots(renderer, frame);
+        
+        bool menu = frame % 100 >= 50;
+        if (renderer.beginLayer(Layer::OVERLAY, LayerKey(menu ? 1 : 0, frame / 10))) {
+            renderer.drawText(1, 0, "Score: " + std::to_string(frame / 10));
+            if (menu) {
+                renderer.drawRect(20, 8, 40, 8);
+                renderer.drawText(30, 11, "PAUSED");
+            }
+            renderer.endLayer();
+        }
+    }
+    
+    // A world scrolling one column per frame, patched in the background
+    // layer rather than redrawn
+    void drawScrollingFrame(Renderer& renderer, VirtualTerminal&, int frame) {
+        int width = renderer.getWidth();
+        int height = renderer.getHeight();
+        renderer.clear();
+        renderer.setViewport(frame, 0);
+        if (renderer.patchLayer(Layer::BACKGROUND, LayerKey())) {
+            renderer.scrollLayer(Layer::BACKGROUND, 1, 0);
+            for (int y = 0; y < height; y++) {
+                int x = frame + width - 1;
+                renderer.drawWorldChar(x, y, (x + 2 * y) % 7 == 0 ? '#' : ' ');
+            }
+            renderer.endLayer();
+        } else {
+            renderer.beginLayer(Layer::BACKGROUND, LayerKey());
+            for (int y = 0; y < height; y++) {
+                for (int x = frame; x < frame + width; x++) {
+                    renderer.drawWorldChar(x, y, (x + 2 * y) % 7 == 0 ? '#' : ' ');
+                }
+            }
+            renderer.endLayer();
+        }
+        renderer.setViewport(0, 0);
+        drawDots(renderer, frame);
+    }
+    
+    // The terminal window changes size every so often, as a user dragging
+    // it would, and the renderer follows
+    void drawResizingFrame(Renderer& renderer, VirtualTerminal& terminal, int frame) {
+        if (frame > 0 && frame % RESIZE_EVERY == 0) {
+            bool large = renderer.getWidth() == 80;
+            int width = large ? 120 : 80;
+            int height = large ? 40 : 24;
+            terminal.resize(width, height);
+            renderer.resize(width, height);
+        }
+        drawPlainFrame(renderer, terminal, frame);
+    }
+    
+    // Renders GOLDEN_FRAMES frames into a virtual terminal, checks every
+    // rebuilt screen against the frame that was drawn, and reports what
+    // the output cost per frame
+    template <typename Draw>
+    bool runGolden(const std::string& param, int width, int height, Draw draw) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            return false;
+        }
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+        
+        VirtualTerminal terminal(width, height);
+        TerminalStats total;
+        int mismatchedFrames = 0;
+        bool ok = true;
+        {
+            Renderer renderer;
+            renderer.setOutput(fds[0]);
+            renderer.initialize(width, height);
+            drain(fds[1], terminal);
+            if (!terminal.isAlternateScreen() || terminal.isCursorVisible()) {
+                std::fprintf(stderr, "terminal_golden %s: not on a hidden-cursor alternate screen\n", param.c_str());
+                ok = false;
+            }
+            
+            for (int frame = 0; frame < GOLDEN_FRAMES; frame++) {
+                terminal.resetStats();
+                draw(renderer, terminal, frame);
+                if (!present(renderer, fds[1], terminal)) {
+                    std::fprintf(stderr, "terminal_golden %s: output stuck at frame %d\n", param.c_str(), frame);
+                    ok = false;
+                    break;
+                }
+                
+                const TerminalStats& stats = terminal.getStats();
+                total.bytes += stats.bytes;
+                total.escapeSequences += stats.escapeSequences;
+                total.cursorMoves += stats.cursorMoves;
+                total.printed += stats.printed;
+                total.unsupported += stats.unsupported;
+                
+                if (countMismatches(renderer, terminal, mismatchedFrames == 0, param, frame) > 0 || terminal.isSynchronized()) {
+                    mismatchedFrames++;
+                }
+            }
+            
+            // Drawn text lands where it was put, independent of the renderer's
+            // own idea of the screen
+            if (param.find("plain") != std::string::npos &&
+                terminal.getRow(GOLDEN_Y).compare(GOLDEN_X, sizeof(GOLDEN_TEXT) - 1, GOLDEN_TEXT) != 0) {
+                std::fprintf(stderr, "terminal_golden %s: row %d reads \"%s\"\n", param.c_str(), GOLDEN_Y,
+                             terminal.getRow(GOLDEN_Y).c_str());
+                ok = false;
+            }
+            
+            renderer.cleanup();
+            drain(fds[1], terminal);
+            if (terminal.isAlternateScreen() || !terminal.isCursorVisible()) {
+                std::fprintf(stderr, "terminal_golden %s: screen and cursor not restored\n", param.c_str());
+                ok = false;
+            }
+        }
+        ::close(fds[0]);
+        ::close(fds[1]);
+        
+        double frames = GOLDEN_FRAMES;
+        bench::report("terminal_bytes_per_frame", param, "bytes", total.bytes / frames);
+        bench::report("terminal_escapes_per_frame", param, "sequences", total.escapeSequences / frames);
+        bench::report("terminal_cursor_moves_per_frame", param, "moves", total.cursorMoves / frames);
+        bench::report("terminal_cells_printed_per_frame", param, "cells", total.printed / frames);
+        bench::report("terminal_golden_mismatches", param, "frames", static_cast<double>(mismatchedFrames));
+        if (total.unsupported > 0) {
+            std::fprintf(stderr, "terminal_golden %s: %llu sequences the terminal did not understand\n",
+                         param.c_str(), static_cast<unsigned long long>(total.unsupported));
+            ok = false;
+        }
+        return ok && mismatchedFrames == 0;
+    }
+}
+
+bool runTerminalBenchmarks() {
+    bool ok = true;
+    ok = runGolden("80x24 plain", 80, 24, drawPlainFrame) && ok;
+    ok = runGolden("80x24 cached layers", 80, 24, drawLayeredFrame) && ok;
+    ok = runGolden("300x100 scrolling world", 300, 100, drawScrollingFrame) && ok;
+    ok = runGolden("80x24 <-> 120x40 resizing plain", 80, 24, drawResizingFrame) && ok;
+    
+    // Rebuilding the screen from a full 300x100 frame
+    std::string frame = "\033[?2026h\033[2J";
+    for (int y = 0; y < 100; y++) {
+        frame += "\033[" + std::to_string(y + 1) + ";1H" + std::string(300, static_cast<char>('a' + y % 26));
+    }
+    frame += "\033[?2026l";
+    VirtualTerminal terminal(300, 100);
+    bench::run("terminal_feed", "300x100 full frame", [&]() {
+        terminal.feed(frame);
+    });
+    return ok;
+}
@@ -0,0 +1,29 @@
+#include "bench.h"
+#include "trace_recorder.h"
+#include <chrono>
+
+namespace {
+    const int SCOPES = 1000000;
+    
+    // Mean cost of one recorded event: a begin and an end per scope
+    double measureScopes() {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < SCOPES; i++) {
+            TRACE_SCOPE("bench");
+            bench::doNotOptimize(i);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return ns / (2.0 * SCOPES);
+    }
+}
+
+bool runTraceBenchmarks() {
+    bench::report("trace_event", "disabled", "ns_per_event", measureScopes());
+    
+    // The first event on a thread sets up its ring
+    TraceRecorder::start();
+    TraceRecorder::begin("warmup");
+    bench::report("trace_event", "enabled", "ns_per_event", measureScopes());
+    TraceRecorder::stop();
+    return true;
+}
@@ -0,0 +1,267 @@
+#include "arcade_daemon.h"
+#include "net_socket.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+const char DETACH_KEY = 0x03;  // Ctrl-C in the relay's raw terminal
+
+namespace {
+    void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    
+    // Write everything, waiting for a blocking descriptor as needed
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t result = ::write(fd, data, size);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            data += result;
+            size -= static_cast<size_t>(result);
+        }
+        return true;
+    }
+}
+
+ArcadeDaemon::ArcadeDaemon(const GameOptions& options, int maxSessions)
+    : options(options),
+      maxSessions(maxSessions),
+      listener(-1),
+      running(0) {
+}
+
+ArcadeDaemon::~ArcadeDaemon() {
+    for (auto& session : sessions) {
+        closeSession(session);
+    }
+    
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+    }
+}
+
+void ArcadeDaemon::open(const std::string& path) {
+    listener = listenUnix(path);
+    socketPath = path;
+    
+    // A player closing their terminal mid-frame must not kill everyone else
+    signal(SIGPIPE, SIG_IGN);
+    
+    // Every session is one descriptor; ask for as many as we are allowed
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+void ArcadeDaemon::run() {
+    running = 1;
+    
+    std::cerr << "Arcade listening on " << socketPath
+              << " (up to " << maxSessions << " sessions)" << std::endl;
+    
+    while (running) {
+        // Sessions are only polled for keys while their screen reads them
+        // (and not again until a frame has read what is waiting), and the
+        // loop sleeps until the first moment any session's screen changes
+        pollFds.resize(sessions.size() + 1);
+        pollFds[0].fd = listener;
+        pollFds[0].events = POLLIN;
+        pollFds[0].revents = 0;
+        
+        int timeout = -1;
+        for (size_t i = 0; i < sessions.size(); i++) {
+            Session& session = sessions[i];
+            bool wantsKeys = !session.inputPending && session.game->getInputDescriptor() >= 0;
+            pollFds[i + 1].fd = session.fd;
+            pollFds[i + 1].events = wantsKeys ? POLLIN : 0;
+            pollFds[i + 1].revents = 0;
+            
+            int delay = session.inputPending ? 0 : session.game->getFrameDelayMs();
+            if (delay >= 0 && (timeout < 0 || delay < timeout)) {
+                timeout = delay;
+            }
+        }
+        
+        if (::poll(pollFds.data(), pollFds.size(), timeout) < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+        }
+        
+        for (size_t i = 0; i < sessions.size(); i++) {
+            if (pollFds[i + 1].revents & (POLLHUP | POLLERR)) {
+                sessions[i].hungUp = true;
+            } else if (pollFds[i + 1].revents & POLLIN) {
+                sessions[i].inputPending = true;
+            }
+        }
+        
+        if (pollFds[0].revents & POLLIN) {
+            acceptSessions();
+        }
+        
+        runFrames();
+        closeFinishedSessions();
+    }
+}
+
+void ArcadeDaemon::stop() {
+    running = 0;
+}
+
+int ArcadeDaemon::getSessionCount() const {
+    return static_cast<int>(sessions.size());
+}
+
+void ArcadeDaemon::acceptSessions() {
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            // EAGAIN means the backlog is empty; anything else (such as
+            // running out of descriptors) is retried on the next wakeup
+            return;
+        }
+        
+        if (static_cast<int>(sessions.size()) >= maxSessions) {
+            const char message[] = "The arcade is full, please try again later\n";
+            ssize_t ignored = ::write(fd, message, sizeof(message) - 1);
+            (void)ignored;
+            ::close(fd);
+            continue;
+        }
+        
+        setNonBlocking(fd);
+        
+        Session session;
+        session.fd = fd;
+        session.game.reset(new Game(options, fd));
+        session.inputPending = false;
+        session.hungUp = false;
+        sessions.push_back(std::move(session));
+    }
+}
+
+void ArcadeDaemon::runFrames() {
+    for (auto& session : sessions) {
+        if (session.inputPending || session.game->getFrameDelayMs() == 0) {
+            session.inputPending = false;
+            session.game->runFrame();
+        }
+    }
+}
+
+void ArcadeDaemon::closeFinishedSessions() {
+    size_t kept = 0;
+    
+    for (size_t i = 0; i < sessions.size(); i++) {
+        if (!sessions[i].hungUp && sessions[i].game->isRunning()) {
+            if (kept != i) {
+                sessions[kept] = std::move(sessions[i]);
+            }
+            kept++;
+        } else {
+            closeSession(sessions[i]);
+        }
+    }
+    
+    sessions.resize(kept);
+}
+
+void ArcadeDaemon::closeSession(Session& session) {
+    // The game restores the cursor on its way out, so close afterwards
+    session.game.reset();
+    
+    if (session.fd >= 0) {
+        ::close(session.fd);
+        session.fd = -1;
+    }
+}
+
+int attachToArcade(const std::string& path, bool sendKeys) {
+    int fd = connectUnix(path);
+    
+    // Pass single keystrokes straight through. Output processing stays on,
+    // so the game's plain newlines still return to the first column.
+    termios original;
+    bool isTerminal = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &original) == 0;
+    if (isTerminal) {
+        termios raw = original;
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+    
+    char data[4096];
+    bool inputOpen = true;
+    
+    while (true) {
+        pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = inputOpen ? STDIN_FILENO : -1;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        
+        // Frames from the game
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t count = ::read(fd, data, sizeof(data));
+            if (count <= 0 || !writeAll(STDOUT_FILENO, data, static_cast<size_t>(count))) {
+                break;
+            }
+        }
+        
+        // Keys from the player
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t count = ::read(STDIN_FILENO, data, sizeof(data));
+            if (count <= 0) {
+                // Let the game see the end of input, then wait for it to finish
+                if (sendKeys) {
+                    shutdown(fd, SHUT_WR);
+                }
+                inputOpen = false;
+            } else if (std::memchr(data, DETACH_KEY, static_cast<size_t>(count))) {
+                break;
+            } else if (!sendKeys) {
+                if (std::memchr(data, 'q', static_cast<size_t>(count)) || std::memchr(data, 'Q', static_cast<size_t>(count))) {
+                    break;
+                }
+            } else if (!writeAll(fd, data, static_cast<size_t>(count))) {
+                break;
+            }
+        }
+    }
+    
+    ::close(fd);
+    
+    if (isTerminal) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &original);
+    }
+    
+    // Put the cursor and the user's screen back in case the game could not
+    const char restore[] = "\033[?2026l\033[?25h\033[?1049l\n";
+    writeAll(STDOUT_FILENO, restore, sizeof(restore) - 1);
+    
+    return 0;
+}
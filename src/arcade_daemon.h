@@ -0,0 +1,66 @@
+#ifndef ARCADE_DAEMON_H
+#define ARCADE_DAEMON_H
+
+#include "game.h"
+#include <csignal>
+#include <memory>
+#include <string>
+#include <vector>
+#include <poll.h>
+
+// Hosts many independent games in one process (`snake --daemon PATH`).
+//
+// Players connect to a Unix socket, usually through `snake --attach PATH`
+// from their login shell. Every connection gets its own Game whose Renderer
+// and InputHandler use the connection instead of a terminal. All sessions
+// share a single poll() loop: a session only runs when it has input waiting
+// or its screen is due to change (Game::getFrameDelayMs()), so players
+// sitting in a menu or on the pause screen cost no CPU at all.
+class ArcadeDaemon {
+public:
+    ArcadeDaemon(const GameOptions& options, int maxSessions);
+    ~ArcadeDaemon();
+    
+    // Start listening on `path`, replacing any stale socket file there;
+    // throws std::runtime_error on failure
+    void open(const std::string& path);
+    
+    // Serve sessions until stop() is called
+    void run();
+    
+    // Safe to call from a signal handler
+    void stop();
+    
+    int getSessionCount() const;
+    
+private:
+    struct Session {
+        int fd;
+        std::unique_ptr<Game> game;
+        bool inputPending;  // Keys are waiting; the next frame will read them
+        bool hungUp;
+    };
+    
+    GameOptions options;
+    int maxSessions;
+    int listener;
+    std::string socketPath;
+    volatile std::sig_atomic_t running;
+    
+    std::vector<Session> sessions;
+    std::vector<pollfd> pollFds;  // Reused for every poll() call
+    
+    void acceptSessions();
+    void runFrames();
+    void closeFinishedSessions();
+    void closeSession(Session& session);
+};
+
+// Connect this terminal to a daemon at `path` and relay keys and frames
+// until the game ends. Ctrl-C detaches. Returns the process exit code.
+//
+// With `sendKeys` false the terminal only shows what arrives, which is how
+// `snake --watch` follows a spectator broadcast; Q also detaches then.
+int attachToArcade(const std::string& path, bool sendKeys = true);
+
+#endif // ARCADE_DAEMON_H
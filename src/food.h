@@ -18,9 +18,7 @@ public:
 private:
     int x;
     int y;
-    float animationTime;
-    float blinkRate;   // How fast the food blinks
-    float glowAmount;  // Current glow intensity (0.0 to 1.0)
+    float animationTime;  // Seconds since the food was placed
 };
 
 #endif // FOOD_H
@@ -0,0 +1,130 @@
+#include "frame_profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+const int SUB_BUCKET_BITS = 2;  // Four buckets per power of two
+const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[getBucket(ns)]++;
+    count++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(buckets, buckets + BUCKET_COUNT, 0);
+    count = 0;
+    totalNs = 0;
+    maxNs = 0;
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return count;
+}
+
+uint64_t LatencyHistogram::getMaxNs() const {
+    return maxNs;
+}
+
+double LatencyHistogram::getMeanNs() const {
+    return count > 0 ? static_cast<double>(totalNs) / count : 0.0;
+}
+
+uint64_t LatencyHistogram::getPercentileNs(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    
+    // The sample at this rank (counting from 1) sits in the bucket where
+    // the running total reaches it
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(getBucketHighNs(i), maxNs);
+        }
+    }
+    return maxNs;
+}
+
+uint64_t LatencyHistogram::getBucketCount(int bucket) const {
+    return buckets[bucket];
+}
+
+uint64_t LatencyHistogram::getBucketLowNs(int bucket) {
+    // The first buckets hold one value each; after that, bucket
+    // (power - 1) * 4 + sub starts at (4 + sub) << (power - 2)
+    if (bucket < SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int power = bucket / SUB_BUCKETS + 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % SUB_BUCKETS);
+    return (SUB_BUCKETS + sub) << (power - SUB_BUCKET_BITS);
+}
+
+uint64_t LatencyHistogram::getBucketHighNs(int bucket) {
+    if (bucket + 1 >= BUCKET_COUNT) {
+        return UINT64_MAX;
+    }
+    return getBucketLowNs(bucket + 1);
+}
+
+int LatencyHistogram::getBucket(uint64_t ns) {
+    if (ns < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(ns);
+    }
+    
+    // The highest set bit picks the power of two, the two bits below it
+    // the quarter within it
+    int power = 63 - __builtin_clzll(ns);
+    int sub = static_cast<int>((ns >> (power - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (power - 1) * SUB_BUCKETS + sub;
+}
+
+void FrameProfiler::record(FramePhase phase, uint64_t ns) {
+    histograms[static_cast<int>(phase)].record(ns);
+}
+
+const LatencyHistogram& FrameProfiler::getHistogram(FramePhase phase) const {
+    return histograms[static_cast<int>(phase)];
+}
+
+const char* FrameProfiler::getPhaseName(FramePhase phase) {
+    switch (phase) {
+        case FramePhase::INPUT: return "input";
+        case FramePhase::UPDATE: return "update";
+        case FramePhase::RENDER: return "render";
+        case FramePhase::REFRESH: return "refresh";
+        default: return "unknown";
+    }
+}
+
+bool FrameProfiler::writeCsv(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << "phase,bucket_low_ns,bucket_high_ns,count\n";
+    for (int phase = 0; phase < static_cast<int>(FramePhase::COUNT); phase++) {
+        const LatencyHistogram& histogram = histograms[phase];
+        for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+            if (histogram.getBucketCount(i) > 0) {
+                file << getPhaseName(static_cast<FramePhase>(phase)) << ','
+                     << LatencyHistogram::getBucketLowNs(i) << ','
+                     << LatencyHistogram::getBucketHighNs(i) << ','
+                     << histogram.getBucketCount(i) << '\n';
+            }
+        }
+    }
+    
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,103 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Frame timing instrumentation. Build with `make PROFILING=0` to compile
+// every timer out of the game.
+#ifndef SNAKE_PROFILING
+#define SNAKE_PROFILING 1
+#endif
+
+// Parts of a frame that are timed separately
+enum class FramePhase {
+    INPUT,    // Reading keys (Game::processInput)
+    UPDATE,   // Simulation (Game::update)
+    RENDER,   // Drawing the frame into the screen buffer
+    REFRESH,  // Renderer::refresh: compositing and handing it to the terminal
+    COUNT     // Keep this last for counting
+};
+
+// Latency histogram with fixed buckets, four per power of two, so recording
+// is a few instructions and any percentile is known to within a quarter of
+// its value without keeping samples
+class LatencyHistogram {
+public:
+    static const int BUCKET_COUNT = 256;  // Enough for any 64-bit duration
+    
+    LatencyHistogram();
+    
+    void record(uint64_t ns);
+    void clear();
+    
+    uint64_t getCount() const;
+    uint64_t getMaxNs() const;
+    double getMeanNs() const;
+    
+    // Upper end of the bucket holding the `fraction` quantile (0.5 for the
+    // median), but no more than the largest value seen; 0 if empty
+    uint64_t getPercentileNs(double fraction) const;
+    
+    // Samples in bucket `bucket`, which holds values from getBucketLowNs()
+    // up to (but not including) getBucketHighNs()
+    uint64_t getBucketCount(int bucket) const;
+    static uint64_t getBucketLowNs(int bucket);
+    static uint64_t getBucketHighNs(int bucket);
+    
+private:
+    uint64_t buckets[BUCKET_COUNT];
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    
+    static int getBucket(uint64_t ns);
+};
+
+// One histogram per frame phase
+class FrameProfiler {
+public:
+    void record(FramePhase phase, uint64_t ns);
+    const LatencyHistogram& getHistogram(FramePhase phase) const;
+    static const char* getPhaseName(FramePhase phase);
+    
+    // Every phase's histogram as CSV, one row per non-empty bucket; false
+    // if the file could not be written
+    bool writeCsv(const std::string& path) const;
+    
+private:
+    LatencyHistogram histograms[static_cast<int>(FramePhase::COUNT)];
+};
+
+// Records the time from its construction to the end of its scope
+class PhaseTimer {
+public:
+    PhaseTimer(FrameProfiler& frameProfiler, FramePhase timedPhase)
+        : profiler(frameProfiler),
+          phase(timedPhase),
+          start(Clock::now()) {
+    }
+    
+    ~PhaseTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        profiler.record(phase, static_cast<uint64_t>(ns));
+    }
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    FrameProfiler& profiler;
+    FramePhase phase;
+    Clock::time_point start;
+};
+
+// Time the rest of the enclosing scope as `phase`; nothing at all when
+// profiling is compiled out
+#if SNAKE_PROFILING
+#define PROFILE_PHASE(profiler, phase) PhaseTimer phaseTimer(profiler, phase)
+#else
+#define PROFILE_PHASE(profiler, phase) ((void)0)
+#endif
+
+#endif // FRAME_PROFILER_H
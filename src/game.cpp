@@ -1,19 +1,60 @@
 #include "game.h"
+#include "trace_recorder.h"
 #include "utils.h"
-#include <thread>
+#include "world_view.h"
+#include <poll.h>
 #include <algorithm>
 #include <ctime>
-#include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
 
 const std::string HIGH_SCORE_FILE = "snake_high_scores.dat";
 const int MAX_HIGH_SCORES = 10;
 const int INTRO_DURATION_MS = 2000;
 const int FRAME_DELAY_MS = 10;  // 10ms per render frame for smooth animation
+const int DEATH_DURATION_MS = 1000;  // Length of the death animation
+const float INTRO_PULSE_RATE = 0.01f;      // "Press any key" blink, radians per millisecond
+const float GAME_OVER_PULSE_RATE = 0.005f;
+const int OBSTACLE_CLEARANCE = 6;  // Free cells kept ahead of the head on a new level
+const int MAX_MAZE_SIZE = 1000;  // Largest obstacle region generated for one level
+const int DEAD_SEGMENTS_PER_TICK = 4;  // How fast a dead rival's body is cleared away
+const size_t PLAYER_RESERVED_SEGMENTS = 4096;  // Body room set aside per player up front
+const size_t BOT_RESERVED_SEGMENTS = 64;  // Less per bot, as there can be thousands
+const long RESERVED_WORLD_CELLS = 1L << 20;  // Worlds up to this size get every chunk up front
+const int SPAWN_ATTEMPTS = 8;  // Random spots tried per tick when respawning a bot
+const uint32_t BOT_TURN_CHANCE = 40;  // Bots turn on their own about once per this many ticks
+const int POWER_UP_CHANCE = 150;  // A power-up appears about once per this many ticks
+const int MAX_POWER_UPS = 2;      // Power-ups on the board at once
+const int POWER_UP_LIFETIME_MS = 10000;  // How long one waits to be picked up
+const float POWER_UP_SECONDS = 5.0f;     // How long speed and ghost last
+const float SPEED_TICK_FACTOR = 0.6f;    // Tick length while sped up
+const int SHRINK_SEGMENTS = 5;
+const int MIN_SNAKE_LENGTH = 3;  // Shrinking never goes below the starting length
+const int TEXT_SIZE = 128;  // Room for any line of text formatted for the screen
+const char* const PAUSE_TEXT = "GAME PAUSED";
+const char* const CONTINUE_TEXT = "Press P to continue, Q to quit";
+const char* const MENU_TITLE = "TERMINAL SNAKE";
+const char* const MENU_CONTROLS = "Controls: Arrow Keys/WASD - Move, P - Pause, Q - Quit";
+const int MENU_OPTION_COUNT = 5;
+const char* const MENU_OPTIONS[MENU_OPTION_COUNT] = {
+    "Start Game",
+    "Difficulty: ",  // Followed by the current difficulty
+    "High Scores",
+    "How to Play",
+    "Quit"
+};
+const int GAME_OVER_OPTION_COUNT = 2;
+const char* const GAME_OVER_OPTIONS[GAME_OVER_OPTION_COUNT] = {"Play Again", "Return to Menu"};
 
-Game::Game() 
+// Leads every overlay's LayerKey, so one screen's key never matches another's
+enum OverlayContent { HUD_OVERLAY = 1, MENU_OVERLAY, GAME_OVER_OVERLAY };
+
+Game::Game(const GameOptions& options, int sessionFd) 
     : state(GameState::INTRO),
+      drawnState(GameState::INTRO),
       difficulty(Difficulty::MEDIUM),
       score(0),
       highScore(0),
@@ -21,17 +62,77 @@ Game::Game()
       gameSpeed(1.0f),
       level(1),
       frameTime(0.1f),  // Initial frame time (will be adjusted by difficulty)
+      tickCount(0),
+      foodCount(std::max(1, std::min(options.foods, ItemPool::CAPACITY - MAX_POWER_UPS))),
+      speedTimeLeft(0.0f),
+      ghostTimeLeft(0.0f),
+      headless(options.headless),
+      clockTime(std::chrono::high_resolution_clock::now()),
+      introStartTime(clockTime),
+      deathFrameTime(introStartTime),
+      lastFrameTime(introStartTime - std::chrono::milliseconds(FRAME_DELAY_MS)),
+      menuSelection(0),
+      gameOverSelection(0),
+      deathAnimationStarted(false),
+      deathAnimationDone(false),
       width(80),
-      height(24) {
+      height(24),
+      worldWidth(options.worldWidth > 0 ? std::max(options.worldWidth, 80) : 0),
+      worldHeight(options.worldHeight > 0 ? std::max(options.worldHeight, 24) : 0),
+      worldLayerX(0),
+      worldLayerY(0),
+      levelSeed(0),
+      playerHeadOn(false),
+      showProfiler(false),
+      perfCsvPath(options.perfCsvPath),
+      tracePath(options.tracePath) {
+    
+    world.setDamageList(&worldDamage);
+    items.setGrid(&world);
+    snake.setCompactBody(options.packedBody);
+    
+    // Player two (if any) comes first so it always gets id 1
+    int numRivals = std::max(options.players - 1, 0) + std::max(options.bots, 0);
+    rivals.resize(numRivals);
+    ownerChars.assign(numRivals + 1, 'o');
+    for (int i = 0; i < numRivals; i++) {
+        rivals[i].isBot = i >= options.players - 1;
+        ownerChars[i + 1] = rivals[i].isBot ? '~' : '=';
+        rivals[i].alive = false;
+        rivals[i].snake.setCompactBody(options.packedBody);
+        rivals[i].snake.setGrid(&world, i + 1);
+    }
     
     // Seed the random number generator
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    std::srand(options.seed != 0 ? options.seed : static_cast<unsigned int>(std::time(nullptr)));
+    levelSeed = static_cast<unsigned int>(std::rand());
+    botRandom.reseed(levelSeed);
+    
+    if (sessionFd >= 0) {
+        renderer.setOutput(sessionFd);
+        input.attach(sessionFd);
+    }
+    if (headless) {
+        input.useScript();
+    }
+    
+    if (!options.broadcastPath.empty()) {
+        spectators.open(options.broadcastPath);
+        renderer.setBroadcast(&spectators);
+    }
+    
+    if (!tracePath.empty()) {
+        TraceRecorder::setThreadName("game");
+        TraceRecorder::start();
+    }
     
     // Initialize the game components
     initialize();
     
-    // Load high scores
-    loadHighScores();
+    // Load high scores; a headless game keeps its own
+    if (!headless) {
+        loadHighScores();
+    }
 }
 
 Game::~Game() {
@@ -39,61 +140,266 @@ Game::~Game() {
 }
 
 void Game::cleanup() {
+    // Reverse order of initialize(): on a terminal both share one file
+    // description, and the renderer's saved flags are the original ones
+    input.cleanup();
     renderer.cleanup();
+    spectators.close();
+    
+    // Written after the terminal is back to normal, so an error shows
+    if (!perfCsvPath.empty()) {
+        if (!profiler.writeCsv(perfCsvPath)) {
+            std::cerr << "Could not write frame timings to " << perfCsvPath << std::endl;
+        }
+        perfCsvPath.clear();
+    }
+    
+    // The render thread has stopped, so every ring is complete
+    if (!tracePath.empty()) {
+        TraceRecorder::stop();
+        if (!TraceRecorder::writeJson(tracePath)) {
+            std::cerr << "Could not write the trace to " << tracePath << std::endl;
+        }
+        tracePath.clear();
+    }
 }
 
 void Game::run() {
-    // Main game loop
-    while (gameRunning) {
-        auto startTime = std::chrono::high_resolution_clock::now();
-        
-        // Handle game states
-        switch (state) {
-            case GameState::INTRO:
-                handleIntro();
-                break;
-                
-            case GameState::MENU:
-                handleMenu();
-                break;
-                
-            case GameState::PLAYING:
-                handlePlaying();
-                break;
-                
-            case GameState::PAUSED:
-                handlePaused();
-                break;
-                
-            case GameState::GAME_OVER:
-                handleGameOver();
-                break;
-                
-            case GameState::QUIT:
-                gameRunning = false;
-                break;
+    // Main game loop: sleep until a key arrives or the screen is due to
+    // change, so menus and the pause screen use no CPU while nobody types
+    startRenderThread();
+    
+    while (isRunning()) {
+        runFrame();
+        
+        int delay = getFrameDelayMs();
+        if (delay != 0 && isRunning()) {
+            pollfd pfd;
+            pfd.fd = getInputDescriptor();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            TRACE_SCOPE("poll");
+            ::poll(&pfd, 1, delay);
+        }
+    }
+}
+
+void Game::startRenderThread() {
+    renderer.startRenderThread();
+}
+
+void Game::runFrame() {
+    TRACE_SCOPE("Game::runFrame");
+    lastFrameTime = now();
+    
+    // Let out a frame the terminal had no room for earlier
+    renderer.flushOutput();
+    
+    // Lay the screens out for a resized terminal; the camera follows on
+    // the next render
+    if (renderer.updateSize()) {
+        width = renderer.getWidth();
+        height = renderer.getHeight();
+    }
+    
+    // Handle game states
+    drawnState = state;
+    switch (state) {
+        case GameState::INTRO:
+            handleIntro();
+            break;
+        
+        case GameState::MENU:
+            handleMenu();
+            break;
+        
+        case GameState::PLAYING:
+            handlePlaying();
+            break;
+        
+        case GameState::PAUSED:
+            handlePaused();
+            break;
+        
+        case GameState::GAME_OVER:
+            handleGameOver();
+            break;
+        
+        case GameState::QUIT:
+            gameRunning = false;
+            break;
+    }
+}
+
+bool Game::isRunning() const {
+    return gameRunning && !input.isClosed();
+}
+
+namespace {
+    typedef std::chrono::high_resolution_clock Clock;
+    
+    // Whole milliseconds from `now` until `deadline`, rounded up so a
+    // wakeup is never early
+    int millisecondsUntil(Clock::time_point now, Clock::time_point deadline) {
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+        return wait > 0 ? static_cast<int>((wait + 999) / 1000) : 0;
+    }
+    
+    // A pulse that changes colour whenever sin(elapsed * rate) changes sign
+    int millisecondsUntilPulse(Clock::time_point now, Clock::time_point start, float rate) {
+        double halfPeriod = M_PI / rate;
+        double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+        double next = (std::floor(elapsed / halfPeriod) + 1.0) * halfPeriod;
+        return static_cast<int>(std::ceil(next - elapsed));
+    }
+}
+
+int Game::getFrameDelayMs() const {
+    // A slow terminal also sets the pace: come back when it has room for
+    // the newest frame
+    int delay = getScreenDelayMs();
+    int outputDelay = renderer.getOutputWaitMs();
+    if (outputDelay >= 0 && (delay < 0 || outputDelay < delay)) {
+        delay = outputDelay;
+    }
+    return delay;
+}
+
+int Game::getScreenDelayMs() const {
+    // A key that just changed screens leaves the new one still to be drawn
+    if (state != drawnState) {
+        return 0;
+    }
+    
+    Clock::time_point currentTime = now();
+    switch (state) {
+        case GameState::INTRO:
+            if (currentTime - introStartTime < std::chrono::milliseconds(INTRO_DURATION_MS)) {
+                return millisecondsUntil(currentTime, lastFrameTime + std::chrono::milliseconds(FRAME_DELAY_MS));
+            }
+            return millisecondsUntilPulse(currentTime, introStartTime, INTRO_PULSE_RATE);
+        
+        case GameState::PLAYING: {
+            // Nothing moves between ticks, except that obstacles are built
+            // and swapped a slice per frame in the background
+            auto tick = lastUpdateTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(getTickTime()));
+            int delay = millisecondsUntil(currentTime, tick);
+            if (obstacles.isBusy()) {
+                delay = std::min(delay, millisecondsUntil(currentTime, lastFrameTime + std::chrono::milliseconds(FRAME_DELAY_MS)));
+            }
+            return delay;
         }
         
-        // Calculate frame time and sleep if needed
-        auto endTime = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        case GameState::GAME_OVER:
+            if (!deathAnimationDone) {
+                return !deathAnimationStarted ? 0 : millisecondsUntil(currentTime, deathFrameTime + std::chrono::milliseconds(FRAME_DELAY_MS));
+            }
+            return millisecondsUntilPulse(currentTime, lastUpdateTime, GAME_OVER_PULSE_RATE);
         
-        // Ensure we don't render too fast by maintaining a minimum frame time
-        if (elapsed < FRAME_DELAY_MS) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_DELAY_MS - elapsed));
+        case GameState::QUIT:
+            return 0;
+        
+        default:
+            return -1;
+    }
+}
+
+int Game::getInputDescriptor() const {
+    // Keys pressed during the intro fade stay queued for the menu, so there
+    // is no point waking up for them. The death animation can be skipped.
+    bool animating = state == GameState::INTRO && now() - introStartTime < std::chrono::milliseconds(INTRO_DURATION_MS);
+    return animating ? -1 : input.getDescriptor();
+}
+
+void Game::pressKey(int key) {
+    input.pressKey(key);
+}
+
+void Game::advanceClock(int milliseconds) {
+    clockTime += std::chrono::milliseconds(milliseconds);
+}
+
+void Game::placeSnake(int id, int x, int y, Direction direction) {
+    getSnakeById(id).initialize(x, y, direction);
+    if (id != snake.getId()) {
+        rivals[id - 1].alive = true;
+    }
+}
+
+bool Game::placeItem(int x, int y, ItemKind kind) {
+    if (isOutOfBounds(x, y) || !isCellFree(x, y)) {
+        return false;
+    }
+    return items.add(x, y, kind, kind == ItemKind::FOOD ? 0 : POWER_UP_LIFETIME_MS) != WorldGrid::NO_ITEM;
+}
+
+GameState Game::getState() const {
+    return state;
+}
+
+int Game::getScore() const {
+    return score;
+}
+
+uint64_t Game::getTickCount() const {
+    return tickCount;
+}
+
+const Snake& Game::getPlayer() const {
+    return snake;
+}
+
+const ItemPool& Game::getItems() const {
+    return items;
+}
+
+const char* Game::checkInvariants() const {
+    // Each item's cell names its slot, until a snake moves onto it; the item
+    // is eaten on that same tick, so none is ever left under a snake
+    for (size_t i = 0; i < items.size(); i++) {
+        int slot = static_cast<int>(i);
+        if (world.getItem(items.getX(slot), items.getY(slot)) != slot) {
+            return "item missing from the grid";
         }
     }
+    
+    // Hitting the border ends the round on the same tick
+    if ((state == GameState::PLAYING || state == GameState::PAUSED) &&
+        isOutOfBounds(snake.getHeadX(), snake.getHeadY())) {
+        return "head outside the border";
+    }
+    return nullptr;
+}
+
+Clock::time_point Game::now() const {
+    return headless ? clockTime : Clock::now();
 }
 
 void Game::initialize() {
-    // Initialize renderer
+    // Initialize renderer; it fills the terminal, or stays 80x24 without one
     renderer.initialize(width, height);
+    width = renderer.getWidth();
+    height = renderer.getHeight();
+    
+    // A world without a size of its own is as big as the screen
+    if (worldWidth <= 0 || worldHeight <= 0) {
+        worldWidth = std::max(width, 80);
+        worldHeight = std::max(height, 24);
+    }
     
     // Set up input handler
     input.initialize();
     
+    // Bodies up to the board's size (within a cap) grow without allocating
+    size_t area = static_cast<size_t>(worldWidth - 2) * static_cast<size_t>(worldHeight - 2);
+    snake.reserve(std::min(area, PLAYER_RESERVED_SEGMENTS));
+    for (auto& rival : rivals) {
+        rival.snake.reserve(std::min(area, rival.isBot ? BOT_RESERVED_SEGMENTS : PLAYER_RESERVED_SEGMENTS));
+    }
+    
     // Set initial snake position and direction
-    snake.initialize(width / 2, height / 2);
+    snake.setGrid(&world);
+    snake.initialize(worldWidth / 2, worldHeight / 2);
     
     // Generate initial food
     generateFood();
@@ -102,7 +408,7 @@ void Game::initialize() {
     updateDifficulty(difficulty);
     
     // Initialize timing
-    lastUpdateTime = std::chrono::high_resolution_clock::now();
+    lastUpdateTime = now();
 }
 
 void Game::processInput() {
@@ -112,43 +418,62 @@ void Game::processInput() {
         snake.changeDirection(dir);
     }
     
-    // Check for pause
+    // Player two steers with its own keys
+    if (!rivals.empty() && !rivals[0].isBot) {
+        Direction dir2 = input.getSecondPlayerDirection();
+        if (dir2 != Direction::NONE) {
+            rivals[0].snake.changeDirection(dir2);
+        }
+    }
+    
+    // Check for pause; the key is used up, or the pause screen would take
+    // it as the key to carry on
     if (input.isPausePressed()) {
         state = GameState::PAUSED;
+        input.clearKeys();
     }
     
     // Check for quit
     if (input.isQuitPressed()) {
         state = GameState::QUIT;
     }
+    
+    // Show or hide the frame timings
+    if (input.isProfilerTogglePressed()) {
+        showProfiler = !showProfiler;
+        input.clearKeys();
+    }
 }
 
 void Game::update() {
-    auto currentTime = std::chrono::high_resolution_clock::now();
+    // Build the next level's obstacles, and swap them in on a level change,
+    // a slice at a time so no frame has to handle a whole board
+    advanceObstacles();
+    
+    auto currentTime = now();
     float deltaTime = std::chrono::duration<float>(currentTime - lastUpdateTime).count();
     
     // Update game components at the game speed
-    if (deltaTime >= frameTime) {
-        // Update snake position
+    if (deltaTime >= getTickTime()) {
+        tickCount++;
+        speedTimeLeft = std::max(speedTimeLeft - deltaTime, 0.0f);
+        ghostTimeLeft = std::max(ghostTimeLeft - deltaTime, 0.0f);
+        
+        // Only a head-on in this tick counts against player one
+        playerHeadOn = false;
+        
+        // Update snake positions: player one, then everyone else in id order.
+        // Whatever a snake moved onto is eaten before the next one moves, so
+        // the item slot it remembers is still the item's.
         snake.update();
+        int slot = snake.checkFoodCollision();
+        if (slot != WorldGrid::NO_ITEM) {
+            eatItem(slot);
+        }
+        updateRivals();
         
-        // Check if snake eats food
-        if (snake.checkFoodCollision(food)) {
-            snake.grow();
-            score += 10 * static_cast<int>(difficulty) + 1;
-            
-            // Every 5 food items, increase level
-            if (score % (50 * (static_cast<int>(difficulty) + 1)) == 0) {
-                incrementLevel();
-            }
-            
-            // Generate new food
-            generateFood();
-            
-            // Update high score if needed
-            if (score > highScore) {
-                highScore = score;
-            }
+        if (std::rand() % POWER_UP_CHANCE == 0) {
+            spawnPowerUp();
         }
         
         // Check for collisions
@@ -157,16 +482,31 @@ void Game::update() {
             saveHighScore();
         }
         
-        // Animate food
-        food.update(deltaTime);
+        // A human rival dying ends the round too
+        for (const auto& rival : rivals) {
+            if (!rival.isBot && !rival.alive && state == GameState::PLAYING) {
+                state = GameState::GAME_OVER;
+                saveHighScore();
+            }
+        }
+        
+        // Animate the items and let unused power-ups run out
+        items.advance(static_cast<int>(deltaTime * 1000.0f));
         
         lastUpdateTime = currentTime;
     }
 }
 
 bool Game::checkCollision() {
-    // Check if snake collides with itself
-    if (snake.checkSelfCollision()) {
+    // Check if snake runs into itself
+    int hitId = snake.getCollisionOwner();
+    if (hitId == snake.getId()) {
+        return true;
+    }
+    
+    // Check if it ran into another snake, or a rival's head ran into ours
+    // on this tick; a ghost passes through both
+    if ((hitId != WorldGrid::NO_OWNER || playerHeadOn) && ghostTimeLeft <= 0.0f) {
         return true;
     }
     
@@ -174,55 +514,220 @@ bool Game::checkCollision() {
     int headX = snake.getHeadX();
     int headY = snake.getHeadY();
     
-    if (headX < 1 || headX >= width - 1 || headY < 1 || headY >= height - 1) {
+    if (isOutOfBounds(headX, headY)) {
         return true;
     }
     
-    return false;
+    // Check if snake hits an obstacle
+    return isObstacle(headX, headY);
 }
 
 void Game::render() {
-    // Clear the screen
-    renderer.clear();
-    
-    // Draw borders
-    renderer.drawBorder();
-    
-    // Draw snake
-    snake.render(renderer);
-    
-    // Draw food
-    food.render(renderer);
+    {
+        PROFILE_PHASE(profiler, FramePhase::RENDER);
+        
+        // Clear the screen
+        renderer.clear();
+        
+        // Follow the head with the viewport
+        updateCamera();
+        
+        // Draw borders, obstacles and snake bodies
+        drawWorldLayer(true);
+        
+        // Draw snake heads and tails
+        snake.render(renderer);
+        for (auto& rival : rivals) {
+            if (rival.snake.getLength() > 0) {
+                rival.snake.render(renderer);
+            }
+        }
+        
+        // Draw food and power-ups
+        items.render(renderer);
+        
+        // Draw score
+        drawHud();
+    }
     
-    // Draw score
-    std::stringstream ss;
-    ss << "Score: " << score << " | High Score: " << highScore << " | Level: " << level << " | " << getDifficultyString();
-    renderer.drawText(1, 0, ss.str(), ColorPair::SCORE);
+    // Frame timings go on top, outside the time they report
+    if (showProfiler) {
+        drawProfilerOverlay();
+    }
     
     // Refresh the screen
+    PROFILE_PHASE(profiler, FramePhase::REFRESH);
     renderer.refresh();
 }
 
-void Game::generateFood() {
-    // Generate food in a random location that's not occupied by the snake
-    int x, y;
-    bool validPosition = false;
+void Game::drawWorldLayer(bool includePlayer) {
+    // The border, obstacles and snake bodies stay in the background layer
+    // between frames. Each frame only redraws the cells the world grid
+    // reported as changed (a handful per tick) and, when the viewport has
+    // moved, the strips that scrolled into view.
+    int viewX = renderer.getViewX();
+    int viewY = renderer.getViewY();
+    int dx = viewX - worldLayerX;
+    int dy = viewY - worldLayerY;
+    if (worldDamage.isAll() || std::abs(dx) >= width || std::abs(dy) >= height) {
+        renderer.invalidateLayer(Layer::BACKGROUND);
+    }
     
-    while (!validPosition) {
-        x = utils::randomInt(1, width - 2);
-        y = utils::randomInt(1, height - 2);
+    LayerKey key(worldWidth, worldHeight, includePlayer ? 1 : 0);
+    if (renderer.patchLayer(Layer::BACKGROUND, key)) {
+        if (dx != 0 || dy != 0) {
+            renderer.scrollLayer(Layer::BACKGROUND, dx, dy);
+            
+            // Columns, then rows, that came into view
+            int firstX = dx > 0 ? width - dx : 0;
+            int firstY = dy > 0 ? height - dy : 0;
+            for (int y = 0; y < height; y++) {
+                for (int x = firstX; x < firstX + std::abs(dx); x++) {
+                    drawWorldCell(viewX + x, viewY + y, includePlayer);
+                }
+            }
+            for (int y = firstY; y < firstY + std::abs(dy); y++) {
+                for (int x = 0; x < width; x++) {
+                    drawWorldCell(viewX + x, viewY + y, includePlayer);
+                }
+            }
+        }
         
-        // Check if the location is not occupied by the snake
-        validPosition = !snake.containsPosition(x, y);
+        for (const GridPoint& cell : worldDamage.getCells()) {
+            drawWorldCell(cell.x, cell.y, includePlayer);
+        }
+        renderer.endLayer();
+    } else if (renderer.beginLayer(Layer::BACKGROUND, key)) {
+        ownerChars[snake.getId()] = includePlayer ? 'o' : 0;
+        drawWorldView(renderer, world, worldWidth, worldHeight, ownerChars);
+        renderer.endLayer();
     }
     
-    food.setPosition(x, y);
+    worldLayerX = viewX;
+    worldLayerY = viewY;
+    worldDamage.clear();
+}
+
+void Game::drawHud() {
+    // The score line is only formatted again when something on it changes
+    int viewers = spectators.isOpen() ? spectators.getViewerCount() : -1;
+    bool fast = speedTimeLeft > 0.0f;
+    bool ghost = ghostTimeLeft > 0.0f;
+    int effects = (fast ? 1 : 0) | (ghost ? 2 : 0);
+    LayerKey key(HUD_OVERLAY, score, highScore, level, static_cast<int>(difficulty) | (effects << 8), viewers);
+    if (!renderer.beginLayer(Layer::OVERLAY, key)) {
+        return;
+    }
+    
+    // Formatted on the stack, so even a new score allocates nothing
+    const char* effectText = fast && ghost ? " | Fast Ghost" : fast ? " | Fast" : ghost ? " | Ghost" : "";
+    char text[TEXT_SIZE];
+    int length = std::snprintf(text, sizeof(text), "Score: %d | High Score: %d | Level: %d | %s%s",
+                               score, highScore, level, getDifficultyString(), effectText);
+    if (viewers >= 0 && length >= 0 && length < TEXT_SIZE) {
+        std::snprintf(text + length, sizeof(text) - length, " | Viewers: %d", viewers);
+    }
+    renderer.drawText(1, 0, text, ColorPair::SCORE);
+    renderer.endLayer();
+}
+
+void Game::drawProfilerOverlay() {
+    // One line per phase in the bottom left corner, redrawn every frame as
+    // the numbers change; formatted on the stack like the score line
+    const int phases = static_cast<int>(FramePhase::COUNT);
+    int top = height - 2 - phases;
+    char text[TEXT_SIZE];
+#if SNAKE_PROFILING
+    std::snprintf(text, sizeof(text), "%-8s %9s %9s %9s %8s", "us", "p50", "p99", "max", "frames");
+    renderer.drawText(2, top, text, ColorPair::MENU_HIGHLIGHT);
+    for (int i = 0; i < phases; i++) {
+        FramePhase phase = static_cast<FramePhase>(i);
+        const LatencyHistogram& histogram = profiler.getHistogram(phase);
+        std::snprintf(text, sizeof(text), "%-8s %9.1f %9.1f %9.1f %8llu", FrameProfiler::getPhaseName(phase),
+                      histogram.getPercentileNs(0.5) / 1000.0, histogram.getPercentileNs(0.99) / 1000.0,
+                      histogram.getMaxNs() / 1000.0, static_cast<unsigned long long>(histogram.getCount()));
+        renderer.drawText(2, top + 1 + i, text, ColorPair::MENU_NORMAL);
+    }
+#else
+    std::snprintf(text, sizeof(text), "Frame timing was left out of this build (PROFILING=0)");
+    renderer.drawText(2, top + phases, text, ColorPair::MENU_NORMAL);
+#endif
+}
+
+void Game::drawCentered(int y, const char* text, ColorPair color) {
+    renderer.drawText(width / 2 - static_cast<int>(std::strlen(text)) / 2, y, text, color);
+}
+
+void Game::generateFood() {
+    // Top the board back up with food in random locations that are not
+    // occupied by anything else. On large worlds it is placed near the
+    // snake so it can actually be found. If there is no room, there is less.
+    GridPoint cell;
+    while (items.count(ItemKind::FOOD) < foodCount && world.findEmptyCell(getFoodArea(), cell)) {
+        items.add(cell.x, cell.y, ItemKind::FOOD, 0);
+    }
+}
+
+void Game::spawnPowerUp() {
+    int powerUps = static_cast<int>(items.size()) - items.count(ItemKind::FOOD);
+    GridPoint cell;
+    if (powerUps < MAX_POWER_UPS && world.findEmptyCell(getFoodArea(), cell)) {
+        ItemKind kind = static_cast<ItemKind>(1 + std::rand() % (static_cast<int>(ItemKind::COUNT) - 1));
+        items.add(cell.x, cell.y, kind, POWER_UP_LIFETIME_MS);
+    }
+}
+
+void Game::eatItem(int slot) {
+    ItemKind kind = items.getKind(slot);
+    items.remove(slot);
+    applyItem(kind);
+}
+
+void Game::applyItem(ItemKind kind) {
+    switch (kind) {
+        case ItemKind::FOOD:
+            snake.grow();
+            score += 10 * static_cast<int>(difficulty) + 1;
+            
+            // Every 5 food items, increase level
+            if (score % (50 * (static_cast<int>(difficulty) + 1)) == 0) {
+                incrementLevel();
+            }
+            
+            // Generate new food
+            generateFood();
+            
+            // Update high score if needed
+            if (score > highScore) {
+                highScore = score;
+            }
+            break;
+        
+        case ItemKind::SPEED:
+            speedTimeLeft = POWER_UP_SECONDS;
+            break;
+        
+        case ItemKind::SHRINK:
+            snake.removeTail(std::min(SHRINK_SEGMENTS, static_cast<int>(snake.getLength()) - MIN_SNAKE_LENGTH));
+            break;
+        
+        case ItemKind::GHOST:
+            ghostTimeLeft = POWER_UP_SECONDS;
+            break;
+        
+        case ItemKind::COUNT:
+            break;
+    }
+}
+
+float Game::getTickTime() const {
+    return speedTimeLeft > 0.0f ? frameTime * SPEED_TICK_FACTOR : frameTime;
 }
 
 void Game::handleIntro() {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
+    TRACE_SCOPE("Game::handleIntro");
+    auto currentTime = now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - introStartTime).count();
     
     // Draw intro animation
     renderer.clear();
@@ -254,7 +759,7 @@ void Game::handleIntro() {
         
         // Show "Press any key to continue" with pulsing effect
         std::string pressKey = "Press any key to continue";
-        float pulse = (std::sin(elapsed * 0.01f) + 1.0f) / 2.0f;
+        float pulse = (std::sin(elapsed * INTRO_PULSE_RATE) + 1.0f) / 2.0f;
         ColorPair color = pulse > 0.5f ? ColorPair::MENU_HIGHLIGHT : ColorPair::MENU_NORMAL;
         
         renderer.drawText(width / 2 - pressKey.length() / 2, height / 2 + 3, pressKey, color);
@@ -270,15 +775,9 @@ void Game::handleIntro() {
 }
 
 void Game::handleMenu() {
-    static int selectedOption = 0;
-    const int numOptions = 5;
-    const std::string options[numOptions] = {
-        "Start Game",
-        "Difficulty: " + getDifficultyString(),
-        "High Scores",
-        "How to Play",
-        "Quit"
-    };
+    TRACE_SCOPE("Game::handleMenu");
+    int& selectedOption = menuSelection;
+    const int numOptions = MENU_OPTION_COUNT;
     
     // Process input
     if (input.isUpPressed()) {
@@ -308,18 +807,18 @@ void Game::handleMenu() {
                 resetGame();
                 state = GameState::PLAYING;
                 break;
-                
+            
             case 1: // Difficulty already handled in left/right input
                 break;
-                
+            
             case 2: // High Scores
                 // Not implemented in this version
                 break;
-                
+            
             case 3: // How to Play
                 // Not implemented in this version
                 break;
-                
+            
             case 4: // Quit
                 state = GameState::QUIT;
                 break;
@@ -327,58 +826,64 @@ void Game::handleMenu() {
         input.clearKeys();
     }
     
-    // Render menu
+    // Render menu; it is only drawn again when the selection changes
     renderer.clear();
+    if (!renderer.beginLayer(Layer::OVERLAY, LayerKey(MENU_OVERLAY, selectedOption, static_cast<int>(difficulty)))) {
+        renderer.refresh();
+        return;
+    }
     
     // Draw title
-    std::string title = "TERMINAL SNAKE";
-    renderer.drawText(width / 2 - title.length() / 2, 5, title, ColorPair::TITLE);
+    drawCentered(5, MENU_TITLE, ColorPair::TITLE);
     
-    // Draw options
+    // Draw options, with a cursor around the selected one
     for (int i = 0; i < numOptions; i++) {
         int y = 10 + i * 2;
-        ColorPair color = (i == selectedOption) ? ColorPair::MENU_HIGHLIGHT : ColorPair::MENU_NORMAL;
-        
-        // Add a cursor for selected option
-        std::string option = (i == selectedOption) ? "> " + options[i] + " <" : options[i];
-        
-        renderer.drawText(width / 2 - option.length() / 2, y, option, color);
+        bool selected = i == selectedOption;
+        char option[TEXT_SIZE];
+        std::snprintf(option, sizeof(option), selected ? "> %s%s <" : "%s%s",
+                      MENU_OPTIONS[i], i == 1 ? getDifficultyString() : "");
+        drawCentered(y, option, selected ? ColorPair::MENU_HIGHLIGHT : ColorPair::MENU_NORMAL);
     }
     
     // Draw footer
-    std::string controls = "Controls: Arrow Keys/WASD - Move, P - Pause, Q - Quit";
-    renderer.drawText(width / 2 - controls.length() / 2, height - 3, controls, ColorPair::SUBTITLE);
+    drawCentered(height - 3, MENU_CONTROLS, ColorPair::SUBTITLE);
     
+    renderer.endLayer();
     renderer.refresh();
 }
 
 void Game::handlePlaying() {
+    TRACE_SCOPE("Game::handlePlaying");
     // Process input
-    processInput();
+    {
+        PROFILE_PHASE(profiler, FramePhase::INPUT);
+        processInput();
+    }
     
     // Update game state
-    update();
+    {
+        PROFILE_PHASE(profiler, FramePhase::UPDATE);
+        update();
+    }
     
     // Render the game
     render();
 }
 
 void Game::handlePaused() {
+    TRACE_SCOPE("Game::handlePaused");
     // Render the paused game state
     render();
     
     // Draw pause message
-    std::string pauseMsg = "GAME PAUSED";
-    std::string continueMsg = "Press P to continue, Q to quit";
-    
-    int pauseMsgX = width / 2 - pauseMsg.length() / 2;
+    int pauseLength = static_cast<int>(std::strlen(PAUSE_TEXT));
+    int pauseMsgX = width / 2 - pauseLength / 2;
     int pauseMsgY = height / 2 - 1;
-    int continueMsgX = width / 2 - continueMsg.length() / 2;
-    int continueMsgY = height / 2 + 1;
     
-    renderer.drawRect(pauseMsgX - 2, pauseMsgY - 2, pauseMsg.length() + 4, 5, ColorPair::BORDER);
-    renderer.drawText(pauseMsgX, pauseMsgY, pauseMsg, ColorPair::MENU_HIGHLIGHT);
-    renderer.drawText(continueMsgX, continueMsgY, continueMsg, ColorPair::MENU_NORMAL);
+    renderer.drawRect(pauseMsgX - 2, pauseMsgY - 2, pauseLength + 4, 5, ColorPair::BORDER);
+    renderer.drawText(pauseMsgX, pauseMsgY, PAUSE_TEXT, ColorPair::MENU_HIGHLIGHT);
+    drawCentered(height / 2 + 1, CONTINUE_TEXT, ColorPair::MENU_NORMAL);
     
     renderer.refresh();
     
@@ -393,44 +898,57 @@ void Game::handlePaused() {
 }
 
 void Game::handleGameOver() {
-    static int animFrame = 0;
-    static int selectedOption = 0;
-    static bool animationDone = false;
-    const int numOptions = 2;
-    const std::string options[numOptions] = {"Play Again", "Return to Menu"};
-    
-    // Run death animation first
-    if (!animationDone) {
-        // Death animation frames
-        const int maxFrames = 10;
-        
-        if (animFrame < maxFrames) {
+    TRACE_SCOPE("Game::handleGameOver");
+    int& selectedOption = gameOverSelection;
+    const int numOptions = GAME_OVER_OPTION_COUNT;
+    
+    // Run death animation first. It moves on by however long the last frame
+    // took, so a slow frame never holds it up, and Enter skips it; any other
+    // key pressed meanwhile is dropped rather than left for the menu.
+    if (!deathAnimationDone) {
+        auto currentTime = now();
+        if (!deathAnimationStarted) {
+            // Only the part of the snake that can be seen is blown up
+            updateCamera();
+            GridRect area = {renderer.getViewX() - ParticlePool::MAX_RADIUS, renderer.getViewY() - ParticlePool::MAX_RADIUS,
+                             width + 2 * ParticlePool::MAX_RADIUS, height + 2 * ParticlePool::MAX_RADIUS};
+            particles.clear();
+            snake.emitDeath(particles, area, DEATH_DURATION_MS);
+            deathFrameTime = currentTime;
+            deathAnimationStarted = true;
+        } else {
+            // Whole milliseconds; the remainder carries over to the next frame
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - deathFrameTime);
+            particles.advance(static_cast<int>(elapsed.count()));
+            deathFrameTime += elapsed;
+        }
+        
+        bool skipped = input.isEnterPressed();
+        input.clearKeys();
+        
+        if (!skipped && particles.getTime() < DEATH_DURATION_MS) {
             // Render the game
             renderer.clear();
-            renderer.drawBorder();
+            updateCamera();
+            drawWorldLayer(false);
             
             // Draw exploding snake
-            snake.renderDeath(renderer, animFrame, maxFrames);
+            particles.render(renderer);
             
-            // Draw food
-            food.render(renderer);
+            // Draw food and power-ups
+            items.render(renderer);
             
             // Draw score
-            std::stringstream ss;
-            ss << "Score: " << score << " | High Score: " << highScore << " | Level: " << level << " | " << getDifficultyString();
-            renderer.drawText(1, 0, ss.str(), ColorPair::SCORE);
+            drawHud();
             
             renderer.refresh();
-            
-            // Increment animation frame
-            animFrame++;
-            
-            // Slow down the animation
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        } else {
-            animationDone = true;
+            return;
         }
-    } else {
+        deathAnimationDone = true;
+    }
+    
+    // The menu appears as soon as the animation has finished
+    if (deathAnimationDone) {
         // Process game over menu input
         if (input.isUpPressed() || input.isDownPressed()) {
             selectedOption = 1 - selectedOption; // Toggle between 0 and 1
@@ -446,81 +964,62 @@ void Game::handleGameOver() {
             }
             
             // Reset animation state for next time
-            animFrame = 0;
-            animationDone = false;
+            deathAnimationStarted = false;
+            deathAnimationDone = false;
             
             input.clearKeys();
         }
         
-        // Render game over screen
+        // Render game over screen; it is only drawn again when something
+        // on it changes
         renderer.clear();
         
-        // Draw game over message
-        std::string gameOverMsg = "GAME OVER";
-        std::string scoreMsg = "Final Score: " + std::to_string(score);
-        
         // Add pulsing effect to game over message
-        auto currentTime = std::chrono::high_resolution_clock::now();
+        auto currentTime = now();
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastUpdateTime).count();
-        float pulse = (std::sin(elapsed * 0.005f) + 1.0f) / 2.0f;
+        float pulse = (std::sin(elapsed * GAME_OVER_PULSE_RATE) + 1.0f) / 2.0f;
         
         ColorPair gameOverColor = pulse > 0.5f ? ColorPair::DEATH : ColorPair::DEATH_DARK;
         
-        renderer.drawText(width / 2 - gameOverMsg.length() / 2, height / 2 - 4, gameOverMsg, gameOverColor);
-        renderer.drawText(width / 2 - scoreMsg.length() / 2, height / 2 - 2, scoreMsg, ColorPair::SCORE);
+        LayerKey key(GAME_OVER_OVERLAY, selectedOption, score, static_cast<int>(gameOverColor));
+        if (!renderer.beginLayer(Layer::OVERLAY, key)) {
+            renderer.refresh();
+            return;
+        }
         
-        // Draw options
+        // Draw game over message
+        char scoreMsg[TEXT_SIZE];
+        std::snprintf(scoreMsg, sizeof(scoreMsg), "Final Score: %d", score);
+        drawCentered(height / 2 - 4, "GAME OVER", gameOverColor);
+        drawCentered(height / 2 - 2, scoreMsg, ColorPair::SCORE);
+        
+        // Draw options, with a cursor around the selected one
         for (int i = 0; i < numOptions; i++) {
             int y = height / 2 + 2 + i * 2;
-            ColorPair color = (i == selectedOption) ? ColorPair::MENU_HIGHLIGHT : ColorPair::MENU_NORMAL;
-            
-            // Add a cursor for selected option
-            std::string option = (i == selectedOption) ? "> " + options[i] + " <" : options[i];
-            
-            renderer.drawText(width / 2 - option.length() / 2, y, option, color);
+            bool selected = i == selectedOption;
+            char option[TEXT_SIZE];
+            std::snprintf(option, sizeof(option), selected ? "> %s <" : "%s", GAME_OVER_OPTIONS[i]);
+            drawCentered(y, option, selected ? ColorPair::MENU_HIGHLIGHT : ColorPair::MENU_NORMAL);
         }
         
+        renderer.endLayer();
         renderer.refresh();
     }
 }
 
+namespace {
+    // One store for the whole process: the arcade server runs a game per
+    // session, and they all share one file and one writer
+    HighScoreStore& highScoreStore() {
+        static HighScoreStore store(HIGH_SCORE_FILE);
+        return store;
+    }
+}
+
 void Game::loadHighScores() {
-    std::ifstream file(HIGH_SCORE_FILE, std::ios::binary);
-    
-    if (file.is_open()) {
-        int numScores;
-        file.read(reinterpret_cast<char*>(&numScores), sizeof(numScores));
-        
-        highScores.clear();
-        for (int i = 0; i < numScores; i++) {
-            HighScore score;
-            
-            // Read name length
-            int nameLength;
-            file.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
-            
-            // Read name string
-            char nameBuffer[256];
-            file.read(nameBuffer, nameLength);
-            score.name = std::string(nameBuffer, nameLength);
-            
-            // Read score
-            file.read(reinterpret_cast<char*>(&score.score), sizeof(score.score));
-            
-            // Read difficulty
-            int difficultyValue;
-            file.read(reinterpret_cast<char*>(&difficultyValue), sizeof(difficultyValue));
-            score.difficulty = static_cast<Difficulty>(difficultyValue);
-            
-            highScores.push_back(score);
-        }
-        
-        file.close();
-        
-        // Set current high score from the highest in the list
-        if (!highScores.empty()) {
-            highScore = highScores[0].score;
-        }
+    // A damaged or missing file leaves the table empty
+    if (highScoreStore().load(highScores) && !highScores.empty()) {
+        highScore = highScores[0].score;
     }
 }
 
@@ -548,32 +1047,10 @@ void Game::saveHighScore() {
         highScores.resize(MAX_HIGH_SCORES);
     }
     
-    // Save to file
-    std::ofstream file(HIGH_SCORE_FILE, std::ios::binary);
-    
-    if (file.is_open()) {
-        // Write number of scores
-        int numScores = static_cast<int>(highScores.size());
-        file.write(reinterpret_cast<const char*>(&numScores), sizeof(numScores));
-        
-        // Write each score
-        for (const auto& score : highScores) {
-            // Write name length
-            int nameLength = static_cast<int>(score.name.length());
-            file.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
-            
-            // Write name string
-            file.write(score.name.c_str(), nameLength);
-            
-            // Write score
-            file.write(reinterpret_cast<const char*>(&score.score), sizeof(score.score));
-            
-            // Write difficulty
-            int difficultyValue = static_cast<int>(score.difficulty);
-            file.write(reinterpret_cast<const char*>(&difficultyValue), sizeof(difficultyValue));
-        }
-        
-        file.close();
+    // Save to file, unless nobody is really playing. The store writes it
+    // in the background, so the game over screen comes up at once.
+    if (!headless) {
+        highScoreStore().save(highScores);
     }
 }
 
@@ -582,14 +1059,30 @@ void Game::resetGame() {
     score = 0;
     level = 1;
     
-    // Reset snake
-    snake.initialize(width / 2, height / 2);
+    // Start from an empty world; the first level has no obstacles. A world
+    // that is not too big gets all its chunks now, rather than one at a time
+    // as snakes first wander into them.
+    world.clear();
+    if (static_cast<long>(worldWidth) * worldHeight <= RESERVED_WORLD_CELLS) {
+        GridRect all = {0, 0, worldWidth, worldHeight};
+        world.reserve(all);
+    }
+    items.clear();
+    obstacles.reset();
+    speedTimeLeft = 0.0f;
+    ghostTimeLeft = 0.0f;
+    
+    // Reset snakes
+    snake.initialize(worldWidth / 2, worldHeight / 2);
+    spawnRivals();
+    playerHeadOn = false;
+    prepareObstacles(level + 1);
     
     // Generate new food
     generateFood();
     
     // Reset timing
-    lastUpdateTime = std::chrono::high_resolution_clock::now();
+    lastUpdateTime = now();
     
     // Update difficulty settings
     updateDifficulty(difficulty);
@@ -618,11 +1111,260 @@ void Game::incrementLevel() {
     // Make the game faster as levels increase
     frameTime *= 0.95f;
     
-    // Could add obstacles here in more complex implementations
-    // addObstacles();
+    // Swap in a fresh set of obstacles for the new level over the next frames
+    obstacles.beginChange();
+}
+
+void Game::prepareObstacles(int forLevel) {
+    // Keep more of the maze walls as the levels go up
+    float density = std::min(0.1f + 0.05f * (forLevel - 2), 0.45f);
+    unsigned int seed = levelSeed ^ (static_cast<unsigned int>(forLevel) * 0x9E3779B9u);
+    
+    // Cover the play area inside the border, or a maze-sized region of it
+    // centred on the snake when the world is larger than that
+    GridRect region;
+    region.width = std::min(worldWidth - 2, MAX_MAZE_SIZE);
+    region.height = std::min(worldHeight - 2, MAX_MAZE_SIZE);
+    region.x = std::max(1, std::min(snake.getHeadX() - region.width / 2, worldWidth - 1 - region.width));
+    region.y = std::max(1, std::min(snake.getHeadY() - region.height / 2, worldHeight - 1 - region.height));
+    
+    obstacles.prepare(seed, region, density);
+}
+
+void Game::advanceObstacles() {
+    int dx = 0, dy = 0;
+    switch (snake.getDirection()) {
+        case Direction::UP:    dy = -1; break;
+        case Direction::DOWN:  dy = 1;  break;
+        case Direction::LEFT:  dx = -1; break;
+        case Direction::RIGHT: dx = 1;  break;
+        default: break;
+    }
+    
+    // Walls only go on empty ground, so never onto a snake or an item. They
+    // also keep off the spawn corridor, so "Play Again" never starts on a
+    // wall, and off the cells just ahead of the player's head as it is when
+    // the wall goes in. Each cell left free touches a maze room, so the
+    // layout stays fully connected.
+    int spawnY = worldHeight / 2;
+    int headX = snake.getHeadX();
+    int headY = snake.getHeadY();
+    auto canPlace = [&](int x, int y) {
+        if (y >= spawnY - 1 && y <= spawnY + 1) {
+            return false;
+        }
+        
+        int ahead = dx != 0 ? (x - headX) * dx : (y - headY) * dy;
+        if (ahead >= 1 && ahead <= OBSTACLE_CLEARANCE && x == headX + dx * ahead && y == headY + dy * ahead) {
+            return false;
+        }
+        return isCellFree(x, y);
+    };
+    
+    // Start on the layout for the level after this one
+    if (obstacles.advance(world, canPlace)) {
+        prepareObstacles(level + 1);
+    }
+}
+
+bool Game::isObstacle(int x, int y) const {
+    return world.get(x, y) == CellType::OBSTACLE;
+}
+
+void Game::drawWorldCell(int x, int y, bool includePlayer) {
+    // What drawWorldLayer() shows at one cell: its grid contents over the
+    // border, or a blank (also beyond the world's edges). Items pulse, so
+    // they are drawn over the layer every frame instead.
+    CellType type = world.get(x, y);
+    int owner = world.getOwner(x, y);
+    if (type != CellType::EMPTY && type != CellType::ITEM && (includePlayer || owner != snake.getId())) {
+        drawGridCell(x, y, type, owner, owner == snake.getId());
+        return;
+    }
+    
+    bool edgeX = x == 0 || x == worldWidth - 1;
+    bool edgeY = y == 0 || y == worldHeight - 1;
+    char ch = edgeX && edgeY ? '+' : edgeY ? '-' : edgeX ? '|' : ' ';
+    renderer.drawWorldChar(x, y, ch, edgeX || edgeY ? ColorPair::BORDER : ColorPair::DEFAULT);
+}
+
+void Game::drawGridCell(int x, int y, CellType type, int owner, bool isPlayer) {
+    if (type == CellType::OBSTACLE) {
+        renderer.drawWorldChar(x, y, '#', ColorPair::OBSTACLE);
+    } else if (isPlayer) {
+        // Neighbouring segments always differ in x + y parity, which gives
+        // the same alternating colours as counting along the body
+        ColorPair color = ((x + y) & 1) ? ColorPair::SNAKE_BODY_2 : ColorPair::SNAKE_BODY_1;
+        renderer.drawWorldChar(x, y, 'o', color);
+    } else {
+        bool bot = rivals[owner - 1].isBot;
+        renderer.drawWorldChar(x, y, bot ? '~' : '=', bot ? ColorPair::RIVAL_BODY : ColorPair::SNAKE_BODY_2);
+    }
+}
+
+void Game::updateCamera() {
+    // Centre the head on screen without showing anything beyond the world
+    int originX = std::max(0, std::min(snake.getHeadX() - width / 2, worldWidth - width));
+    int originY = std::max(0, std::min(snake.getHeadY() - height / 2, worldHeight - height));
+    
+    renderer.setViewport(originX, originY);
+}
+
+GridRect Game::getFoodArea() const {
+    // The part of the play area around the snake that fits on one screen
+    GridRect area;
+    area.width = std::min(width, worldWidth - 2);
+    area.height = std::min(height, worldHeight - 2);
+    area.x = std::max(1, std::min(snake.getHeadX() - area.width / 2, worldWidth - 1 - area.width));
+    area.y = std::max(1, std::min(snake.getHeadY() - area.height / 2, worldHeight - 1 - area.height));
+    return area;
+}
+
+void Game::spawnRivals() {
+    for (auto& rival : rivals) {
+        // The world has just been cleared, so drop bodies without touching it
+        rival.snake.removeTail(static_cast<int>(rival.snake.getLength()));
+        rival.alive = false;
+        
+        // Keep trying for human players; bots may wait for a later tick
+        int attempts = rival.isBot ? 1 : SPAWN_ATTEMPTS * 8;
+        for (int i = 0; i < attempts && !rival.alive; i++) {
+            rival.alive = spawnRival(rival);
+        }
+    }
+}
+
+bool Game::spawnRival(RivalSnake& rival) {
+    // Snakes start heading right with their body to the left of (x, y), so
+    // make sure the body and a short run ahead are all free
+    for (int attempt = 0; attempt < SPAWN_ATTEMPTS; attempt++) {
+        int x = 3 + static_cast<int>(botRandom.nextBelow(static_cast<uint32_t>(std::max(worldWidth - 6 - OBSTACLE_CLEARANCE, 1))));
+        int y = 1 + static_cast<int>(botRandom.nextBelow(static_cast<uint32_t>(worldHeight - 2)));
+        
+        bool clear = true;
+        for (int dx = -2; dx <= OBSTACLE_CLEARANCE && clear; dx++) {
+            clear = isCellFree(x + dx, y) && !isOutOfBounds(x + dx, y);
+        }
+        
+        if (clear) {
+            rival.snake.initialize(x, y);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void Game::updateRivals() {
+    for (auto& rival : rivals) {
+        Snake& other = rival.snake;
+        
+        if (!rival.alive) {
+            // Clear dead bots away gradually, then bring them back
+            if (rival.isBot && other.removeTail(DEAD_SEGMENTS_PER_TICK)) {
+                rival.alive = spawnRival(rival);
+            }
+            continue;
+        }
+        
+        if (rival.isBot) {
+            steerBot(other);
+        }
+        other.update();
+        
+        // Rivals only grow from food; power-ups they run over are just gone
+        int slot = other.checkFoodCollision();
+        if (slot != WorldGrid::NO_ITEM) {
+            if (items.getKind(slot) == ItemKind::FOOD) {
+                other.grow();
+            }
+            items.remove(slot);
+            generateFood();
+        }
+    }
+    
+    // Resolve collisions once everyone has moved. A head that ran into the
+    // head of a snake that moved earlier in this tick takes that snake out too.
+    for (auto& rival : rivals) {
+        if (!rival.alive) {
+            continue;
+        }
+        
+        Snake& other = rival.snake;
+        int headX = other.getHeadX();
+        int headY = other.getHeadY();
+        int hitId = other.getCollisionOwner();
+        
+        if (hitId != WorldGrid::NO_OWNER || isOutOfBounds(headX, headY) || isObstacle(headX, headY)) {
+            rival.alive = false;
+            
+            if (hitId != WorldGrid::NO_OWNER && hitId != other.getId()) {
+                Snake& hit = getSnakeById(hitId);
+                if (hit.getLength() > 0 && hit.getHeadX() == headX && hit.getHeadY() == headY) {
+                    if (hitId == snake.getId()) {
+                        playerHeadOn = true;
+                    } else {
+                        rivals[hitId - 1].alive = false;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Game::steerBot(Snake& bot) {
+    Direction current = bot.getDirection();
+    Direction left, right;
+    
+    switch (current) {
+        case Direction::UP:    left = Direction::LEFT;  right = Direction::RIGHT; break;
+        case Direction::DOWN:  left = Direction::RIGHT; right = Direction::LEFT;  break;
+        case Direction::LEFT:  left = Direction::DOWN;  right = Direction::UP;    break;
+        default:               left = Direction::UP;    right = Direction::DOWN;  break;
+    }
+    
+    // Go straight unless blocked or bored, otherwise try both turns in a
+    // random order. Each choice is a single grid lookup.
+    Direction choices[3] = {current, left, right};
+    if (botRandom.nextBelow(2)) {
+        std::swap(choices[1], choices[2]);
+    }
+    if (botRandom.nextBelow(BOT_TURN_CHANCE) == 0) {
+        std::swap(choices[0], choices[1]);
+    }
+    
+    for (Direction dir : choices) {
+        int x = bot.getHeadX();
+        int y = bot.getHeadY();
+        
+        switch (dir) {
+            case Direction::UP:    y--; break;
+            case Direction::DOWN:  y++; break;
+            case Direction::LEFT:  x--; break;
+            default:               x++; break;
+        }
+        
+        CellType type = world.get(x, y);
+        if ((type == CellType::EMPTY || type == CellType::ITEM) && !isOutOfBounds(x, y)) {
+            bot.changeDirection(dir);
+            return;
+        }
+    }
+}
+
+bool Game::isCellFree(int x, int y) const {
+    return world.get(x, y) == CellType::EMPTY;
+}
+
+bool Game::isOutOfBounds(int x, int y) const {
+    return x < 1 || x >= worldWidth - 1 || y < 1 || y >= worldHeight - 1;
+}
+
+Snake& Game::getSnakeById(int id) {
+    return id == snake.getId() ? snake : rivals[id - 1].snake;
 }
 
-std::string Game::getDifficultyString() const {
+const char* Game::getDifficultyString() const {
     switch (difficulty) {
         case Difficulty::EASY: return "Easy";
         case Difficulty::MEDIUM: return "Medium";
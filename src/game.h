@@ -2,12 +2,18 @@
 #define GAME_H
 
 #include "snake.h"
-#include "food.h"
+#include "item_pool.h"
 #include "renderer.h"
 #include "input_handler.h"
+#include "obstacle_layout.h"
+#include "particle_pool.h"
+#include "world_grid.h"
+#include "spectator_broadcast.h"
+#include "frame_profiler.h"
+#include "high_score_store.h"
+#include "utils.h"
 #include <string>
 #include <chrono>
-#include <fstream>
 #include <vector>
 
 enum class GameState {
@@ -19,36 +25,123 @@ enum class GameState {
     QUIT
 };
 
-enum class Difficulty {
-    EASY,
-    MEDIUM,
-    HARD,
-    EXTREME
+struct GameOptions {
+    // World size in cells; 0 means the same size as the screen
+    int worldWidth;
+    int worldHeight;
+    
+    // Store the snake as 2-bit direction steps (for extremely long snakes)
+    bool packedBody;
+    
+    // Human players on this keyboard (1 or 2) and computer-driven snakes
+    int players;
+    int bots;
+    
+    // Food items kept on the board at once
+    int foods;
+    
+    // Unix socket to broadcast the screen on for spectators; empty for none
+    std::string broadcastPath;
+    
+    // File the frame timing histograms are written to on exit; empty for none
+    std::string perfCsvPath;
+    
+    // File a Chrome trace of every frame is written to on exit; empty for none
+    std::string tracePath;
+    
+    // Seed for food, levels and bots; 0 picks one from the time
+    unsigned int seed;
+    
+    // No terminal: keys come from Game::pressKey(), time only moves with
+    // Game::advanceClock(), and high scores are neither loaded nor saved
+    bool headless;
+    
+    GameOptions() : worldWidth(0), worldHeight(0), packedBody(false), players(1), bots(0), foods(1), seed(0), headless(false) {}
 };
 
-struct HighScore {
-    std::string name;
-    int score;
-    Difficulty difficulty;
+// A snake other than player one: player two or a bot. Its id in the world
+// grid is its index in Game::rivals plus one (player one is id 0).
+struct RivalSnake {
+    Snake snake;
+    bool isBot;
+    bool alive;   // Dead rivals are cleared away a few segments per tick
 };
 
 class Game {
 public:
-    Game();
+    // With a `sessionFd` the game draws to and reads keys from that
+    // descriptor instead of this process's terminal
+    explicit Game(const GameOptions& options = GameOptions(), int sessionFd = -1);
     ~Game();
     
     void run();
     void cleanup();
     
+    // Hand terminal output to a thread of its own, as run() does, for
+    // callers that drive runFrame() themselves
+    void startRenderThread();
+    
+    // One pass of the main loop without the frame delay, for callers that
+    // schedule frames themselves
+    void runFrame();
+    
+    // False once the player has quit or an attached session has hung up
+    bool isRunning() const;
+    
+    // Milliseconds until the screen next changes on its own (the next
+    // simulation tick or animation step, or room for a held-back frame on a
+    // slow terminal), or -1 if only a key can change it, as on the menus and
+    // the pause screen
+    int getFrameDelayMs() const;
+    
+    // Descriptor to wait on for keys, or -1 while the current screen is not
+    // reading any (or input has ended)
+    int getInputDescriptor() const;
+    
+    // Driving a headless game (GameOptions::headless): queue a key for the
+    // screen to read, and move the game's clock on
+    void pressKey(int key);
+    void advanceClock(int milliseconds);
+    
+    // Setting up a scene in a headless game: put snake `id` (0 for player
+    // one) at (x, y) heading in `direction`, on cells that must be empty,
+    // give player one an item's effect as if it had just been eaten, and
+    // drop an item on (x, y) if the cell is free
+    void placeSnake(int id, int x, int y, Direction direction);
+    void applyItem(ItemKind kind);
+    bool placeItem(int x, int y, ItemKind kind);
+    
+    // What a driver needs to see of the game
+    GameState getState() const;
+    int getScore() const;
+    uint64_t getTickCount() const;
+    const Snake& getPlayer() const;
+    const ItemPool& getItems() const;
+    
+    // The first rule of the board found broken, or null if there is none:
+    // an item missing from its grid cell (such as one left under a snake),
+    // or player one's head outside the border while the round is still on
+    const char* checkInvariants() const;
+    
 private:
+    // getFrameDelayMs() for the current screen alone
+    int getScreenDelayMs() const;
+    
+    // The game's idea of the time: the system clock, or a headless game's own
+    std::chrono::time_point<std::chrono::high_resolution_clock> now() const;
+    
     // Game components
     Snake snake;
-    Food food;
+    ItemPool items;  // Food and power-ups
     Renderer renderer;
     InputHandler input;
+    ObstacleLayout obstacles;  // Walls, and the next level's on the way
+    ParticlePool particles;  // The death animation
+    SpectatorBroadcast spectators;
     
     // Game state
     GameState state;
+    GameState drawnState;  // The screen the last frame drew
     Difficulty difficulty;
     int score;
     int highScore;
@@ -58,18 +151,68 @@ private:
     int level;
     std::chrono::time_point<std::chrono::high_resolution_clock> lastUpdateTime;
     float frameTime;  // Time in seconds for each frame
+    uint64_t tickCount;  // Simulation ticks since the game was created
+    int foodCount;       // Food items kept on the board
+    
+    // Seconds left on player one's power-ups
+    float speedTimeLeft;
+    float ghostTimeLeft;
     
-    // Game dimensions
+    // A headless game's clock, moved on only by advanceClock()
+    bool headless;
+    std::chrono::time_point<std::chrono::high_resolution_clock> clockTime;
+    
+    // Screen state kept per game, so several games can share a process
+    std::chrono::time_point<std::chrono::high_resolution_clock> introStartTime;
+    std::chrono::time_point<std::chrono::high_resolution_clock> deathFrameTime;
+    std::chrono::time_point<std::chrono::high_resolution_clock> lastFrameTime;
+    int menuSelection;
+    int gameOverSelection;
+    bool deathAnimationStarted;
+    bool deathAnimationDone;
+    
+    // Screen dimensions
     int width;
     int height;
     
+    // World dimensions; the screen shows a viewport that follows the head
+    int worldWidth;
+    int worldHeight;
+    WorldGrid world;
+    DamageList worldDamage;  // Cells changed since the world was last drawn
+    std::vector<char> ownerChars;  // Body character for each snake id
+    int worldLayerX;         // Viewport the world was last drawn for
+    int worldLayerY;
+    
+    // Obstacles live in the world grid. Layouts cover at most one maze-sized
+    // region, placed around the snake when the level starts being prepared.
+    unsigned int levelSeed;
+    
+    // Everyone else on the board, updated in id order after player one
+    std::vector<RivalSnake> rivals;
+    utils::Random botRandom;
+    bool playerHeadOn;  // A rival hit player one head-on this tick
+    
+    // Frame timing, shown over the game with F and written out on exit
+    FrameProfiler profiler;
+    bool showProfiler;
+    std::string perfCsvPath;  // Cleared once written
+    std::string tracePath;
+    
     // Game logic
     void initialize();
     void processInput();
     void update();
     bool checkCollision();
     void render();
+    void drawWorldLayer(bool includePlayer);
+    void drawHud();
+    void drawProfilerOverlay();
+    void drawCentered(int y, const char* text, ColorPair color);
     void generateFood();
+    void spawnPowerUp();
+    void eatItem(int slot);
+    float getTickTime() const;
     
     // Game state handlers
     void handleIntro();
@@ -85,8 +228,23 @@ private:
     void updateDifficulty(Difficulty newDifficulty);
     float getDifficultyMultiplier() const;
     void incrementLevel();
-    void addObstacles();
-    std::string getDifficultyString() const;
+    void advanceObstacles();
+    void prepareObstacles(int forLevel);
+    bool isObstacle(int x, int y) const;
+    void drawWorldCell(int x, int y, bool includePlayer);
+    void drawGridCell(int x, int y, CellType type, int owner, bool isPlayer);
+    void updateCamera();
+    GridRect getFoodArea() const;
+    
+    // Other snakes
+    void spawnRivals();
+    bool spawnRival(RivalSnake& rival);
+    void updateRivals();
+    void steerBot(Snake& bot);
+    bool isCellFree(int x, int y) const;
+    bool isOutOfBounds(int x, int y) const;
+    Snake& getSnakeById(int id);
+    const char* getDifficultyString() const;
 };
 
 #endif // GAME_H
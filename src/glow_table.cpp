@@ -0,0 +1,27 @@
+#include "glow_table.h"
+
+namespace {
+    // Dark, dim, medium and bright
+    const GlowLook LOOKS[] = {
+        {'#', ColorPair::FOOD_DARK},
+        {'%', ColorPair::FOOD_DIM},
+        {'&', ColorPair::FOOD_MEDIUM},
+        {'@', ColorPair::FOOD_BRIGHT}
+    };
+    
+    // (sin(2 * pi * step / STEPS) + 1) / 2 for each step, sorted into the
+    // looks at the old thresholds of 0.2, 0.5 and 0.8
+    const unsigned char LEVELS[] = {
+        1, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2,
+        2, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1
+    };
+    static_assert(sizeof(LEVELS) == GlowTable::STEPS, "one level per step");
+}
+
+const GlowLook& GlowTable::at(int ageMs) {
+    int phase = ageMs % PERIOD_MS;
+    if (phase < 0) {
+        phase += PERIOD_MS;
+    }
+    return LOOKS[LEVELS[phase * STEPS / PERIOD_MS]];
+}
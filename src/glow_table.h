@@ -0,0 +1,25 @@
+#ifndef GLOW_TABLE_H
+#define GLOW_TABLE_H
+
+#include "renderer.h"
+
+// How a glowing thing on the board looks at a point in its pulse
+struct GlowLook {
+    char ch;
+    ColorPair color;
+};
+
+// The pulse food has always had, three blinks a second on a sine wave,
+// sampled once per step of a period and kept in a table shared by every
+// item on the board. Looking one up is an index into that table, so a
+// board full of items costs no trigonometry at all.
+class GlowTable {
+public:
+    static const int PERIOD_MS = 333;
+    static const int STEPS = 32;
+    
+    // The look `ageMs` milliseconds into a pulse that started at zero
+    static const GlowLook& at(int ageMs);
+};
+
+#endif // GLOW_TABLE_H
@@ -0,0 +1,337 @@
+#include "high_score_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+const char MAGIC[4] = {'S', 'N', 'H', 'S'};
+const size_t MAGIC_SIZE = sizeof(MAGIC);
+const size_t CHECKSUM_SIZE = 4;
+const int32_t LEGACY_MAX_NAME_LENGTH = 255;  // The old reader's buffer held 256 bytes
+const int DIFFICULTY_COUNT = 4;
+
+namespace {
+    // CRC-32 as in zlib and PNG, a bit at a time: the file is only a few
+    // hundred bytes
+    uint32_t crc32(const char* data, size_t size) {
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= static_cast<unsigned char>(data[i]);
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+            }
+        }
+        return ~crc;
+    }
+    
+    void putU8(std::string& out, uint32_t value) {
+        out.push_back(static_cast<char>(value & 0xFF));
+    }
+    
+    void putU16(std::string& out, uint32_t value) {
+        putU8(out, value);
+        putU8(out, value >> 8);
+    }
+    
+    void putU32(std::string& out, uint32_t value) {
+        putU16(out, value);
+        putU16(out, value >> 16);
+    }
+    
+    // Reads little-endian values, failing instead of reading past the end
+    class Reader {
+    public:
+        Reader(const std::string& bytes, size_t end) : data(bytes), position(0), limit(end) {}
+        
+        bool readU8(uint32_t& value) {
+            if (position >= limit) {
+                return false;
+            }
+            value = static_cast<unsigned char>(data[position++]);
+            return true;
+        }
+        
+        bool readU16(uint32_t& value) {
+            uint32_t low, high;
+            if (!readU8(low) || !readU8(high)) {
+                return false;
+            }
+            value = low | (high << 8);
+            return true;
+        }
+        
+        bool readU32(uint32_t& value) {
+            uint32_t low, high;
+            if (!readU16(low) || !readU16(high)) {
+                return false;
+            }
+            value = low | (high << 16);
+            return true;
+        }
+        
+        bool readI32(int32_t& value) {
+            uint32_t raw;
+            if (!readU32(raw)) {
+                return false;
+            }
+            value = static_cast<int32_t>(raw);
+            return true;
+        }
+        
+        bool readString(size_t length, std::string& value) {
+            if (length > limit - position) {
+                return false;
+            }
+            value.assign(data, position, length);
+            position += length;
+            return true;
+        }
+        
+        bool atEnd() const {
+            return position == limit;
+        }
+    
+    private:
+        const std::string& data;
+        size_t position;
+        size_t limit;
+    };
+    
+    bool isValidScore(int32_t score, int32_t difficulty) {
+        return score >= 0 && difficulty >= 0 && difficulty < DIFFICULTY_COUNT;
+    }
+    
+    bool decodeCurrent(const std::string& bytes, std::vector<HighScore>& scores) {
+        if (bytes.size() < MAGIC_SIZE + 4 + CHECKSUM_SIZE) {
+            return false;
+        }
+        
+        // The checksum covers everything before it, header included
+        size_t body = bytes.size() - CHECKSUM_SIZE;
+        Reader checksum(bytes, bytes.size());
+        uint32_t stored = 0;
+        std::string skipped;
+        if (!checksum.readString(body, skipped) || !checksum.readU32(stored) || stored != crc32(bytes.data(), body)) {
+            return false;
+        }
+        
+        Reader reader(bytes, body);
+        std::string magic;
+        uint32_t version, count;
+        if (!reader.readString(MAGIC_SIZE, magic) || !reader.readU16(version) || !reader.readU16(count) ||
+            version != HighScoreStore::FORMAT_VERSION || count > HighScoreStore::MAX_SCORES) {
+            return false;
+        }
+        
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t nameLength, difficulty;
+            int32_t score;
+            HighScore entry;
+            if (!reader.readU8(nameLength) || nameLength > HighScoreStore::MAX_NAME_LENGTH ||
+                !reader.readString(nameLength, entry.name) || !reader.readI32(score) || !reader.readU8(difficulty) ||
+                !isValidScore(score, static_cast<int32_t>(difficulty))) {
+                return false;
+            }
+            entry.score = score;
+            entry.difficulty = static_cast<Difficulty>(difficulty);
+            scores.push_back(entry);
+        }
+        return reader.atEnd();
+    }
+    
+    // Before the format had a version: a count, then per score the name's
+    // length, the name, the score and the difficulty, all as native ints
+    bool decodeLegacy(const std::string& bytes, std::vector<HighScore>& scores) {
+        Reader reader(bytes, bytes.size());
+        int32_t count;
+        if (!reader.readI32(count) || count < 0 || count > static_cast<int32_t>(HighScoreStore::MAX_SCORES)) {
+            return false;
+        }
+        
+        for (int32_t i = 0; i < count; i++) {
+            int32_t nameLength, score, difficulty;
+            HighScore entry;
+            if (!reader.readI32(nameLength) || nameLength < 0 || nameLength > LEGACY_MAX_NAME_LENGTH ||
+                !reader.readString(static_cast<size_t>(nameLength), entry.name) ||
+                !reader.readI32(score) || !reader.readI32(difficulty) || !isValidScore(score, difficulty)) {
+                return false;
+            }
+            
+            // Longer names than the new format holds are cut short
+            if (entry.name.size() > HighScoreStore::MAX_NAME_LENGTH) {
+                entry.name.resize(HighScoreStore::MAX_NAME_LENGTH);
+            }
+            entry.score = score;
+            entry.difficulty = static_cast<Difficulty>(difficulty);
+            scores.push_back(entry);
+        }
+        return reader.atEnd();
+    }
+}
+
+HighScoreStore::HighScoreStore(const std::string& filePath)
+    : path(filePath),
+      hasPending(false),
+      writing(false),
+      stopping(false),
+      failedWrites(0) {
+}
+
+HighScoreStore::~HighScoreStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+bool HighScoreStore::load(std::vector<HighScore>& scores) {
+    std::string bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bytes = latest;
+    }
+    
+    if (bytes.empty()) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            scores.clear();
+            return false;
+        }
+        
+        // One byte past the limit tells an oversized file from one that fits
+        bytes.resize(MAX_FILE_SIZE + 1);
+        file.read(&bytes[0], static_cast<std::streamsize>(bytes.size()));
+        bytes.resize(static_cast<size_t>(file.gcount()));
+        if (bytes.size() > MAX_FILE_SIZE) {
+            scores.clear();
+            return false;
+        }
+    }
+    
+    return decode(bytes, scores);
+}
+
+void HighScoreStore::save(const std::vector<HighScore>& scores) {
+    std::string bytes = encode(scores);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        latest = bytes;
+        pending.swap(bytes);
+        hasPending = true;
+        
+        if (!writer.joinable()) {
+            writer = std::thread(&HighScoreStore::writeLoop, this);
+        }
+    }
+    wake.notify_one();
+}
+
+void HighScoreStore::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return !hasPending && !writing; });
+}
+
+uint64_t HighScoreStore::getFailedWrites() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedWrites;
+}
+
+std::string HighScoreStore::encode(const std::vector<HighScore>& scores) {
+    size_t count = std::min(scores.size(), MAX_SCORES);
+    
+    std::string out(MAGIC, MAGIC_SIZE);
+    putU16(out, FORMAT_VERSION);
+    putU16(out, static_cast<uint32_t>(count));
+    for (size_t i = 0; i < count; i++) {
+        const HighScore& entry = scores[i];
+        size_t nameLength = std::min(entry.name.size(), MAX_NAME_LENGTH);
+        putU8(out, static_cast<uint32_t>(nameLength));
+        out.append(entry.name, 0, nameLength);
+        putU32(out, static_cast<uint32_t>(std::max(entry.score, 0)));
+        putU8(out, static_cast<uint32_t>(entry.difficulty));
+    }
+    putU32(out, crc32(out.data(), out.size()));
+    return out;
+}
+
+bool HighScoreStore::decode(const std::string& bytes, std::vector<HighScore>& scores) {
+    scores.clear();
+    bool current = bytes.compare(0, MAGIC_SIZE, MAGIC, MAGIC_SIZE) == 0;
+    bool ok = current ? decodeCurrent(bytes, scores) : decodeLegacy(bytes, scores);
+    if (!ok) {
+        scores.clear();
+    }
+    return ok;
+}
+
+void HighScoreStore::writeLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this]() { return hasPending || stopping; });
+        if (!hasPending) {
+            return;
+        }
+        
+        std::string bytes;
+        bytes.swap(pending);
+        hasPending = false;
+        writing = true;
+        lock.unlock();
+        
+        bool written = writeFile(bytes);
+        
+        lock.lock();
+        writing = false;
+        if (!written) {
+            failedWrites++;
+        }
+        if (!hasPending) {
+            idle.notify_all();
+        }
+    }
+}
+
+bool HighScoreStore::writeFile(const std::string& bytes) const {
+    // Private to this process, so two games saving at once never share it
+    std::string temporary = path + ".tmp." + std::to_string(::getpid());
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    
+    size_t done = 0;
+    bool ok = true;
+    while (ok && done < bytes.size()) {
+        ssize_t count = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (count > 0) {
+            done += static_cast<size_t>(count);
+        } else if (count < 0 && errno != EINTR) {
+            ok = false;
+        }
+    }
+    
+    // The data has to be on disk before the rename makes it the table
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    
+    // And the rename has to be on disk before it counts as saved
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef HIGH_SCORE_STORE_H
+#define HIGH_SCORE_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Difficulty {
+    EASY,
+    MEDIUM,
+    HARD,
+    EXTREME
+};
+
+struct HighScore {
+    std::string name;
+    int score;
+    Difficulty difficulty;
+};
+
+// The high score table on disk.
+//
+// The file starts with a magic number and a format version, holds each
+// score's name (length first), score and difficulty, and ends in a CRC-32
+// of everything before it. Reading checks every length against what is
+// left of the file and every value against its range, and rejects the
+// whole file if anything is off, so a damaged file reads as no scores
+// rather than as garbage. Files from before the format had a version are
+// still read, with the same checks.
+//
+// save() only encodes the table and hands it to a writer thread of the
+// store's own, started on first use, so the caller never waits for the
+// disk. The writer puts the table in a temporary file next to the real
+// one, syncs it and renames it over the old file, so a crash at any point
+// leaves either the old table or the new one. If saves come faster than
+// the disk takes them, only the newest is written.
+class HighScoreStore {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t MAX_SCORES = 100;
+    static constexpr size_t MAX_NAME_LENGTH = 64;
+    static constexpr size_t MAX_FILE_SIZE = 64 * 1024;
+    
+    explicit HighScoreStore(const std::string& path);
+    
+    // Waits for the last save to reach the disk
+    ~HighScoreStore();
+    
+    HighScoreStore(const HighScoreStore&) = delete;
+    HighScoreStore& operator=(const HighScoreStore&) = delete;
+    
+    // The newest table saved by this process, or else the one in the file.
+    // False, with `scores` empty, if there is none or it is damaged.
+    bool load(std::vector<HighScore>& scores);
+    
+    // Queue `scores` to be written; returns at once
+    void save(const std::vector<HighScore>& scores);
+    
+    // Wait until everything saved so far is on disk
+    void flush();
+    
+    // Writes that failed (disk full, no permission, ...); the old file is
+    // left as it was
+    uint64_t getFailedWrites() const;
+    
+    // The file format. decode() accepts exactly what encode() produces,
+    // plus the old unversioned format; `scores` is left empty on failure.
+    static std::string encode(const std::vector<HighScore>& scores);
+    static bool decode(const std::string& bytes, std::vector<HighScore>& scores);
+    
+private:
+    std::string path;
+    
+    // Guarded by `mutex`
+    mutable std::mutex mutex;
+    std::condition_variable wake;  // Work for the writer, or time to stop
+    std::condition_variable idle;  // The writer has caught up
+    std::string pending;     // Next table to write
+    bool hasPending;
+    bool writing;
+    bool stopping;
+    std::string latest;      // Newest table saved, for load()
+    uint64_t failedWrites;
+    
+    std::thread writer;
+    
+    void writeLoop();
+    bool writeFile(const std::string& bytes) const;
+};
+
+#endif // HIGH_SCORE_STORE_H
@@ -1,9 +1,9 @@
 #include "input_handler.h"
+#include "trace_recorder.h"
 #include <iostream>
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <cstdio>
 
 // Constants for special keys
 const int ERR_KEY = -1;
@@ -13,53 +13,78 @@ const int KEY_LEFT_VALUE = 1003;
 const int KEY_RIGHT_VALUE = 1004;
 const int KEY_ENTER_VALUE = 1005;
 
-// Helper function to read a character from stdin without blocking
-int kbhit() {
-    struct termios oldt, newt;
-    int ch;
-    int oldf;
-    
-    // Save old terminal settings
-    tcgetattr(STDIN_FILENO, &oldt);
-    
-    // Set new terminal settings
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    
-    // Set non-blocking mode
-    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
-    
-    // Read character
-    ch = getchar();
-    
-    // Restore old terminal settings
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
-    
-    if(ch != EOF) {
-        return ch;
-    }
-    
-    return ERR_KEY;
+InputHandler::InputHandler() 
+    : lastKey(ERR_KEY),
+      inputFd(-1),
+      ended(false),
+      terminalSaved(false),
+      savedFlags(-1),
+      scripted(false),
+      scriptStart(0),
+      scriptCount(0) {
 }
 
-InputHandler::InputHandler() 
-    : lastKey(ERR_KEY) {
+InputHandler::~InputHandler() {
+    cleanup();
+}
+
+void InputHandler::attach(int fd) {
+    inputFd = fd;
+}
+
+void InputHandler::useScript() {
+    scripted = true;
+}
+
+void InputHandler::pressKey(int key) {
+    // A full queue drops the newest key, as a flooded terminal would
+    if (scriptCount < SCRIPT_SIZE) {
+        scriptKeys[(scriptStart + scriptCount) % SCRIPT_SIZE] = key;
+        scriptCount++;
+    }
 }
 
 void InputHandler::initialize() {
-    // Set terminal to non-canonical mode
-    struct termios t;
-    tcgetattr(STDIN_FILENO, &t);
-    t.c_lflag &= ~ICANON;
-    tcsetattr(STDIN_FILENO, TCSANOW, &t);
+    // An attached descriptor's terminal is set up by whoever is on the other end
+    if (inputFd >= 0 || scripted) {
+        return;
+    }
+    
+    // Switch the terminal to unbuffered, silent, non-blocking input once,
+    // so each key is a single read()
+    if (!terminalSaved && tcgetattr(STDIN_FILENO, &savedTerminal) == 0) {
+        terminalSaved = true;
+        
+        struct termios t = savedTerminal;
+        t.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &t);
+    }
+    
+    if (savedFlags < 0) {
+        savedFlags = fcntl(STDIN_FILENO, F_GETFL, 0);
+        fcntl(STDIN_FILENO, F_SETFL, savedFlags | O_NONBLOCK);
+    }
+}
+
+void InputHandler::cleanup() {
+    if (inputFd >= 0 || scripted) {
+        return;
+    }
+    
+    // The shell shares this terminal, so give it back the way we found it
+    if (terminalSaved) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+        terminalSaved = false;
+    }
+    if (savedFlags >= 0) {
+        fcntl(STDIN_FILENO, F_SETFL, savedFlags);
+        savedFlags = -1;
+    }
 }
 
 Direction InputHandler::getDirection() {
     // Read the key
-    int key = kbhit();
+    int key = readKey();
     
     if (key != ERR_KEY) {
         lastKey = key;
@@ -70,26 +95,49 @@ Direction InputHandler::getDirection() {
         case 'w':
         case 'W':
             return Direction::UP;
-            
+        
         case 's':
         case 'S':
             return Direction::DOWN;
-            
+        
         case 'a':
         case 'A':
             return Direction::LEFT;
-            
+        
         case 'd':
         case 'D':
             return Direction::RIGHT;
-            
+        
+        default:
+            return Direction::NONE;
+    }
+}
+
+Direction InputHandler::getSecondPlayerDirection() {
+    switch (lastKey) {
+        case 'i':
+        case 'I':
+            return Direction::UP;
+        
+        case 'k':
+        case 'K':
+            return Direction::DOWN;
+        
+        case 'j':
+        case 'J':
+            return Direction::LEFT;
+        
+        case 'l':
+        case 'L':
+            return Direction::RIGHT;
+        
         default:
             return Direction::NONE;
     }
 }
 
 bool InputHandler::isKeyPressed() {
-    int key = kbhit();
+    int key = readKey();
     if (key != ERR_KEY) {
         lastKey = key;
         return true;
@@ -125,18 +173,61 @@ bool InputHandler::isEnterPressed() {
     return checkKey('\n') || checkKey('\r');
 }
 
+bool InputHandler::isProfilerTogglePressed() {
+    return checkKey('f') || checkKey('F');
+}
+
 void InputHandler::clearKeys() {
     lastKey = ERR_KEY;
     
     // Clear any remaining input
     int key;
-    while ((key = kbhit()) != ERR_KEY) {
+    while ((key = readKey()) != ERR_KEY) {
         // Just drain the input buffer
     }
 }
 
+bool InputHandler::isClosed() const {
+    return ended && inputFd >= 0;
+}
+
+int InputHandler::getDescriptor() const {
+    if (ended || scripted) {
+        return -1;
+    }
+    return inputFd >= 0 ? inputFd : STDIN_FILENO;
+}
+
+int InputHandler::readKey() {
+    if (ended) {
+        return ERR_KEY;
+    }
+    
+    if (scripted) {
+        if (scriptCount == 0) {
+            return ERR_KEY;
+        }
+        int key = scriptKeys[scriptStart];
+        scriptStart = (scriptStart + 1) % SCRIPT_SIZE;
+        scriptCount--;
+        return key;
+    }
+    
+    TRACE_SCOPE("read");
+    unsigned char ch;
+    ssize_t result = read(inputFd >= 0 ? inputFd : STDIN_FILENO, &ch, 1);
+    if (result == 1) {
+        return ch;
+    }
+    
+    if (result == 0) {
+        ended = true;
+    }
+    return ERR_KEY;
+}
+
 bool InputHandler::checkKey(int key) {
-    int input = kbhit();
+    int input = readKey();
     if (input != ERR_KEY) {
         lastKey = input;
     }
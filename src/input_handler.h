@@ -2,14 +2,31 @@
 #define INPUT_HANDLER_H
 
 #include "snake.h"
+#include <termios.h>
 
 class InputHandler {
 public:
     InputHandler();
+    ~InputHandler();
+    
+    // Read keys from `fd` (e.g. a session socket) instead of this process's
+    // terminal. The descriptor should be non-blocking; the other end is
+    // expected to send raw keystrokes.
+    void attach(int fd);
+    
+    // Take keys only from pressKey(), leaving every descriptor alone; for
+    // headless games driven by a script
+    void useScript();
+    void pressKey(int key);
     
     void initialize();
+    void cleanup();
     Direction getDirection();
     
+    // Direction for player two (I/J/K/L) from the key last read by
+    // getDirection(); does not read a new key itself
+    Direction getSecondPlayerDirection();
+    
     bool isKeyPressed();
     bool isUpPressed();
     bool isDownPressed();
@@ -18,12 +35,34 @@ public:
     bool isPausePressed();
     bool isQuitPressed();
     bool isEnterPressed();
+    bool isProfilerTogglePressed();
     
     void clearKeys();
     
+    // True once an attached descriptor has reached end of file
+    bool isClosed() const;
+    
+    // Descriptor to wait on for the next key, or -1 once input has ended
+    int getDescriptor() const;
+    
 private:
     int lastKey;
+    int inputFd;  // -1 for this process's own terminal
+    bool ended;
+    
+    // This process's terminal settings, restored by cleanup()
+    struct termios savedTerminal;
+    bool terminalSaved;
+    int savedFlags;
+    
+    // Keys queued by pressKey(), oldest first
+    static const int SCRIPT_SIZE = 16;
+    bool scripted;
+    int scriptKeys[SCRIPT_SIZE];
+    int scriptStart;
+    int scriptCount;
     
+    int readKey();
     bool checkKey(int key);
 };
 
@@ -0,0 +1,134 @@
+#include "item_pool.h"
+#include "glow_table.h"
+
+const int EXPIRY_WARNING_MS = 2000;  // Power-ups blink for this long before vanishing
+const int EXPIRY_BLINK_MS = 125;
+
+namespace {
+    // Power-ups keep their own symbol and only take the glow's colour
+    const char ITEM_CHARS[] = {0, '>', '<', '?'};
+    static_assert(sizeof(ITEM_CHARS) == static_cast<size_t>(ItemKind::COUNT), "one symbol per kind");
+}
+
+ItemPool::ItemPool()
+    : grid(nullptr),
+      time(0) {
+    
+    xs.reserve(CAPACITY);
+    ys.reserve(CAPACITY);
+    bornTimes.reserve(CAPACITY);
+    expiryTimes.reserve(CAPACITY);
+    kinds.reserve(CAPACITY);
+    
+    for (int& n : counts) {
+        n = 0;
+    }
+}
+
+void ItemPool::setGrid(WorldGrid* worldGrid) {
+    grid = worldGrid;
+}
+
+void ItemPool::clear() {
+    for (size_t i = 0; i < xs.size(); i++) {
+        grid->clearItem(xs[i], ys[i], static_cast<int>(i));
+    }
+    
+    time = 0;
+    xs.clear();
+    ys.clear();
+    bornTimes.clear();
+    expiryTimes.clear();
+    kinds.clear();
+    
+    for (int& n : counts) {
+        n = 0;
+    }
+}
+
+int ItemPool::add(int x, int y, ItemKind kind, int lifetimeMs) {
+    if (xs.size() >= static_cast<size_t>(CAPACITY)) {
+        return WorldGrid::NO_ITEM;
+    }
+    
+    int slot = static_cast<int>(xs.size());
+    xs.push_back(x);
+    ys.push_back(y);
+    bornTimes.push_back(time);
+    expiryTimes.push_back(lifetimeMs > 0 ? time + lifetimeMs : 0);
+    kinds.push_back(kind);
+    counts[static_cast<int>(kind)]++;
+    
+    grid->setItem(x, y, slot);
+    return slot;
+}
+
+void ItemPool::remove(int slot) {
+    grid->clearItem(xs[slot], ys[slot], slot);
+    counts[static_cast<int>(kinds[slot])]--;
+    
+    // Fill the hole with the last item, which moves to this slot
+    int last = static_cast<int>(xs.size()) - 1;
+    if (slot != last) {
+        xs[slot] = xs[last];
+        ys[slot] = ys[last];
+        bornTimes[slot] = bornTimes[last];
+        expiryTimes[slot] = expiryTimes[last];
+        kinds[slot] = kinds[last];
+        
+        if (grid->getItem(xs[slot], ys[slot]) == last) {
+            grid->setItem(xs[slot], ys[slot], slot);
+        }
+    }
+    
+    xs.pop_back();
+    ys.pop_back();
+    bornTimes.pop_back();
+    expiryTimes.pop_back();
+    kinds.pop_back();
+}
+
+void ItemPool::advance(int elapsedMs) {
+    time += elapsedMs;
+    
+    // Backwards, so the item moved into a freed slot has been checked already
+    for (int i = static_cast<int>(xs.size()) - 1; i >= 0; i--) {
+        if (expiryTimes[i] != 0 && expiryTimes[i] <= time) {
+            remove(i);
+        }
+    }
+}
+
+void ItemPool::render(Renderer& renderer) const {
+    for (size_t i = 0; i < xs.size(); i++) {
+        // Flicker out over the last moments of a power-up's life
+        if (expiryTimes[i] != 0 && expiryTimes[i] - time < EXPIRY_WARNING_MS &&
+            (expiryTimes[i] - time) / EXPIRY_BLINK_MS % 2 == 0) {
+            continue;
+        }
+        
+        const GlowLook& look = GlowTable::at(time - bornTimes[i]);
+        char ch = kinds[i] == ItemKind::FOOD ? look.ch : ITEM_CHARS[static_cast<int>(kinds[i])];
+        renderer.drawWorldChar(xs[i], ys[i], ch, look.color);
+    }
+}
+
+int ItemPool::getX(int slot) const {
+    return xs[slot];
+}
+
+int ItemPool::getY(int slot) const {
+    return ys[slot];
+}
+
+ItemKind ItemPool::getKind(int slot) const {
+    return kinds[slot];
+}
+
+size_t ItemPool::size() const {
+    return xs.size();
+}
+
+int ItemPool::count(ItemKind kind) const {
+    return counts[static_cast<int>(kind)];
+}
@@ -0,0 +1,76 @@
+#ifndef ITEM_POOL_H
+#define ITEM_POOL_H
+
+#include "renderer.h"
+#include "world_grid.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Things lying on the board for a snake to pick up
+enum class ItemKind : uint8_t {
+    FOOD,
+    SPEED,   // Moves the snake faster for a while
+    SHRINK,  // Takes a few segments off the tail
+    GHOST,   // Lets the snake pass through other snakes for a while
+    COUNT  // Keep this last for counting
+};
+
+// Every item on the board, kept as parallel arrays with room for CAPACITY.
+//
+// Each item's cell in the world grid holds its slot here, so finding what
+// is on a cell is one grid lookup however many items there are. Removing
+// an item moves the last one into its slot (and rewrites that item's cell),
+// which keeps the arrays packed with no holes to skip. The arrays are
+// reserved up front, so adding and removing items allocates nothing.
+//
+// Items pulse on a timeline of their own that only moves with advance(),
+// looking up their glow in the shared GlowTable by age.
+class ItemPool {
+public:
+    static const int CAPACITY = 1024;
+    static_assert(CAPACITY <= WorldGrid::MAX_ITEMS, "every slot must fit in a grid cell");
+    
+    ItemPool();
+    
+    // Record items in `worldGrid` (not owned); needed before anything is added
+    void setGrid(WorldGrid* worldGrid);
+    
+    // Drop every item, freeing their cells, and restart the timeline
+    void clear();
+    
+    // Put an item on the empty cell (x, y) that disappears by itself after
+    // `lifetimeMs`, or stays until picked up if that is 0. Returns its slot,
+    // or WorldGrid::NO_ITEM if the pool is full.
+    int add(int x, int y, ItemKind kind, int lifetimeMs);
+    
+    // Take the item in `slot` off the board. Its cell is only cleared if the
+    // item still holds it; a snake that moved onto it keeps it.
+    void remove(int slot);
+    
+    // Move the timeline on, dropping items whose time has run out
+    void advance(int elapsedMs);
+    
+    // Draw every item through the renderer's viewport
+    void render(Renderer& renderer) const;
+    
+    int getX(int slot) const;
+    int getY(int slot) const;
+    ItemKind getKind(int slot) const;
+    
+    size_t size() const;
+    int count(ItemKind kind) const;
+    
+private:
+    WorldGrid* grid;
+    int time;  // Milliseconds since clear()
+    
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<int> bornTimes;
+    std::vector<int> expiryTimes;  // 0 for items that never expire
+    std::vector<ItemKind> kinds;
+    int counts[static_cast<int>(ItemKind::COUNT)];
+};
+
+#endif // ITEM_POOL_H
@@ -1,22 +1,305 @@
+#include "arcade_daemon.h"
 #include "game.h"
+#include "net_client.h"
+#include "net_server.h"
+#include "soak_runner.h"
 #include <iostream>
 #include <csignal>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
 
 Game* gameInstance = nullptr;
+NetServer* serverInstance = nullptr;
+NetClient* clientInstance = nullptr;
+ArcadeDaemon* daemonInstance = nullptr;
+SoakRunner* soakInstance = nullptr;
+
+// Largest world edge accepted on the command line
+const int MAX_WORLD_SIZE = net::MAX_WORLD_SIZE;
+const int MAX_BOTS = 10000;
+const int MAX_FOODS = 1000;
+const int DEFAULT_MAX_SESSIONS = 4096;
+
+// Network play, on top of the game options
+struct NetOptions {
+    bool server;
+    std::string connectHost;  // Empty for a local game
+    int port;
+    int lossPercent;          // Simulated link quality, for testing
+    int latencyMs;
+    
+    // Arcade daemon: serve many local sessions, or join one
+    std::string daemonPath;
+    std::string attachPath;
+    std::string watchPath;
+    int maxSessions;
+    
+    // Headless soak test instead of a game: rounds to play, 0 for none
+    int soakGames;
+    
+    NetOptions() : server(false), port(net::DEFAULT_PORT), lossPercent(0), latencyMs(0), maxSessions(DEFAULT_MAX_SESSIONS),
+                   soakGames(0) {}
+};
 
 void signalHandler(int signum) {
+    // The servers shut down cleanly from their own loops
+    if (serverInstance) {
+        serverInstance->stop();
+        return;
+    }
+    if (daemonInstance) {
+        daemonInstance->stop();
+        return;
+    }
+    if (soakInstance) {
+        soakInstance->stop();
+        return;
+    }
+    
     if (gameInstance) {
         gameInstance->cleanup();
     }
+    if (clientInstance) {
+        clientInstance->cleanup();
+    }
     exit(signum);
 }
 
-int main() {
+void resizeHandler(int) {
+    Renderer::noteTerminalResized();
+}
+
+// A crash cannot run the normal cleanup, so put the user's screen and
+// cursor back with async-signal-safe calls only, then die as before
+void crashHandler(int signum) {
+    const char restore[] = "\033[?2026l\033[?25h\033[?1049l";
+    ssize_t ignored = ::write(STDOUT_FILENO, restore, sizeof(restore) - 1);
+    (void)ignored;
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--world WIDTHxHEIGHT] [--packed-body] [--players 1|2] [--bots N] [--food N]\n"
+              << "       " << program << " --server [--port N] [--world WIDTHxHEIGHT]\n"
+              << "       " << program << " --connect HOST[:PORT]\n"
+              << "       " << program << " --daemon PATH [--max-sessions N] [--world WIDTHxHEIGHT]\n"
+              << "       " << program << " --attach PATH\n"
+              << "       " << program << " --watch PATH\n"
+              << "       " << program << " --soak GAMES [--world WIDTHxHEIGHT] [--players 1|2] [--bots N] [--food N]\n"
+              << "Repeatable food, levels and bots: [--seed N]\n"
+              << "Spectators: [--broadcast PATH] on a local game\n"
+              << "Frame timing: [--perf-csv PATH] [--trace PATH] on a local game\n"
+              << "Network testing: [--net-loss PERCENT] [--net-latency MS]" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], GameOptions& options, NetOptions& netOptions) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+            int w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) != 2 ||
+                w <= 0 || h <= 0 || w > MAX_WORLD_SIZE || h > MAX_WORLD_SIZE) {
+                std::cerr << "Invalid world size: " << argv[i] << std::endl;
+                return false;
+            }
+            options.worldWidth = w;
+            options.worldHeight = h;
+        } else if (std::strcmp(argv[i], "--packed-body") == 0) {
+            options.packedBody = true;
+        } else if (std::strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+            options.players = std::atoi(argv[++i]);
+            if (options.players < 1 || options.players > 2) {
+                std::cerr << "Players must be 1 or 2" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            options.bots = std::atoi(argv[++i]);
+            if (options.bots < 0 || options.bots > MAX_BOTS) {
+                std::cerr << "Bots must be between 0 and " << MAX_BOTS << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--food") == 0 && i + 1 < argc) {
+            options.foods = std::atoi(argv[++i]);
+            if (options.foods < 1 || options.foods > MAX_FOODS) {
+                std::cerr << "Food must be between 1 and " << MAX_FOODS << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--server") == 0) {
+            netOptions.server = true;
+        } else if (std::strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            netOptions.connectHost = argv[++i];
+            size_t colon = netOptions.connectHost.rfind(':');
+            if (colon != std::string::npos) {
+                netOptions.port = std::atoi(netOptions.connectHost.c_str() + colon + 1);
+                netOptions.connectHost.erase(colon);
+            }
+        } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            netOptions.port = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc) {
+            netOptions.lossPercent = std::atoi(argv[++i]);
+            if (netOptions.lossPercent < 0 || netOptions.lossPercent > 100) {
+                std::cerr << "Packet loss must be between 0 and 100 percent" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--net-latency") == 0 && i + 1 < argc) {
+            netOptions.latencyMs = std::atoi(argv[++i]);
+            if (netOptions.latencyMs < 0) {
+                std::cerr << "Latency cannot be negative" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--daemon") == 0 && i + 1 < argc) {
+            netOptions.daemonPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--attach") == 0 && i + 1 < argc) {
+            netOptions.attachPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc) {
+            options.broadcastPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--perf-csv") == 0 && i + 1 < argc) {
+            options.perfCsvPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            netOptions.soakGames = std::atoi(argv[++i]);
+            if (netOptions.soakGames < 1) {
+                std::cerr << "Soak games must be at least 1" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            netOptions.watchPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+            netOptions.maxSessions = std::atoi(argv[++i]);
+            if (netOptions.maxSessions < 1) {
+                std::cerr << "Max sessions must be at least 1" << std::endl;
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    
+    // Every daemon session would try to claim the same socket
+    if (!options.broadcastPath.empty() && !netOptions.daemonPath.empty()) {
+        std::cerr << "--broadcast cannot be combined with --daemon" << std::endl;
+        return false;
+    }
+    if ((!options.perfCsvPath.empty() || !options.tracePath.empty()) && !netOptions.daemonPath.empty()) {
+        std::cerr << "--perf-csv and --trace cannot be combined with --daemon" << std::endl;
+        return false;
+    }
+    
+    // A soak test has no terminal, network or spectators
+    if (netOptions.soakGames > 0 &&
+        (netOptions.server || !netOptions.connectHost.empty() || !netOptions.daemonPath.empty() ||
+         !netOptions.attachPath.empty() || !netOptions.watchPath.empty() || !options.broadcastPath.empty() ||
+         !options.perfCsvPath.empty() || !options.tracePath.empty())) {
+        std::cerr << "--soak runs on its own and cannot be combined with other modes" << std::endl;
+        return false;
+    }
+    
+    if (netOptions.port <= 0 || netOptions.port > 65535) {
+        std::cerr << "Invalid port: " << netOptions.port << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+int runServer(const GameOptions& options, const NetOptions& netOptions) {
+    NetServer server(std::max(options.worldWidth, net::MIN_WORLD_WIDTH), std::max(options.worldHeight, net::MIN_WORLD_HEIGHT));
+    server.open(netOptions.port);
+    server.getSocket().setLinkSimulation(netOptions.lossPercent, netOptions.latencyMs);
+    
+    serverInstance = &server;
+    server.run();
+    serverInstance = nullptr;
+    return 0;
+}
+
+int runClient(const NetOptions& netOptions) {
+    NetAddress address;
+    if (!NetAddress::resolve(netOptions.connectHost, netOptions.port, address)) {
+        std::cerr << "Unknown host: " << netOptions.connectHost << std::endl;
+        return 1;
+    }
+    
+    NetClient client;
+    client.connect(address);
+    client.getSocket().setLinkSimulation(netOptions.lossPercent, netOptions.latencyMs);
+    
+    clientInstance = &client;
+    client.run();
+    clientInstance = nullptr;
+    return 0;
+}
+
+int runDaemon(const GameOptions& options, const NetOptions& netOptions) {
+    ArcadeDaemon daemon(options, netOptions.maxSessions);
+    daemon.open(netOptions.daemonPath);
+    
+    daemonInstance = &daemon;
+    daemon.run();
+    daemonInstance = nullptr;
+    return 0;
+}
+
+int runSoak(const GameOptions& options, const NetOptions& netOptions) {
+    SoakRunner soak(options, netOptions.soakGames);
+    
+    soakInstance = &soak;
+    bool passed = soak.run();
+    soakInstance = nullptr;
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    GameOptions options;
+    NetOptions netOptions;
+    if (!parseOptions(argc, argv, options, netOptions)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
     // Set up signal handling for clean exit
     signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+    signal(SIGHUP, signalHandler);
+    signal(SIGQUIT, signalHandler);
+    
+    // Everything but the servers and the soak test draws on this terminal
+    if (!netOptions.server && netOptions.daemonPath.empty() && netOptions.soakGames == 0) {
+        signal(SIGWINCH, resizeHandler);
+        signal(SIGSEGV, crashHandler);
+        signal(SIGBUS, crashHandler);
+        signal(SIGFPE, crashHandler);
+        signal(SIGABRT, crashHandler);
+    }
     
     try {
-        Game game;
+        if (netOptions.server) {
+            return runServer(options, netOptions);
+        }
+        if (!netOptions.connectHost.empty()) {
+            return runClient(netOptions);
+        }
+        if (!netOptions.daemonPath.empty()) {
+            return runDaemon(options, netOptions);
+        }
+        if (netOptions.soakGames > 0) {
+            return runSoak(options, netOptions);
+        }
+        if (!netOptions.attachPath.empty()) {
+            return attachToArcade(netOptions.attachPath);
+        }
+        if (!netOptions.watchPath.empty()) {
+            return attachToArcade(netOptions.watchPath, false);
+        }
+        
+        Game game(options);
         gameInstance = &game;
         game.run();
     } catch (const std::exception& e) {
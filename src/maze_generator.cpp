@@ -0,0 +1,178 @@
+#include "maze_generator.h"
+#include <algorithm>
+#include <climits>
+
+// Number of walls held back for random ordering (see advance)
+const size_t MAX_POOL_SIZE = 256;
+
+MazeGenerator::MazeGenerator()
+    : width(0),
+      height(0),
+      roomsX(0),
+      roomsY(0),
+      shift(0),
+      nextRow(0),
+      done(true),
+      keepThreshold(0) {
+}
+
+void MazeGenerator::generate(unsigned int seed, int w, int h, float density,
+                             std::vector<unsigned char>& out) {
+    start(seed, w, h, density);
+    advance(INT_MAX);
+    takeCells(out);
+}
+
+void MazeGenerator::start(unsigned int seed, int w, int h, float density) {
+    width = std::max(w, 0);
+    height = std::max(h, 0);
+    cells.assign(static_cast<size_t>(width) * height, 0);
+    
+    // Rooms sit on even coordinates, walls between them on odd ones. Room ids
+    // use a power-of-two row stride so they decode with shifts, not divisions.
+    roomsX = (width + 1) / 2;
+    roomsY = (height + 1) / 2;
+    shift = 0;
+    while ((1 << shift) < roomsX) {
+        shift++;
+    }
+    
+    // Negative values are set sizes, others point at the parent room
+    parent.assign(static_cast<size_t>(roomsY) << shift, -1);
+    
+    double clamped = std::min(std::max(static_cast<double>(density), 0.0), 1.0);
+    keepThreshold = static_cast<uint32_t>(clamped * 4294967295.0);
+    
+    rng.reseed(seed);
+    pool.clear();
+    pool.reserve(MAX_POOL_SIZE);
+    nextRow = 0;
+    done = false;
+}
+
+bool MazeGenerator::advance(int roomRows) {
+    if (done) {
+        return true;
+    }
+    
+    // Kruskal wants the walls in random order. A full shuffle makes the
+    // union-find lookups jump all over large boards, so walls are streamed in
+    // scan order through a small random pool instead: the order is random
+    // within a band of rows and the working set stays in cache.
+    int endRow = roomsY;
+    if (roomRows < roomsY - nextRow) {
+        endRow = nextRow + roomRows;
+    }
+    
+    for (; nextRow < endRow; nextRow++) {
+        int ry = nextRow;
+        
+        for (int rx = 0; rx < roomsX; rx++) {
+            int room = (ry << shift) | rx;
+            
+            for (int down = 0; down < 2; down++) {
+                bool exists = down ? (ry + 1 < roomsY) : (rx + 1 < roomsX);
+                if (!exists) {
+                    continue;
+                }
+                
+                int edge = room * 2 + down;
+                if (pool.size() < MAX_POOL_SIZE) {
+                    pool.push_back(edge);
+                } else {
+                    size_t j = rng.nextBelow(static_cast<uint32_t>(MAX_POOL_SIZE));
+                    processWall(pool[j]);
+                    pool[j] = edge;
+                }
+            }
+        }
+    }
+    
+    if (nextRow < roomsY) {
+        return false;
+    }
+    
+    // Drain what is left of the pool in random order
+    for (size_t i = pool.size(); i > 0; i--) {
+        size_t j = rng.nextBelow(static_cast<uint32_t>(i));
+        processWall(pool[j]);
+        pool[j] = pool[i - 1];
+    }
+    pool.clear();
+    
+    fillPillars();
+    done = true;
+    return true;
+}
+
+bool MazeGenerator::isDone() const {
+    return done;
+}
+
+void MazeGenerator::takeCells(std::vector<unsigned char>& out) {
+    out.swap(cells);
+}
+
+void MazeGenerator::processWall(int edge) {
+    int room = edge >> 1;
+    bool down = (edge & 1) != 0;
+    int other = down ? room + (1 << shift) : room + 1;
+    
+    // Walls that join two separate regions are opened; the rest are
+    // redundant and may stay as obstacles without breaking connectivity
+    if (!unite(room, other) && rng.next() < keepThreshold) {
+        int rx = room & ((1 << shift) - 1);
+        int ry = room >> shift;
+        int wx = rx * 2 + (down ? 0 : 1);
+        int wy = ry * 2 + (down ? 1 : 0);
+        cells[static_cast<size_t>(wy) * width + wx] = 1;
+    }
+}
+
+void MazeGenerator::fillPillars() {
+    // Fill pillars (odd, odd) that touch a kept wall so walls look continuous.
+    // A pillar with no kept neighbour stays free and is reachable through them.
+    for (int y = 1; y < height; y += 2) {
+        unsigned char* row = &cells[static_cast<size_t>(y) * width];
+        const unsigned char* above = row - width;
+        const unsigned char* below = (y + 1 < height) ? row + width : nullptr;
+        
+        for (int x = 1; x < width; x += 2) {
+            bool touchesWall = row[x - 1] || above[x] ||
+                               (x + 1 < width && row[x + 1]) ||
+                               (below && below[x]);
+            if (touchesWall) {
+                row[x] = 1;
+            }
+        }
+    }
+}
+
+int MazeGenerator::findRoot(int room) {
+    // Path halving keeps the trees shallow without recursion
+    while (parent[room] >= 0) {
+        int next = parent[room];
+        if (parent[next] >= 0) {
+            parent[room] = parent[next];
+        }
+        room = next;
+    }
+    return room;
+}
+
+bool MazeGenerator::unite(int a, int b) {
+    a = findRoot(a);
+    b = findRoot(b);
+    
+    if (a == b) {
+        return false;
+    }
+    
+    // Union by size: attach the smaller tree under the larger one
+    if (parent[a] > parent[b]) {
+        std::swap(a, b);
+    }
+    parent[a] += parent[b];
+    parent[b] = a;
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef MAZE_GENERATOR_H
+#define MAZE_GENERATOR_H
+
+#include "utils.h"
+#include <cstdint>
+#include <vector>
+
+// Builds obstacle layouts for a rectangular play area.
+//
+// The area is treated as a lattice of "rooms" on even coordinates with wall
+// cells between them. A randomized Kruskal pass (union-find) opens just enough
+// walls to connect every room, then only a fraction of the remaining walls is
+// kept. Removing walls never disconnects anything, so every free cell stays
+// reachable from every other free cell.
+//
+// Generation can run all at once or be spread over several frames with
+// start()/advance() so large boards never cause a visible hitch.
+class MazeGenerator {
+public:
+    MazeGenerator();
+    
+    // Generate a complete layout into `cells` (width * height, row-major):
+    // 1 for obstacles, 0 for free cells. `density` is the fraction of surplus
+    // maze walls to keep.
+    void generate(unsigned int seed, int width, int height, float density,
+                  std::vector<unsigned char>& cells);
+    
+    // Incremental interface: start a layout, then advance it a few rows of
+    // rooms at a time. advance() returns true once the layout is complete.
+    void start(unsigned int seed, int width, int height, float density);
+    bool advance(int roomRows);
+    bool isDone() const;
+    
+    // Hand the finished layout over by swapping it into `cells`
+    void takeCells(std::vector<unsigned char>& cells);
+    
+private:
+    int width;
+    int height;
+    int roomsX;
+    int roomsY;
+    int shift;         // Room ids are (ry << shift) | rx
+    int nextRow;       // Next row of rooms to feed into the pool
+    bool done;
+    uint32_t keepThreshold;
+    utils::Random rng;
+    
+    // Storage reused between levels to avoid reallocating
+    std::vector<unsigned char> cells;
+    std::vector<int> parent;
+    std::vector<int> pool;
+    
+    void processWall(int edge);
+    void fillPillars();
+    int findRoot(int room);
+    bool unite(int a, int b);
+};
+
+#endif // MAZE_GENERATOR_H
@@ -0,0 +1,639 @@
+#include "net_client.h"
+#include <algorithm>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <unistd.h>
+
+using namespace net;
+
+const int FRAME_MS = 33;                    // Redraw rate while connected
+const uint32_t MAX_PREDICT_TICKS = 16;      // Never draw further ahead than this
+const size_t MAX_KEPT_INPUTS = 32;
+const uint32_t MAX_KEYFRAME_FRAGMENTS = 4096;
+const char HEAD_CHARS[4] = {'^', 'v', '<', '>'};  // Indexed by step code
+
+NetClient::NetClient()
+    : running(false),
+      snakes(MAX_PLAYERS),
+      connected(false),
+      hasState(false),
+      stateTick(0),
+      playerId(-1),
+      worldWidth(0),
+      worldHeight(0),
+      predictTick(0),
+      rttMs(0),
+      nextInputSeq(0),
+      lastDirection(Direction::NONE),
+      startTime(Clock::now()),
+      lastHeard(Clock::now()),
+      keyframeTick(0),
+      keyframeFragments(0),
+      keyframeReceived(0),
+      keyframeSize(0) {
+    
+    for (auto& snake : snakes) {
+        snake.active = false;
+        snake.lastStep = PackedBody::STEP_RIGHT;
+    }
+}
+
+NetClient::~NetClient() {
+    cleanup();
+}
+
+void NetClient::cleanup() {
+    input.cleanup();
+    renderer.cleanup();
+}
+
+void NetClient::connect(const NetAddress& server) {
+    serverAddress = server;
+    socket.open(0);
+    startTime = Clock::now();
+    lastHeard = startTime;
+    sendHello();
+}
+
+void NetClient::run() {
+    const auto tickLength = std::chrono::milliseconds(TICK_MS);
+    const auto frameLength = std::chrono::milliseconds(FRAME_MS);
+    
+    renderer.initialize(80, 24);
+    input.initialize();
+    running = true;
+    
+    auto nextTick = Clock::now() + tickLength;
+    auto nextFrame = Clock::now();
+    auto lastFrame = Clock::now();
+    std::string exitMessage;
+    
+    // Only wait on the keyboard when it is a terminal; a closed stdin would
+    // report readable forever
+    bool pollKeyboard = isatty(STDIN_FILENO);
+    
+    while (running) {
+        auto now = Clock::now();
+        auto wake = std::min(nextTick, nextFrame);
+        int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count());
+        int delayed = socket.flushDelayed();
+        if (delayed >= 0 && delayed < timeout) {
+            timeout = delayed;
+        }
+        
+        pollfd fds[2];
+        fds[0].fd = socket.getDescriptor();
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = STDIN_FILENO;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        ::poll(fds, pollKeyboard ? 2 : 1, std::max(timeout, 0));
+        
+        receive();
+        
+        Direction dir = input.getDirection();
+        if (dir != Direction::NONE && dir != lastDirection) {
+            sendDirection(dir);
+        }
+        if (input.isQuitPressed()) {
+            running = false;
+            break;
+        }
+        
+        now = Clock::now();
+        if (now - lastHeard > std::chrono::milliseconds(TIMEOUT_MS)) {
+            exitMessage = connected ? "Connection to the server was lost." : "No response from the server.";
+            running = false;
+            break;
+        }
+        
+        if (now >= nextTick) {
+            tick();
+            nextTick += tickLength;
+            if (now - nextTick > std::chrono::seconds(1)) {
+                nextTick = now + tickLength;
+            }
+        }
+        
+        if (now >= nextFrame) {
+            food.update(std::chrono::duration<float>(now - lastFrame).count());
+            lastFrame = now;
+            render();
+            nextFrame = now + frameLength;
+        }
+    }
+    
+    packet.clear();
+    PacketWriter writer(packet);
+    writer.writeHeader(MessageType::BYE);
+    socket.send(serverAddress, packet.data(), packet.size());
+    socket.flushDelayed();
+    
+    cleanup();
+    if (!exitMessage.empty()) {
+        std::cout << "\n" << exitMessage << std::endl;
+    }
+}
+
+void NetClient::receive() {
+    uint8_t buffer[MAX_PACKET_SIZE];
+    NetAddress from;
+    int size;
+    
+    while ((size = socket.receive(from, buffer, sizeof(buffer))) >= 0) {
+        if (from == serverAddress) {
+            handlePacket(buffer, static_cast<size_t>(size));
+        }
+    }
+}
+
+void NetClient::handlePacket(const uint8_t* data, size_t size) {
+    PacketReader reader(data, size);
+    uint8_t type = reader.readHeader();
+    if (!reader.isValid()) {
+        return;
+    }
+    
+    lastHeard = Clock::now();
+    
+    switch (static_cast<MessageType>(type)) {
+        case MessageType::WELCOME:
+            handleWelcome(reader);
+            break;
+        
+        case MessageType::DELTA:
+            handleDelta(reader);
+            break;
+        
+        case MessageType::KEYFRAME:
+            handleKeyframe(reader);
+            break;
+        
+        case MessageType::BYE:
+            running = false;
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void NetClient::handleWelcome(PacketReader& reader) {
+    int id = static_cast<int>(reader.readVarint());
+    int width = static_cast<int>(reader.readVarint());
+    int height = static_cast<int>(reader.readVarint());
+    
+    // Anything out of range would later index past our arrays or size the
+    // view from nonsense; no real server sends it
+    if (connected || !reader.isValid() || id < 0 || id >= MAX_PLAYERS ||
+        width < MIN_WORLD_WIDTH || width > MAX_WORLD_SIZE || height < MIN_WORLD_HEIGHT || height > MAX_WORLD_SIZE) {
+        return;
+    }
+    
+    playerId = id;
+    worldWidth = width;
+    worldHeight = height;
+    connected = true;
+}
+
+void NetClient::handleDelta(PacketReader& reader) {
+    uint32_t baseTick = reader.readVarint();
+    uint32_t timeEcho = reader.readUint32();
+    int count = reader.readByte();
+    
+    if (!reader.isValid()) {
+        return;
+    }
+    
+    // Smoothed round trip from our own clock, echoed back by the server
+    if (timeEcho != 0) {
+        int sample = static_cast<int>(getTimeMs() - timeEcho);
+        rttMs = rttMs == 0 ? sample : (rttMs * 7 + sample) / 8;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        uint32_t length = reader.readVarint();
+        const uint8_t* block = reader.readBytes(length);
+        uint32_t tick = baseTick + 1 + static_cast<uint32_t>(i);
+        
+        if (!reader.isValid() || !hasState) {
+            return;
+        }
+        
+        // Blocks we already have come first when our ack was still in flight
+        if (tick <= stateTick) {
+            continue;
+        }
+        if (tick != stateTick + 1) {
+            return;
+        }
+        
+        if (!applyBlock(block, length)) {
+            // Something is badly out of step; start over from a keyframe
+            hasState = false;
+            return;
+        }
+        stateTick = tick;
+    }
+}
+
+void NetClient::handleKeyframe(PacketReader& reader) {
+    uint32_t tick = reader.readVarint();
+    uint32_t index = reader.readVarint();
+    uint32_t fragments = reader.readVarint();
+    size_t length = reader.remaining();
+    const uint8_t* payload = reader.readBytes(length);
+    
+    if (!reader.isValid() || fragments == 0 || fragments > MAX_KEYFRAME_FRAGMENTS || index >= fragments ||
+        length > KEYFRAME_FRAGMENT_SIZE || (index + 1 < fragments && length != KEYFRAME_FRAGMENT_SIZE)) {
+        return;
+    }
+    
+    // Deltas have already brought us this far
+    if (hasState && tick <= stateTick) {
+        return;
+    }
+    
+    if (tick != keyframeTick || fragments != keyframeFragments) {
+        keyframeTick = tick;
+        keyframeFragments = fragments;
+        keyframeReceived = 0;
+        keyframeSize = fragments * KEYFRAME_FRAGMENT_SIZE;
+        keyframeData.assign(keyframeSize, 0);
+        keyframeHave.assign(fragments, false);
+    }
+    
+    if (keyframeHave[index]) {
+        return;
+    }
+    
+    std::copy(payload, payload + length, keyframeData.begin() + index * KEYFRAME_FRAGMENT_SIZE);
+    keyframeHave[index] = true;
+    keyframeReceived++;
+    if (index + 1 == fragments) {
+        keyframeSize = index * KEYFRAME_FRAGMENT_SIZE + length;
+    }
+    
+    if (keyframeReceived == keyframeFragments) {
+        if (applyKeyframe(keyframeData.data(), keyframeSize)) {
+            hasState = true;
+            stateTick = tick;
+        }
+        keyframeFragments = 0;
+    }
+}
+
+bool NetClient::applyBlock(const uint8_t* data, size_t size) {
+    PacketReader reader(data, size);
+    
+    uint8_t blockFlags = reader.readByte();
+    int newFoodX = 0, newFoodY = 0;
+    if (blockFlags & BLOCK_FOOD_MOVED) {
+        newFoodX = static_cast<int>(reader.readVarint());
+        newFoodY = static_cast<int>(reader.readVarint());
+    }
+    
+    uint32_t count = reader.readVarint();
+    blockEvents.clear();
+    
+    for (uint32_t i = 0; i < count && reader.isValid(); i++) {
+        BlockEvent event;
+        event.id = static_cast<int>(reader.readVarint());
+        event.flags = reader.readByte();
+        event.x = event.y = 0;
+        if (event.flags & EVENT_SPAWNED) {
+            event.x = static_cast<int>(reader.readVarint());
+            event.y = static_cast<int>(reader.readVarint());
+        }
+        
+        if (event.id < 0 || event.id >= MAX_PLAYERS) {
+            return false;
+        }
+        blockEvents.push_back(event);
+    }
+    
+    if (!reader.isValid()) {
+        return false;
+    }
+    
+    // Same order as NetServer::tick: every move, then deaths, then spawns
+    for (const auto& event : blockEvents) {
+        if (event.flags & EVENT_MOVED) {
+            moveSnake(event.id, event.flags);
+        }
+    }
+    for (const auto& event : blockEvents) {
+        if (event.flags & EVENT_DIED) {
+            removeSnake(event.id);
+        }
+    }
+    for (const auto& event : blockEvents) {
+        if (event.flags & EVENT_SPAWNED) {
+            spawnSnake(event.id, event.x, event.y);
+        }
+    }
+    
+    if (blockFlags & BLOCK_FOOD_MOVED) {
+        food.setPosition(newFoodX, newFoodY);
+    }
+    
+    return true;
+}
+
+bool NetClient::applyKeyframe(const uint8_t* data, size_t size) {
+    PacketReader reader(data, size);
+    
+    int newFoodX = static_cast<int>(reader.readVarint());
+    int newFoodY = static_cast<int>(reader.readVarint());
+    uint32_t count = reader.readVarint();
+    
+    world.clear();
+    for (auto& snake : snakes) {
+        snake.active = false;
+        snake.body.clear();
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        int id = static_cast<int>(reader.readVarint());
+        int headX = static_cast<int>(reader.readVarint());
+        int headY = static_cast<int>(reader.readVarint());
+        uint32_t steps = reader.readVarint();
+        
+        // Four steps to a byte, checked before rounding up so a huge count
+        // cannot wrap around to a short read
+        if (!reader.isValid() || id < 0 || id >= MAX_PLAYERS || steps > static_cast<uint64_t>(reader.remaining()) * 4) {
+            return false;
+        }
+        const uint8_t* packed = reader.readBytes((static_cast<size_t>(steps) + 3) / 4);
+        if (!reader.isValid()) {
+            return false;
+        }
+        
+        // Steps are listed from the head; walk back to find the tail
+        stepCodes.resize(steps);
+        int x = headX;
+        int y = headY;
+        for (uint32_t s = 0; s < steps; s++) {
+            uint8_t code = (packed[s >> 2] >> ((s & 3) * 2)) & 3;
+            stepCodes[s] = code;
+            x -= PackedBody::STEP_DX[code];
+            y -= PackedBody::STEP_DY[code];
+        }
+        
+        // Then rebuild the body from the tail forwards
+        RemoteSnake& snake = snakes[id];
+        snake.body.reset(x, y);
+        world.setSnake(x, y, id);
+        for (uint32_t s = steps; s > 0; s--) {
+            uint8_t code = stepCodes[s - 1];
+            snake.body.pushHead(static_cast<PackedBody::Step>(code));
+            world.setSnake(snake.body.getHeadX(), snake.body.getHeadY(), id);
+        }
+        
+        snake.active = true;
+        snake.lastStep = steps > 0 ? stepCodes[0] : static_cast<uint8_t>(PackedBody::STEP_RIGHT);
+    }
+    
+    food.setPosition(newFoodX, newFoodY);
+    return reader.isValid();
+}
+
+void NetClient::moveSnake(int id, uint8_t flags) {
+    RemoteSnake& snake = snakes[id];
+    if (!snake.active) {
+        return;
+    }
+    
+    // Mirrors Snake::step: the tail leaves first, and the head only takes
+    // its new cell if nothing else is there
+    if (flags & EVENT_POP_TAIL) {
+        world.clearSnake(snake.body.getTailX(), snake.body.getTailY(), id);
+        snake.body.popTail();
+    }
+    
+    uint8_t code = flags & EVENT_STEP_MASK;
+    int headX = snake.body.getHeadX() + PackedBody::STEP_DX[code];
+    int headY = snake.body.getHeadY() + PackedBody::STEP_DY[code];
+    if (world.get(headX, headY) == CellType::EMPTY) {
+        world.setSnake(headX, headY, id);
+    }
+    
+    snake.body.pushHead(static_cast<PackedBody::Step>(code));
+    snake.lastStep = code;
+}
+
+void NetClient::removeSnake(int id) {
+    RemoteSnake& snake = snakes[id];
+    
+    snake.body.forEachFromHead([&](int x, int y) {
+        world.clearSnake(x, y, id);
+    });
+    snake.body.clear();
+    snake.active = false;
+}
+
+void NetClient::spawnSnake(int id, int x, int y) {
+    if (snakes[id].active) {
+        removeSnake(id);
+    }
+    
+    // Same three-segment start as Snake::initialize
+    RemoteSnake& snake = snakes[id];
+    snake.body.reset(x - 2, y);
+    world.setSnake(x - 2, y, id);
+    for (int i = 1; i < 3; i++) {
+        snake.body.pushHead(PackedBody::STEP_RIGHT);
+        world.setSnake(x - 2 + i, y, id);
+    }
+    
+    snake.active = true;
+    snake.lastStep = PackedBody::STEP_RIGHT;
+}
+
+void NetClient::tick() {
+    if (!connected) {
+        sendHello();
+        return;
+    }
+    
+    // Stay about one round trip ahead of the last tick the server sent, so
+    // inputs stamped with our tick reach it in time
+    uint32_t lead = static_cast<uint32_t>(rttMs / TICK_MS) + 1;
+    uint32_t target = stateTick + lead;
+    predictTick++;
+    if (predictTick < target || predictTick > target + 2) {
+        predictTick = target;
+    }
+    
+    sendInputs();
+}
+
+void NetClient::sendDirection(Direction direction) {
+    lastDirection = direction;
+    if (!connected) {
+        return;
+    }
+    
+    SentInput sent;
+    sent.seq = ++nextInputSeq;
+    sent.tick = predictTick + 1;
+    sent.direction = direction;
+    
+    if (inputs.size() >= MAX_KEPT_INPUTS) {
+        inputs.erase(inputs.begin());
+    }
+    inputs.push_back(sent);
+    
+    sendInputs();
+}
+
+void NetClient::sendHello() {
+    packet.clear();
+    PacketWriter writer(packet);
+    writer.writeHeader(MessageType::HELLO);
+    writer.writeByte(PROTOCOL_VERSION);
+    
+    socket.send(serverAddress, packet.data(), packet.size());
+}
+
+void NetClient::sendInputs() {
+    packet.clear();
+    PacketWriter writer(packet);
+    
+    writer.writeHeader(MessageType::INPUT);
+    writer.writeVarint(hasState ? stateTick + 1 : 0);
+    writer.writeUint32(getTimeMs());
+    
+    // Repeat the last few inputs so a lost packet costs nothing
+    size_t count = std::min(inputs.size(), static_cast<size_t>(MAX_SENT_INPUTS));
+    writer.writeByte(static_cast<uint8_t>(count));
+    for (size_t i = inputs.size() - count; i < inputs.size(); i++) {
+        writer.writeVarint(inputs[i].seq);
+        writer.writeVarint(inputs[i].tick);
+        writer.writeByte(static_cast<uint8_t>(inputs[i].direction));
+    }
+    
+    socket.send(serverAddress, packet.data(), packet.size());
+}
+
+uint32_t NetClient::getTimeMs() const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startTime);
+    
+    // Zero is reserved for "no time yet"
+    return static_cast<uint32_t>(elapsed.count()) + 1;
+}
+
+void NetClient::render() {
+    renderer.clear();
+    
+    if (!hasState) {
+        std::string status = connected ? "Joining the game..." : "Connecting to " + serverAddress.toString() + "...";
+        renderer.drawText(40 - static_cast<int>(status.length()) / 2, 12, status, ColorPair::SUBTITLE);
+        renderer.refresh();
+        return;
+    }
+    
+    const RemoteSnake& own = snakes[playerId];
+    int width = renderer.getWidth();
+    int height = renderer.getHeight();
+    
+    // Follow our own head like the local game does
+    if (own.active) {
+        int originX = std::max(0, std::min(own.body.getHeadX() - width / 2, worldWidth - width));
+        int originY = std::max(0, std::min(own.body.getHeadY() - height / 2, worldHeight - height));
+        renderer.setViewport(originX, originY);
+    }
+    
+    renderer.drawWorldBorder(worldWidth, worldHeight);
+    
+    GridRect view = {renderer.getViewX(), renderer.getViewY(), width, height};
+    world.forEachInRect(view, [&](int x, int y, CellType, int owner) {
+        if (owner == playerId) {
+            ColorPair color = ((x + y) & 1) ? ColorPair::SNAKE_BODY_2 : ColorPair::SNAKE_BODY_1;
+            renderer.drawWorldChar(x, y, 'o', color);
+        } else {
+            renderer.drawWorldChar(x, y, '=', ColorPair::RIVAL_BODY);
+        }
+    });
+    
+    int playerCount = 0;
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        const RemoteSnake& snake = snakes[id];
+        if (snake.active) {
+            playerCount++;
+            renderer.drawWorldChar(snake.body.getHeadX(), snake.body.getHeadY(), HEAD_CHARS[snake.lastStep], ColorPair::SNAKE_HEAD);
+        }
+    }
+    
+    drawPrediction();
+    food.render(renderer);
+    
+    std::stringstream ss;
+    ss << "Online | Players: " << playerCount << " | Length: " << own.body.size() << " | Ping: " << rttMs << " ms";
+    renderer.drawText(1, 0, ss.str(), ColorPair::SCORE);
+    
+    renderer.refresh();
+}
+
+void NetClient::drawPrediction() {
+    const RemoteSnake& own = snakes[playerId];
+    if (!own.active) {
+        return;
+    }
+    
+    // Replay our own turns on top of the server's state, up to the tick we
+    // expect the server to be at. The last turn stamped for a tick wins and
+    // reversing is ignored, exactly as in Snake::step.
+    int x = own.body.getHeadX();
+    int y = own.body.getHeadY();
+    uint8_t code = own.lastStep;
+    uint32_t last = std::min(predictTick, stateTick + MAX_PREDICT_TICKS);
+    
+    for (uint32_t t = stateTick + 1; t <= last; t++) {
+        Direction turn = Direction::NONE;
+        for (const auto& sent : inputs) {
+            if (sent.tick == t) {
+                turn = sent.direction;
+            }
+        }
+        
+        if (turn != Direction::NONE) {
+            uint8_t turnCode = static_cast<uint8_t>(static_cast<int>(turn) - 1);
+            if (turnCode != (code ^ 1)) {
+                code = turnCode;
+            }
+        }
+        
+        renderer.drawWorldChar(x, y, 'o', ColorPair::SNAKE_BODY_1);
+        x += PackedBody::STEP_DX[code];
+        y += PackedBody::STEP_DY[code];
+    }
+    
+    renderer.drawWorldChar(x, y, HEAD_CHARS[code], ColorPair::SNAKE_HEAD);
+}
+
+bool NetClient::isConnected() const {
+    return connected;
+}
+
+bool NetClient::hasServerState() const {
+    return hasState;
+}
+
+uint32_t NetClient::getTick() const {
+    return stateTick;
+}
+
+int NetClient::getPlayerId() const {
+    return playerId;
+}
+
+const WorldGrid& NetClient::getWorld() const {
+    return world;
+}
+
+UdpSocket& NetClient::getSocket() {
+    return socket;
+}
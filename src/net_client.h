@@ -0,0 +1,130 @@
+#ifndef NET_CLIENT_H
+#define NET_CLIENT_H
+
+#include "food.h"
+#include "input_handler.h"
+#include "net_protocol.h"
+#include "net_socket.h"
+#include "packed_body.h"
+#include "renderer.h"
+#include "snake.h"
+#include "world_grid.h"
+#include <chrono>
+#include <vector>
+
+// Client side of a network game (`snake --connect HOST`).
+//
+// Keeps a mirror of the server's board, rebuilt from keyframes and moved
+// forward by replaying each tick's deltas in the same order the server ran
+// them. The local snake is drawn ahead of the mirror by replaying the
+// player's own recent turns, so steering feels immediate even though the
+// server decides what really happened.
+class NetClient {
+public:
+    NetClient();
+    ~NetClient();
+    
+    // Open a local socket and start saying HELLO to `server`
+    void connect(const NetAddress& server);
+    
+    // Play in the terminal until the player quits or the server goes away
+    void run();
+    void cleanup();
+    
+    // Handle every waiting packet
+    void receive();
+    
+    // Advance the local tick clock: resend HELLO while connecting, otherwise
+    // send recent inputs and the latest acknowledged tick
+    void tick();
+    
+    // Steer our snake; the turn is sent right away and predicted locally
+    void sendDirection(Direction direction);
+    
+    bool isConnected() const;
+    bool hasServerState() const;
+    uint32_t getTick() const;
+    int getPlayerId() const;
+    const WorldGrid& getWorld() const;
+    UdpSocket& getSocket();
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct RemoteSnake {
+        bool active;
+        PackedBody body;
+        uint8_t lastStep;  // Direction of the last move, as a step code
+    };
+    
+    struct SentInput {
+        uint32_t seq;
+        uint32_t tick;
+        Direction direction;
+    };
+    
+    struct BlockEvent {
+        int id;
+        uint8_t flags;
+        int x;
+        int y;
+    };
+    
+    UdpSocket socket;
+    NetAddress serverAddress;
+    Renderer renderer;
+    InputHandler input;
+    Food food;
+    bool running;
+    
+    // Mirror of the server's board as of `stateTick`
+    WorldGrid world;
+    std::vector<RemoteSnake> snakes;
+    bool connected;
+    bool hasState;
+    uint32_t stateTick;
+    int playerId;
+    int worldWidth;
+    int worldHeight;
+    
+    // Prediction
+    uint32_t predictTick;  // Tick the server is expected to be at when our input lands
+    int rttMs;
+    uint32_t nextInputSeq;
+    std::vector<SentInput> inputs;
+    Direction lastDirection;
+    
+    Clock::time_point startTime;
+    Clock::time_point lastHeard;
+    
+    // Keyframe reassembly
+    uint32_t keyframeTick;
+    size_t keyframeFragments;
+    size_t keyframeReceived;
+    size_t keyframeSize;
+    std::vector<uint8_t> keyframeData;
+    std::vector<bool> keyframeHave;
+    
+    // Scratch buffers reused for every packet
+    std::vector<uint8_t> packet;
+    std::vector<BlockEvent> blockEvents;
+    std::vector<uint8_t> stepCodes;
+    
+    void handlePacket(const uint8_t* data, size_t size);
+    void handleWelcome(net::PacketReader& reader);
+    void handleDelta(net::PacketReader& reader);
+    void handleKeyframe(net::PacketReader& reader);
+    bool applyBlock(const uint8_t* data, size_t size);
+    bool applyKeyframe(const uint8_t* data, size_t size);
+    void moveSnake(int id, uint8_t flags);
+    void removeSnake(int id);
+    void spawnSnake(int id, int x, int y);
+    void sendHello();
+    void sendInputs();
+    uint32_t getTimeMs() const;
+    
+    void render();
+    void drawPrediction();
+};
+
+#endif // NET_CLIENT_H
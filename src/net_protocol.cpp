@@ -0,0 +1,110 @@
+#include "net_protocol.h"
+
+namespace net {
+    PacketWriter::PacketWriter(std::vector<uint8_t>& buffer)
+        : buffer(buffer) {
+    }
+    
+    void PacketWriter::writeHeader(MessageType type) {
+        writeByte(static_cast<uint8_t>(PROTOCOL_MAGIC & 0xFF));
+        writeByte(static_cast<uint8_t>(PROTOCOL_MAGIC >> 8));
+        writeByte(static_cast<uint8_t>(type));
+    }
+    
+    void PacketWriter::writeByte(uint8_t value) {
+        buffer.push_back(value);
+    }
+    
+    void PacketWriter::writeVarint(uint32_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+    
+    void PacketWriter::writeUint32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+    
+    void PacketWriter::writeBytes(const uint8_t* data, size_t size) {
+        buffer.insert(buffer.end(), data, data + size);
+    }
+    
+    size_t PacketWriter::size() const {
+        return buffer.size();
+    }
+    
+    PacketReader::PacketReader(const uint8_t* data, size_t size)
+        : data(data),
+          size(size),
+          position(0),
+          valid(true) {
+    }
+    
+    uint8_t PacketReader::readHeader() {
+        uint16_t magic = readByte();
+        magic |= static_cast<uint16_t>(readByte() << 8);
+        uint8_t type = readByte();
+        
+        if (!valid || magic != PROTOCOL_MAGIC) {
+            valid = false;
+            return 0;
+        }
+        return type;
+    }
+    
+    uint8_t PacketReader::readByte() {
+        if (position >= size) {
+            valid = false;
+            return 0;
+        }
+        return data[position++];
+    }
+    
+    uint32_t PacketReader::readVarint() {
+        uint32_t value = 0;
+        
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = readByte();
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        
+        // More than five bytes is never a valid 32-bit value
+        valid = false;
+        return 0;
+    }
+    
+    uint32_t PacketReader::readUint32() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(readByte()) << (i * 8);
+        }
+        return value;
+    }
+    
+    const uint8_t* PacketReader::readBytes(size_t count) {
+        if (count > size - position) {
+            valid = false;
+            position = size;
+            return nullptr;
+        }
+        
+        const uint8_t* bytes = data + position;
+        position += count;
+        return bytes;
+    }
+    
+    size_t PacketReader::remaining() const {
+        return size - position;
+    }
+    
+    bool PacketReader::isValid() const {
+        return valid;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wire format shared by NetServer and NetClient.
+//
+// Every datagram starts with a 2-byte magic and a message type. Integers are
+// unsigned LEB128 varints unless noted, so ids and coordinates usually take
+// one or two bytes.
+//
+// The server runs the only real simulation. Each tick it records what
+// changed (a head step and maybe a popped tail per snake, food moves, deaths
+// and spawns) as a small block of bytes. Clients acknowledge the last tick
+// they applied, and each DELTA carries the blocks after that tick, so a lost
+// packet is simply covered by the next one. A client that falls further
+// behind than the history is sent a full KEYFRAME instead.
+namespace net {
+    const uint16_t PROTOCOL_MAGIC = 0x534E;  // "SN"
+    const uint8_t PROTOCOL_VERSION = 1;
+    const int DEFAULT_PORT = 7777;
+    
+    const size_t MAX_PACKET_SIZE = 1200;         // Stays under a typical path MTU
+    const size_t KEYFRAME_FRAGMENT_SIZE = 1024;  // Keyframe payload per packet
+    const int TICK_RATE = 8;                     // Simulation ticks per second
+    const int TICK_MS = 1000 / TICK_RATE;
+    const int HISTORY_TICKS = 256;               // Delta blocks kept by the server
+    const int MAX_PLAYERS = 64;
+    const int MIN_WORLD_WIDTH = 80;              // Servers never run a smaller world
+    const int MIN_WORLD_HEIGHT = 24;
+    const int MAX_WORLD_SIZE = 65536;            // Cells along either side
+    const int MAX_SENT_INPUTS = 8;               // Recent inputs repeated in each packet
+    const int TIMEOUT_MS = 5000;                 // Silence before a peer is dropped
+    
+    enum class MessageType : uint8_t {
+        HELLO = 1,     // client -> server: version
+        WELCOME,       // server -> client: player id, world size
+        INPUT,         // client -> server: acked tick, time, recent inputs
+        DELTA,         // server -> client: base tick, time echo, tick blocks
+        KEYFRAME,      // server -> client: keyframe tick, fragment index/count, bytes
+        BYE            // either way: leaving
+    };
+    
+    // Per-snake flags in a tick block
+    const uint8_t EVENT_STEP_MASK = 0x03;  // PackedBody step code of the move
+    const uint8_t EVENT_MOVED = 0x04;
+    const uint8_t EVENT_POP_TAIL = 0x08;   // The tail left its cell before the head moved
+    const uint8_t EVENT_DIED = 0x10;       // The whole body is removed after all moves
+    const uint8_t EVENT_SPAWNED = 0x20;    // Followed by the head's x and y
+    
+    // Tick block flags
+    const uint8_t BLOCK_FOOD_MOVED = 0x01;  // Followed by the food's x and y
+    
+    // Appends values to a byte buffer. The buffer is reused, so steady-state
+    // encoding does not allocate.
+    class PacketWriter {
+    public:
+        explicit PacketWriter(std::vector<uint8_t>& buffer);
+        
+        void writeHeader(MessageType type);
+        void writeByte(uint8_t value);
+        void writeVarint(uint32_t value);
+        void writeUint32(uint32_t value);  // Fixed 4 bytes, little-endian
+        void writeBytes(const uint8_t* data, size_t size);
+        
+        size_t size() const;
+    
+    private:
+        std::vector<uint8_t>& buffer;
+    };
+    
+    // Reads values back. Running past the end sets a sticky error flag and
+    // returns zeros, so callers check isValid() once at the end.
+    class PacketReader {
+    public:
+        PacketReader(const uint8_t* data, size_t size);
+        
+        // Check the magic and return the message type (0 if invalid)
+        uint8_t readHeader();
+        uint8_t readByte();
+        uint32_t readVarint();
+        uint32_t readUint32();
+        const uint8_t* readBytes(size_t count);
+        
+        size_t remaining() const;
+        bool isValid() const;
+    
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t position;
+        bool valid;
+    };
+}
+
+#endif // NET_PROTOCOL_H
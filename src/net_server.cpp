@@ -0,0 +1,616 @@
+#include "net_server.h"
+#include <algorithm>
+#include <iostream>
+#include <poll.h>
+
+using namespace net;
+
+const uint32_t KEYFRAME_INTERVAL = 32;                // Ticks between fresh keyframes
+const uint32_t KEYFRAME_MAX_AGE = HISTORY_TICKS / 2;  // Restart a keyframe stream after this
+const uint32_t RESPAWN_TICKS = 2 * TICK_RATE;
+const size_t MAX_QUEUED_INPUTS = 32;
+const int SPAWN_ATTEMPTS = 16;
+const int SPAWN_CLEARANCE = 6;  // Free cells needed ahead of a new snake
+const int FOOD_ATTEMPTS = 64;
+
+NetServer::NetServer(int width, int height)
+    : worldWidth(width),
+      worldHeight(height),
+      players(MAX_PLAYERS),
+      currentTick(0),
+      foodX(0),
+      foodY(0),
+      random(static_cast<uint64_t>(Clock::now().time_since_epoch().count())),
+      running(0),
+      history(HISTORY_TICKS),
+      events(MAX_PLAYERS) {
+    
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        Player& player = players[id];
+        player.connected = false;
+        player.leaving = false;
+        player.alive = false;
+        player.respawnTick = 0;
+        player.hasAck = false;
+        player.ackTick = 0;
+        player.timeEcho = 0;
+        player.lastInputSeq = 0;
+        player.keyframeCursor = 0;
+        
+        // Server snakes are never drawn, so keep them as compact as possible
+        player.snake.setCompactBody(true);
+        player.snake.setGrid(&world, id);
+    }
+    
+    placeFood();
+}
+
+void NetServer::open(int port) {
+    socket.open(port);
+}
+
+void NetServer::run() {
+    const auto tickLength = std::chrono::milliseconds(TICK_MS);
+    auto nextTick = Clock::now() + tickLength;
+    running = 1;
+    
+    std::cerr << "Serving a " << worldWidth << "x" << worldHeight
+              << " world on UDP port " << socket.getPort() << std::endl;
+    
+    while (running) {
+        // Sleep until a packet arrives, the next tick is due, or a delayed
+        // packet from the link simulation has to go out
+        auto now = Clock::now();
+        int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - now).count());
+        int delayed = socket.flushDelayed();
+        if (delayed >= 0 && delayed < timeout) {
+            timeout = delayed;
+        }
+        
+        pollfd pfd;
+        pfd.fd = socket.getDescriptor();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ::poll(&pfd, 1, std::max(timeout, 0));
+        
+        receive();
+        
+        now = Clock::now();
+        if (now >= nextTick) {
+            tick();
+            nextTick += tickLength;
+            
+            // After a long stall, carry on from now instead of catching up
+            if (now - nextTick > std::chrono::seconds(1)) {
+                nextTick = now + tickLength;
+            }
+        }
+    }
+    
+    // Let everyone know we are gone
+    packet.clear();
+    PacketWriter writer(packet);
+    writer.writeHeader(MessageType::BYE);
+    for (const auto& player : players) {
+        if (player.connected) {
+            socket.send(player.address, packet.data(), packet.size());
+        }
+    }
+}
+
+void NetServer::stop() {
+    running = 0;
+}
+
+void NetServer::receive() {
+    uint8_t buffer[MAX_PACKET_SIZE];
+    NetAddress from;
+    int size;
+    
+    while ((size = socket.receive(from, buffer, sizeof(buffer))) >= 0) {
+        handlePacket(from, buffer, static_cast<size_t>(size));
+    }
+}
+
+void NetServer::handlePacket(const NetAddress& from, const uint8_t* data, size_t size) {
+    PacketReader reader(data, size);
+    uint8_t type = reader.readHeader();
+    if (!reader.isValid()) {
+        return;
+    }
+    
+    Player* player = findPlayer(from);
+    if (player) {
+        player->lastHeard = Clock::now();
+    }
+    
+    switch (static_cast<MessageType>(type)) {
+        case MessageType::HELLO:
+            if (reader.readByte() == PROTOCOL_VERSION && reader.isValid()) {
+                handleHello(from);
+            }
+            break;
+        
+        case MessageType::INPUT:
+            if (player) {
+                handleInput(*player, reader);
+            }
+            break;
+        
+        case MessageType::BYE:
+            if (player) {
+                player->leaving = true;
+            }
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void NetServer::handleHello(const NetAddress& from) {
+    // A repeated HELLO means our WELCOME was lost
+    Player* existing = findPlayer(from);
+    if (existing) {
+        sendWelcome(*existing, static_cast<int>(existing - &players[0]));
+        return;
+    }
+    
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        Player& player = players[id];
+        if (player.connected) {
+            continue;
+        }
+        
+        player.connected = true;
+        player.leaving = false;
+        player.address = from;
+        player.alive = false;
+        player.respawnTick = currentTick + 1;
+        player.hasAck = false;
+        player.ackTick = 0;
+        player.timeEcho = 0;
+        player.lastInputSeq = 0;
+        player.inputs.clear();
+        player.lastHeard = Clock::now();
+        player.keyframe.reset();
+        player.keyframeCursor = 0;
+        
+        std::cerr << "Player " << id << " joined from " << from.toString() << std::endl;
+        sendWelcome(player, id);
+        return;
+    }
+    
+    // Server full: the client keeps retrying until a slot frees up
+}
+
+void NetServer::handleInput(Player& player, PacketReader& reader) {
+    uint32_t ack = reader.readVarint();
+    uint32_t time = reader.readUint32();
+    int count = std::min(static_cast<int>(reader.readByte()), MAX_SENT_INPUTS);
+    
+    uint32_t seqs[MAX_SENT_INPUTS];
+    PendingInput inputs[MAX_SENT_INPUTS];
+    for (int i = 0; i < count; i++) {
+        seqs[i] = reader.readVarint();
+        inputs[i].tick = reader.readVarint();
+        inputs[i].direction = static_cast<Direction>(reader.readByte());
+    }
+    
+    if (!reader.isValid()) {
+        return;
+    }
+    
+    // Ack 0 means the client has no state and needs a keyframe
+    if (ack == 0) {
+        player.hasAck = false;
+    } else if (ack - 1 <= currentTick && (!player.hasAck || ack - 1 > player.ackTick)) {
+        player.hasAck = true;
+        player.ackTick = ack - 1;
+    }
+    player.timeEcho = time;
+    
+    // Inputs are repeated in several packets; only queue the new ones
+    for (int i = 0; i < count; i++) {
+        if (seqs[i] <= player.lastInputSeq) {
+            continue;
+        }
+        player.lastInputSeq = seqs[i];
+        
+        Direction direction = inputs[i].direction;
+        if (direction < Direction::UP || direction > Direction::RIGHT) {
+            continue;
+        }
+        
+        if (player.inputs.size() >= MAX_QUEUED_INPUTS) {
+            player.inputs.erase(player.inputs.begin());
+        }
+        player.inputs.push_back(inputs[i]);
+    }
+}
+
+NetServer::Player* NetServer::findPlayer(const NetAddress& address) {
+    for (auto& player : players) {
+        if (player.connected && player.address == address) {
+            return &player;
+        }
+    }
+    return nullptr;
+}
+
+void NetServer::tick() {
+    currentTick++;
+    
+    auto now = Clock::now();
+    for (auto& player : players) {
+        if (player.connected && now - player.lastHeard > std::chrono::milliseconds(TIMEOUT_MS)) {
+            player.leaving = true;
+        }
+    }
+    
+    for (auto& event : events) {
+        event.flags = 0;
+    }
+    
+    // Move every snake, in id order. Clients replay the same order, so the
+    // grid ends up identical on both sides.
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        Player& player = players[id];
+        if (!player.connected || player.leaving || !player.alive) {
+            continue;
+        }
+        
+        applyInputs(player);
+        
+        size_t before = player.snake.getLength();
+        player.snake.step();
+        
+        // Step codes follow the order of Direction without NONE
+        uint8_t code = static_cast<uint8_t>(static_cast<int>(player.snake.getDirection()) - 1);
+        events[id].flags = EVENT_MOVED | code;
+        if (player.snake.getLength() == before) {
+            events[id].flags |= EVENT_POP_TAIL;
+        }
+    }
+    
+    // Resolve collisions once everyone has moved. Running into the head of
+    // a snake that moved earlier in this tick takes that snake out too.
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        if (!(events[id].flags & EVENT_MOVED)) {
+            continue;
+        }
+        
+        const Snake& snake = players[id].snake;
+        int headX = snake.getHeadX();
+        int headY = snake.getHeadY();
+        int hitId = snake.getCollisionOwner();
+        
+        if (hitId == WorldGrid::NO_OWNER && !isOutOfBounds(headX, headY)) {
+            continue;
+        }
+        
+        events[id].flags |= EVENT_DIED;
+        if (hitId != WorldGrid::NO_OWNER && hitId != id && players[hitId].alive) {
+            const Snake& hit = players[hitId].snake;
+            if (hit.getHeadX() == headX && hit.getHeadY() == headY) {
+                events[hitId].flags |= EVENT_DIED;
+            }
+        }
+    }
+    
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        Player& player = players[id];
+        if (!player.connected) {
+            continue;
+        }
+        
+        if (player.alive && (player.leaving || (events[id].flags & EVENT_DIED))) {
+            killPlayer(id);
+        }
+        
+        if (player.leaving) {
+            player.connected = false;
+            player.keyframe.reset();
+            std::cerr << "Player " << id << " left" << std::endl;
+        }
+    }
+    
+    // Food
+    bool foodMoved = false;
+    for (auto& player : players) {
+        if (player.alive && player.snake.getHeadX() == foodX && player.snake.getHeadY() == foodY) {
+            player.snake.grow();
+            placeFood();
+            foodMoved = true;
+        }
+    }
+    
+    // Bring back dead and newly joined players
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        Player& player = players[id];
+        if (player.connected && !player.alive && currentTick >= player.respawnTick) {
+            spawnPlayer(id);
+        }
+    }
+    
+    recordTick(foodMoved);
+    
+    for (auto& player : players) {
+        if (player.connected) {
+            sendUpdate(player);
+        }
+    }
+}
+
+void NetServer::applyInputs(Player& player) {
+    // Inputs take effect on the tick the client predicted for them, or now
+    // if they arrived late
+    size_t applied = 0;
+    while (applied < player.inputs.size() && player.inputs[applied].tick <= currentTick) {
+        player.snake.changeDirection(player.inputs[applied].direction);
+        applied++;
+    }
+    
+    player.inputs.erase(player.inputs.begin(), player.inputs.begin() + applied);
+}
+
+void NetServer::killPlayer(int id) {
+    Player& player = players[id];
+    
+    player.snake.removeTail(static_cast<int>(player.snake.getLength()));
+    player.alive = false;
+    player.respawnTick = currentTick + RESPAWN_TICKS;
+    events[id].flags |= EVENT_DIED;
+}
+
+bool NetServer::spawnPlayer(int id) {
+    // Snakes start heading right with their body to the left of (x, y)
+    int spanX = std::max(worldWidth - 6 - SPAWN_CLEARANCE, 1);
+    
+    for (int attempt = 0; attempt < SPAWN_ATTEMPTS; attempt++) {
+        int x = 3 + static_cast<int>(random.nextBelow(static_cast<uint32_t>(spanX)));
+        int y = 1 + static_cast<int>(random.nextBelow(static_cast<uint32_t>(worldHeight - 2)));
+        
+        bool clear = true;
+        for (int dx = -2; dx <= SPAWN_CLEARANCE && clear; dx++) {
+            clear = isCellFree(x + dx, y) && !isOutOfBounds(x + dx, y);
+        }
+        
+        if (clear) {
+            Player& player = players[id];
+            player.snake.initialize(x, y);
+            player.alive = true;
+            player.inputs.clear();
+            
+            events[id].flags = EVENT_SPAWNED;
+            events[id].x = x;
+            events[id].y = y;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void NetServer::placeFood() {
+    for (int attempt = 0; attempt < FOOD_ATTEMPTS; attempt++) {
+        int x = 1 + static_cast<int>(random.nextBelow(static_cast<uint32_t>(worldWidth - 2)));
+        int y = 1 + static_cast<int>(random.nextBelow(static_cast<uint32_t>(worldHeight - 2)));
+        
+        if (isCellFree(x, y)) {
+            foodX = x;
+            foodY = y;
+            return;
+        }
+    }
+}
+
+bool NetServer::isCellFree(int x, int y) const {
+    return world.get(x, y) == CellType::EMPTY;
+}
+
+bool NetServer::isOutOfBounds(int x, int y) const {
+    return x < 1 || x >= worldWidth - 1 || y < 1 || y >= worldHeight - 1;
+}
+
+void NetServer::recordTick(bool foodMoved) {
+    std::vector<uint8_t>& block = history[currentTick % HISTORY_TICKS];
+    block.clear();
+    PacketWriter writer(block);
+    
+    writer.writeByte(foodMoved ? BLOCK_FOOD_MOVED : 0);
+    if (foodMoved) {
+        writer.writeVarint(static_cast<uint32_t>(foodX));
+        writer.writeVarint(static_cast<uint32_t>(foodY));
+    }
+    
+    uint32_t count = 0;
+    for (const auto& event : events) {
+        if (event.flags) {
+            count++;
+        }
+    }
+    writer.writeVarint(count);
+    
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        const SnakeEvent& event = events[id];
+        if (!event.flags) {
+            continue;
+        }
+        
+        writer.writeVarint(static_cast<uint32_t>(id));
+        writer.writeByte(event.flags);
+        if (event.flags & EVENT_SPAWNED) {
+            writer.writeVarint(static_cast<uint32_t>(event.x));
+            writer.writeVarint(static_cast<uint32_t>(event.y));
+        }
+    }
+}
+
+void NetServer::sendUpdate(Player& player) {
+    // Deltas need every tick after the client's ack to still be in history
+    if (player.hasAck && currentTick - player.ackTick < static_cast<uint32_t>(HISTORY_TICKS)) {
+        player.keyframe.reset();
+        sendDelta(player);
+    } else {
+        sendKeyframeFragment(player);
+    }
+}
+
+void NetServer::sendDelta(Player& player) {
+    packet.clear();
+    PacketWriter writer(packet);
+    
+    writer.writeHeader(MessageType::DELTA);
+    writer.writeVarint(player.ackTick);
+    writer.writeUint32(player.timeEcho);
+    
+    size_t countIndex = packet.size();
+    writer.writeByte(0);
+    
+    // As many unacknowledged ticks as fit, oldest first; the rest go out
+    // with the next packet
+    uint8_t count = 0;
+    for (uint32_t t = player.ackTick + 1; t <= currentTick && count < 255; t++) {
+        const std::vector<uint8_t>& block = history[t % HISTORY_TICKS];
+        if (count > 0 && packet.size() + block.size() + 2 > MAX_PACKET_SIZE) {
+            break;
+        }
+        
+        writer.writeVarint(static_cast<uint32_t>(block.size()));
+        writer.writeBytes(block.data(), block.size());
+        count++;
+    }
+    packet[countIndex] = count;
+    
+    socket.send(player.address, packet.data(), packet.size());
+}
+
+void NetServer::sendKeyframeFragment(Player& player) {
+    // Keep streaming the same keyframe until the client has all of it,
+    // unless it has become too old to continue from with deltas
+    if (!player.keyframe || currentTick - player.keyframe->tick > KEYFRAME_MAX_AGE) {
+        player.keyframe = getKeyframe();
+        player.keyframeCursor = 0;
+    }
+    
+    const Keyframe& keyframe = *player.keyframe;
+    size_t fragments = std::max<size_t>((keyframe.data.size() + KEYFRAME_FRAGMENT_SIZE - 1) / KEYFRAME_FRAGMENT_SIZE, 1);
+    size_t index = player.keyframeCursor++ % fragments;
+    size_t offset = index * KEYFRAME_FRAGMENT_SIZE;
+    size_t length = std::min(KEYFRAME_FRAGMENT_SIZE, keyframe.data.size() - offset);
+    
+    // One fragment per tick keeps keyframes from ever bursting past the
+    // bandwidth of a normal delta stream
+    packet.clear();
+    PacketWriter writer(packet);
+    writer.writeHeader(MessageType::KEYFRAME);
+    writer.writeVarint(keyframe.tick);
+    writer.writeVarint(static_cast<uint32_t>(index));
+    writer.writeVarint(static_cast<uint32_t>(fragments));
+    writer.writeBytes(keyframe.data.data() + offset, length);
+    
+    socket.send(player.address, packet.data(), packet.size());
+}
+
+void NetServer::sendWelcome(const Player& player, int id) {
+    packet.clear();
+    PacketWriter writer(packet);
+    
+    writer.writeHeader(MessageType::WELCOME);
+    writer.writeVarint(static_cast<uint32_t>(id));
+    writer.writeVarint(static_cast<uint32_t>(worldWidth));
+    writer.writeVarint(static_cast<uint32_t>(worldHeight));
+    
+    socket.send(player.address, packet.data(), packet.size());
+}
+
+std::shared_ptr<const NetServer::Keyframe> NetServer::getKeyframe() {
+    if (latestKeyframe && currentTick - latestKeyframe->tick < KEYFRAME_INTERVAL) {
+        return latestKeyframe;
+    }
+    
+    std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>();
+    keyframe->tick = currentTick;
+    PacketWriter writer(keyframe->data);
+    
+    writer.writeVarint(static_cast<uint32_t>(foodX));
+    writer.writeVarint(static_cast<uint32_t>(foodY));
+    
+    uint32_t count = 0;
+    for (const auto& player : players) {
+        if (player.alive) {
+            count++;
+        }
+    }
+    writer.writeVarint(count);
+    
+    // Each body is its head plus a 2-bit step per link, packed four to a
+    // byte and listed from the head towards the tail
+    for (int id = 0; id < MAX_PLAYERS; id++) {
+        const Snake& snake = players[id].snake;
+        if (!players[id].alive) {
+            continue;
+        }
+        
+        writer.writeVarint(static_cast<uint32_t>(id));
+        writer.writeVarint(static_cast<uint32_t>(snake.getHeadX()));
+        writer.writeVarint(static_cast<uint32_t>(snake.getHeadY()));
+        writer.writeVarint(static_cast<uint32_t>(snake.getLength() - 1));
+        
+        int prevX = snake.getHeadX();
+        int prevY = snake.getHeadY();
+        bool isHead = true;
+        size_t index = 0;
+        uint8_t packed = 0;
+        
+        snake.forEachSegment([&](int x, int y) {
+            if (isHead) {
+                isHead = false;
+                return;
+            }
+            
+            uint8_t code = x < prevX ? PackedBody::STEP_RIGHT :
+                           x > prevX ? PackedBody::STEP_LEFT :
+                           y < prevY ? PackedBody::STEP_DOWN : PackedBody::STEP_UP;
+            packed |= static_cast<uint8_t>(code << ((index & 3) * 2));
+            if ((index & 3) == 3) {
+                writer.writeByte(packed);
+                packed = 0;
+            }
+            
+            prevX = x;
+            prevY = y;
+            index++;
+        });
+        
+        if (index & 3) {
+            writer.writeByte(packed);
+        }
+    }
+    
+    latestKeyframe = keyframe;
+    return latestKeyframe;
+}
+
+UdpSocket& NetServer::getSocket() {
+    return socket;
+}
+
+const WorldGrid& NetServer::getWorld() const {
+    return world;
+}
+
+uint32_t NetServer::getTick() const {
+    return currentTick;
+}
+
+int NetServer::getPlayerCount() const {
+    int count = 0;
+    for (const auto& player : players) {
+        if (player.connected) {
+            count++;
+        }
+    }
+    return count;
+}
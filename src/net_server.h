@@ -0,0 +1,122 @@
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include "net_protocol.h"
+#include "net_socket.h"
+#include "snake.h"
+#include "world_grid.h"
+#include "utils.h"
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <vector>
+
+// Authoritative simulation for network games (`snake --server`).
+//
+// The server owns the only real board. It steps every snake once per fixed
+// tick, resolves collisions, and sends each client the ticks it has not
+// acknowledged yet. A move costs one flag byte however long the snake is,
+// so bandwidth per client grows with the number of snakes, not their length.
+class NetServer {
+public:
+    NetServer(int worldWidth, int worldHeight);
+    
+    // Start listening; throws std::runtime_error on failure
+    void open(int port);
+    
+    // Serve at the fixed tick rate until stop() is called
+    void run();
+    
+    // Safe to call from a signal handler
+    void stop();
+    
+    // Handle every waiting packet
+    void receive();
+    
+    // Advance the simulation one tick and send every client its update
+    void tick();
+    
+    UdpSocket& getSocket();
+    const WorldGrid& getWorld() const;
+    uint32_t getTick() const;
+    int getPlayerCount() const;
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct PendingInput {
+        uint32_t tick;
+        Direction direction;
+    };
+    
+    // Full board state after one tick. Built at most once per interval and
+    // shared by every client catching up with it.
+    struct Keyframe {
+        uint32_t tick;
+        std::vector<uint8_t> data;
+    };
+    
+    struct Player {
+        bool connected;
+        bool leaving;       // Removed in the death phase of the next tick
+        NetAddress address;
+        Snake snake;
+        bool alive;
+        uint32_t respawnTick;
+        bool hasAck;
+        uint32_t ackTick;   // Last tick the client has applied
+        uint32_t timeEcho;  // Client clock from its last packet, sent back for RTT
+        uint32_t lastInputSeq;
+        std::vector<PendingInput> inputs;
+        Clock::time_point lastHeard;
+        std::shared_ptr<const Keyframe> keyframe;
+        size_t keyframeCursor;
+    };
+    
+    // What happened to one snake during a tick; flags are net::EVENT_*
+    struct SnakeEvent {
+        uint8_t flags;
+        int x;
+        int y;
+    };
+    
+    UdpSocket socket;
+    WorldGrid world;
+    int worldWidth;
+    int worldHeight;
+    std::vector<Player> players;
+    uint32_t currentTick;
+    int foodX;
+    int foodY;
+    utils::Random random;
+    volatile std::sig_atomic_t running;
+    
+    // Encoded tick blocks, indexed by tick % HISTORY_TICKS
+    std::vector<std::vector<uint8_t>> history;
+    std::shared_ptr<const Keyframe> latestKeyframe;
+    
+    // Scratch buffers reused every tick; events are indexed by player id
+    std::vector<SnakeEvent> events;
+    std::vector<uint8_t> packet;
+    
+    void handlePacket(const NetAddress& from, const uint8_t* data, size_t size);
+    void handleHello(const NetAddress& from);
+    void handleInput(Player& player, net::PacketReader& reader);
+    Player* findPlayer(const NetAddress& address);
+    
+    void applyInputs(Player& player);
+    void killPlayer(int id);
+    bool spawnPlayer(int id);
+    void placeFood();
+    bool isCellFree(int x, int y) const;
+    bool isOutOfBounds(int x, int y) const;
+    void recordTick(bool foodMoved);
+    
+    void sendUpdate(Player& player);
+    void sendDelta(Player& player);
+    void sendKeyframeFragment(Player& player);
+    void sendWelcome(const Player& player, int id);
+    std::shared_ptr<const Keyframe> getKeyframe();
+};
+
+#endif // NET_SERVER_H
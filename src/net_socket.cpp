@@ -0,0 +1,227 @@
+#include "net_socket.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    sockaddr_in toSockaddr(const NetAddress& address) {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(address.ip);
+        addr.sin_port = htons(address.port);
+        return addr;
+    }
+    
+    sockaddr_un toUnixAddress(const std::string& path) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("invalid socket path: " + path);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+}
+
+std::string NetAddress::toString() const {
+    return std::to_string(ip >> 24) + "." + std::to_string((ip >> 16) & 0xFF) + "." +
+           std::to_string((ip >> 8) & 0xFF) + "." + std::to_string(ip & 0xFF) + ":" +
+           std::to_string(port);
+}
+
+bool NetAddress::resolve(const std::string& host, int port, NetAddress& out) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+        return false;
+    }
+    
+    const sockaddr_in* addr = reinterpret_cast<const sockaddr_in*>(result->ai_addr);
+    out.ip = ntohl(addr->sin_addr.s_addr);
+    out.port = static_cast<uint16_t>(port);
+    freeaddrinfo(result);
+    return true;
+}
+
+UdpSocket::UdpSocket()
+    : fd(-1),
+      port(0),
+      lossPercent(0),
+      latencyMs(0),
+      random(static_cast<uint64_t>(Clock::now().time_since_epoch().count())),
+      bytesSent(0),
+      packetsSent(0) {
+}
+
+UdpSocket::~UdpSocket() {
+    close();
+}
+
+void UdpSocket::open(int bindPort) {
+    close();
+    
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    
+    NetAddress any;
+    any.port = static_cast<uint16_t>(bindPort);
+    sockaddr_in addr = toSockaddr(any);
+    
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string error = std::strerror(errno);
+        close();
+        throw std::runtime_error("bind to port " + std::to_string(bindPort) + ": " + error);
+    }
+    
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    // Find out which port we got when asking for any free one
+    socklen_t length = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length);
+    port = ntohs(addr.sin_port);
+}
+
+void UdpSocket::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    delayed.clear();
+}
+
+bool UdpSocket::isOpen() const {
+    return fd >= 0;
+}
+
+int UdpSocket::getDescriptor() const {
+    return fd;
+}
+
+int UdpSocket::getPort() const {
+    return port;
+}
+
+void UdpSocket::send(const NetAddress& to, const uint8_t* data, size_t size) {
+    if (lossPercent > 0 && static_cast<int>(random.nextBelow(100)) < lossPercent) {
+        return;
+    }
+    
+    if (latencyMs > 0) {
+        DelayedPacket packet;
+        packet.sendAt = Clock::now() + std::chrono::milliseconds(latencyMs);
+        packet.to = to;
+        packet.data.assign(data, data + size);
+        delayed.push_back(std::move(packet));
+        return;
+    }
+    
+    sendNow(to, data, size);
+}
+
+void UdpSocket::sendNow(const NetAddress& to, const uint8_t* data, size_t size) {
+    sockaddr_in addr = toSockaddr(to);
+    
+    // UDP is best effort anyway; a full socket buffer is just more loss
+    ssize_t sent = sendto(fd, data, size, 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (sent > 0) {
+        bytesSent += static_cast<uint64_t>(sent);
+        packetsSent++;
+    }
+}
+
+int UdpSocket::receive(NetAddress& from, uint8_t* data, size_t capacity) {
+    sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    
+    ssize_t received = recvfrom(fd, data, capacity, 0, reinterpret_cast<sockaddr*>(&addr), &length);
+    if (received < 0) {
+        return -1;
+    }
+    
+    from.ip = ntohl(addr.sin_addr.s_addr);
+    from.port = ntohs(addr.sin_port);
+    return static_cast<int>(received);
+}
+
+void UdpSocket::setLinkSimulation(int loss, int latency) {
+    lossPercent = loss;
+    latencyMs = latency;
+}
+
+int UdpSocket::flushDelayed() {
+    auto now = Clock::now();
+    
+    while (!delayed.empty() && delayed.front().sendAt <= now) {
+        const DelayedPacket& packet = delayed.front();
+        sendNow(packet.to, packet.data.data(), packet.data.size());
+        delayed.pop_front();
+    }
+    
+    if (delayed.empty()) {
+        return -1;
+    }
+    
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(delayed.front().sendAt - now);
+    return static_cast<int>(wait.count()) + 1;
+}
+
+uint64_t UdpSocket::getBytesSent() const {
+    return bytesSent;
+}
+
+uint64_t UdpSocket::getPacketsSent() const {
+    return packetsSent;
+}
+
+int listenUnix(const std::string& path) {
+    sockaddr_un addr = toUnixAddress(path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    
+    // A socket file left behind by an earlier run would make bind() fail
+    unlink(path.c_str());
+    
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("listen on " + path + ": " + error);
+    }
+    
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+int connectUnix(const std::string& path) {
+    sockaddr_un addr = toUnixAddress(path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("connect to " + path + ": " + error);
+    }
+    
+    return fd;
+}
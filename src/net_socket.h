@@ -0,0 +1,91 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include "utils.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// IPv4 address and port, both in host byte order
+struct NetAddress {
+    uint32_t ip;
+    uint16_t port;
+    
+    NetAddress() : ip(0), port(0) {}
+    
+    bool operator==(const NetAddress& other) const {
+        return ip == other.ip && port == other.port;
+    }
+    
+    // "a.b.c.d:port"
+    std::string toString() const;
+    
+    // Resolve "host" or a dotted address; false if it cannot be found
+    static bool resolve(const std::string& host, int port, NetAddress& out);
+};
+
+// Non-blocking UDP socket.
+//
+// For testing on loopback it can also pretend to be a bad network link:
+// outgoing packets are dropped with a given probability and held back for a
+// fixed latency before they are really sent.
+class UdpSocket {
+public:
+    UdpSocket();
+    ~UdpSocket();
+    
+    // Bind to `port` on all interfaces (0 picks a free port). Throws
+    // std::runtime_error if the socket cannot be created or bound.
+    void open(int port);
+    void close();
+    
+    bool isOpen() const;
+    int getDescriptor() const;
+    int getPort() const;
+    
+    void send(const NetAddress& to, const uint8_t* data, size_t size);
+    
+    // Read one waiting datagram into `data`; returns its size, or -1 when
+    // nothing is waiting
+    int receive(NetAddress& from, uint8_t* data, size_t capacity);
+    
+    // Drop `lossPercent` of outgoing packets and delay the rest by `latencyMs`
+    void setLinkSimulation(int lossPercent, int latencyMs);
+    
+    // Send held-back packets that are due. Returns the milliseconds until
+    // the next one is, or -1 if none are waiting.
+    int flushDelayed();
+    
+    uint64_t getBytesSent() const;
+    uint64_t getPacketsSent() const;
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct DelayedPacket {
+        Clock::time_point sendAt;
+        NetAddress to;
+        std::vector<uint8_t> data;
+    };
+    
+    int fd;
+    int port;
+    int lossPercent;
+    int latencyMs;
+    utils::Random random;
+    std::deque<DelayedPacket> delayed;  // Constant latency keeps this in send order
+    uint64_t bytesSent;
+    uint64_t packetsSent;
+    
+    void sendNow(const NetAddress& to, const uint8_t* data, size_t size);
+};
+
+// Local stream sockets, used by the arcade daemon and spectator broadcasts.
+// Both throw std::runtime_error on failure.
+int listenUnix(const std::string& path);   // Non-blocking; replaces a stale socket file
+int connectUnix(const std::string& path);  // Blocking
+
+#endif // NET_SOCKET_H
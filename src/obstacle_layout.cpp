@@ -0,0 +1,50 @@
+#include "obstacle_layout.h"
+
+ObstacleLayout::ObstacleLayout()
+    : phase(Phase::IDLE),
+      nextRow(0) {
+    
+    placed.x = placed.y = placed.width = placed.height = 0;
+    pending = placed;
+}
+
+void ObstacleLayout::reset() {
+    placed.width = placed.height = 0;
+    phase = Phase::IDLE;
+    nextRow = 0;
+}
+
+void ObstacleLayout::prepare(unsigned int seed, const GridRect& region, float density) {
+    pending = region;
+    generator.start(seed, region.width, region.height, density);
+}
+
+void ObstacleLayout::beginChange() {
+    if (phase != Phase::IDLE) {
+        return;
+    }
+    
+    phase = Phase::CLEARING;
+    nextRow = 0;
+}
+
+bool ObstacleLayout::isChanging() const {
+    return phase != Phase::IDLE;
+}
+
+bool ObstacleLayout::isBusy() const {
+    return phase != Phase::IDLE || !generator.isDone();
+}
+
+void ObstacleLayout::clearRows(WorldGrid& world) {
+    GridRect band = placed;
+    band.y = placed.y + nextRow;
+    band.height = std::min(WORLD_ROWS_PER_FRAME, placed.height - nextRow);
+    
+    world.forEachInRect(band, [&world](int x, int y, CellType type, int) {
+        if (type == CellType::OBSTACLE) {
+            world.set(x, y, CellType::EMPTY);
+        }
+    });
+    nextRow += band.height;
+}
@@ -0,0 +1,108 @@
+#ifndef OBSTACLE_LAYOUT_H
+#define OBSTACLE_LAYOUT_H
+
+#include "maze_generator.h"
+#include "world_grid.h"
+#include <algorithm>
+#include <vector>
+
+// The current level's walls in the world, and the next level's on the way.
+//
+// The next layout is generated a slice of maze rows per frame while the
+// current level plays. Changing level is spread over frames too: the old
+// walls come out a band of rows per frame, then the new ones go in a band
+// per frame, so no frame touches more than WORLD_ROWS_PER_FRAME rows of
+// the world however large the layout. Whether a wall may go on a cell is
+// asked as the cell is reached, so it follows the snakes as they move
+// during the change.
+class ObstacleLayout {
+public:
+    static constexpr int MAZE_ROWS_PER_FRAME = 16;   // Rows of maze rooms generated per frame
+    static constexpr int WORLD_ROWS_PER_FRAME = 32;  // Rows of walls cleared or placed per frame
+    
+    ObstacleLayout();
+    
+    // Forget the walls in place and any change under way, for a world that
+    // has just been cleared
+    void reset();
+    
+    // Start generating the next layout over `region` of the world.
+    // `density` is the fraction of surplus maze walls to keep.
+    void prepare(unsigned int seed, const GridRect& region, float density);
+    
+    // Swap the walls in place for the prepared layout over the coming
+    // frames. Does nothing while a change is already under way; that change
+    // ends on a new layout anyway.
+    void beginChange();
+    
+    bool isChanging() const;
+    
+    // True while advance() has work left, so frames should keep coming
+    bool isBusy() const;
+    
+    // Do one frame's share of the work, placing a wall only where
+    // canPlace(x, y) allows it. True on the frame a change completes.
+    template <typename Fn>
+    bool advance(WorldGrid& world, Fn canPlace) {
+        bool generated = generator.advance(MAZE_ROWS_PER_FRAME);
+        
+        switch (phase) {
+            case Phase::CLEARING:
+                if (nextRow < placed.height) {
+                    clearRows(world);
+                    return false;
+                }
+                
+                // The new walls wait for the layout to be finished
+                if (!generated) {
+                    return false;
+                }
+                generator.takeCells(cells);
+                placed = pending;
+                phase = Phase::PLACING;
+                nextRow = 0;
+                return false;
+            
+            case Phase::PLACING: {
+                int endRow = std::min(nextRow + WORLD_ROWS_PER_FRAME, placed.height);
+                for (; nextRow < endRow; nextRow++) {
+                    const unsigned char* row = &cells[static_cast<size_t>(nextRow) * placed.width];
+                    int y = placed.y + nextRow;
+                    
+                    for (int x = 0; x < placed.width; x++) {
+                        if (row[x] && canPlace(placed.x + x, y)) {
+                            world.set(placed.x + x, y, CellType::OBSTACLE);
+                        }
+                    }
+                }
+                
+                if (nextRow < placed.height) {
+                    return false;
+                }
+                phase = Phase::IDLE;
+                return true;
+            }
+            
+            default:
+                return false;
+        }
+    }
+    
+private:
+    enum class Phase {
+        IDLE,
+        CLEARING,  // Taking out the old walls, then waiting for the layout
+        PLACING    // Putting in the new walls
+    };
+    
+    MazeGenerator generator;
+    std::vector<unsigned char> cells;  // The layout being placed
+    GridRect placed;   // Walls in the world lie inside this
+    GridRect pending;  // Where the layout being generated goes
+    Phase phase;
+    int nextRow;       // Next row of `placed` to clear or fill
+    
+    void clearRows(WorldGrid& world);
+};
+
+#endif // OBSTACLE_LAYOUT_H
@@ -0,0 +1,117 @@
+#include "packed_body.h"
+
+// Initial ring size in 64-bit words (32 steps each)
+const size_t INITIAL_WORDS = 4;
+
+const int PackedBody::STEP_DX[4] = {0, 0, -1, 1};
+const int PackedBody::STEP_DY[4] = {-1, 1, 0, 0};
+
+PackedBody::PackedBody()
+    : words(INITIAL_WORDS, 0),
+      start(0),
+      count(0),
+      mask(INITIAL_WORDS * 32 - 1),
+      hasSegments(false),
+      headX(0),
+      headY(0),
+      tailX(0),
+      tailY(0) {
+}
+
+void PackedBody::reset(int x, int y) {
+    start = 0;
+    count = 0;
+    headX = tailX = x;
+    headY = tailY = y;
+    hasSegments = true;
+}
+
+void PackedBody::clear() {
+    start = 0;
+    count = 0;
+    hasSegments = false;
+}
+
+void PackedBody::reserve(size_t segments) {
+    // One step links each segment to the next
+    while (mask + 1 < segments) {
+        grow();
+    }
+}
+
+void PackedBody::pushHead(Step step) {
+    if (count > mask) {
+        grow();
+    }
+    
+    setStep((start + count) & mask, step);
+    count++;
+    
+    headX += STEP_DX[step];
+    headY += STEP_DY[step];
+}
+
+void PackedBody::popTail() {
+    if (count == 0) {
+        return;
+    }
+    
+    // The oldest step leads from the tail to the next segment
+    unsigned int code = getStep(start);
+    tailX += STEP_DX[code];
+    tailY += STEP_DY[code];
+    
+    start = (start + 1) & mask;
+    count--;
+}
+
+size_t PackedBody::size() const {
+    return hasSegments ? count + 1 : 0;
+}
+
+size_t PackedBody::getMemoryUsage() const {
+    return words.capacity() * sizeof(uint64_t);
+}
+
+int PackedBody::getHeadX() const {
+    return headX;
+}
+
+int PackedBody::getHeadY() const {
+    return headY;
+}
+
+int PackedBody::getTailX() const {
+    return tailX;
+}
+
+int PackedBody::getTailY() const {
+    return tailY;
+}
+
+unsigned int PackedBody::getStep(size_t index) const {
+    return static_cast<unsigned int>(words[index >> 5] >> ((index & 31) * 2)) & 3;
+}
+
+void PackedBody::setStep(size_t index, unsigned int code) {
+    uint64_t& word = words[index >> 5];
+    unsigned int shift = static_cast<unsigned int>(index & 31) * 2;
+    
+    word = (word & ~(static_cast<uint64_t>(3) << shift)) | (static_cast<uint64_t>(code) << shift);
+}
+
+void PackedBody::grow() {
+    // Double the ring and unwrap the steps so they start at index 0
+    std::vector<uint64_t> larger(words.size() * 2, 0);
+    size_t newMask = larger.size() * 32 - 1;
+    
+    for (size_t i = 0; i < count; i++) {
+        size_t index = (start + i) & mask;
+        unsigned int code = static_cast<unsigned int>(words[index >> 5] >> ((index & 31) * 2)) & 3;
+        larger[i >> 5] |= static_cast<uint64_t>(code) << ((i & 31) * 2);
+    }
+    
+    words.swap(larger);
+    mask = newMask;
+    start = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef PACKED_BODY_H
+#define PACKED_BODY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact body storage for extremely long snakes.
+//
+// Instead of a coordinate pair per segment, only the head and tail cells are
+// stored, plus a 2-bit step for every link between neighbouring segments.
+// Steps are kept in a ring of 64-bit words (32 steps per word), so pushing a
+// new head and dropping the tail are both O(1), and a million segments take
+// about 256 KB.
+class PackedBody {
+public:
+    // Step codes, matching the order of Direction without NONE
+    enum Step {
+        STEP_UP = 0,
+        STEP_DOWN = 1,
+        STEP_LEFT = 2,
+        STEP_RIGHT = 3
+    };
+    
+    PackedBody();
+    
+    // Start over with a single segment at (x, y)
+    void reset(int x, int y);
+    
+    // Remove every segment
+    void clear();
+    
+    // Make room for `segments` without allocating as the body grows
+    void reserve(size_t segments);
+    
+    // Move the head one cell in `step`, adding a segment at the front
+    void pushHead(Step step);
+    
+    // Drop the last segment
+    void popTail();
+    
+    size_t size() const;
+    size_t getMemoryUsage() const;
+    int getHeadX() const;
+    int getHeadY() const;
+    int getTailX() const;
+    int getTailY() const;
+    
+    // Call fn(x, y) for every segment from head to tail. Steps are decoded a
+    // whole word at a time rather than one lookup per segment.
+    template <typename Fn>
+    void forEachFromHead(Fn fn) const {
+        if (!hasSegments) {
+            return;
+        }
+        
+        int x = headX;
+        int y = headY;
+        fn(x, y);
+        
+        size_t remaining = count;
+        size_t index = (start + count - 1) & mask;
+        
+        while (remaining > 0) {
+            // Walk backwards through the codes held by one word
+            uint64_t word = words[index >> 5];
+            size_t slot = index & 31;
+            size_t run = slot + 1 < remaining ? slot + 1 : remaining;
+            
+            for (size_t i = 0; i < run; i++) {
+                unsigned int code = static_cast<unsigned int>(word >> ((slot - i) * 2)) & 3;
+                x -= STEP_DX[code];
+                y -= STEP_DY[code];
+                fn(x, y);
+            }
+            
+            remaining -= run;
+            index = (index - run) & mask;
+        }
+    }
+    
+    // Cell offsets for each step code
+    static const int STEP_DX[4];
+    static const int STEP_DY[4];
+    
+private:
+    std::vector<uint64_t> words;  // Ring of 2-bit steps, oldest at `start`
+    size_t start;                 // Ring index of the step leaving the tail
+    size_t count;                 // Number of steps (segments - 1)
+    size_t mask;                  // Step capacity - 1 (capacity is a power of two)
+    bool hasSegments;
+    int headX;
+    int headY;
+    int tailX;
+    int tailY;
+    
+    unsigned int getStep(size_t index) const;
+    void setStep(size_t index, unsigned int code);
+    void grow();
+};
+
+#endif // PACKED_BODY_H
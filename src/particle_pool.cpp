@@ -0,0 +1,112 @@
+#include "particle_pool.h"
+
+const int SPARK_STEP_MS = 100;  // How often the sparks in a ring change
+
+namespace {
+    struct RingOffset {
+        int dx;
+        int dy;
+    };
+    
+    // Cells between radius - 1 and radius from the centre, for each radius
+    // up to ParticlePool::MAX_RADIUS
+    const RingOffset RING_0[] = {{0, 0}};
+    const RingOffset RING_1[] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    const RingOffset RING_2[] = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {1, -1}, {-1, 1}, {1, 1},
+        {-2, 0}, {2, 0}, {0, -2}, {0, 2}
+    };
+    
+    struct Ring {
+        const RingOffset* offsets;
+        int count;
+    };
+    
+    const Ring RINGS[] = {
+        {RING_0, sizeof(RING_0) / sizeof(RING_0[0])},
+        {RING_1, sizeof(RING_1) / sizeof(RING_1[0])},
+        {RING_2, sizeof(RING_2) / sizeof(RING_2[0])}
+    };
+    static_assert(sizeof(RINGS) / sizeof(RINGS[0]) == ParticlePool::MAX_RADIUS + 1, "one ring per radius");
+    
+    const char SPARKS[] = {'*', '+', '.', '+', '*', '.', '.', '*', '+'};
+    const int SPARK_COUNT = sizeof(SPARKS);
+}
+
+ParticlePool::ParticlePool()
+    : time(0) {
+    
+    xs.reserve(CAPACITY);
+    ys.reserve(CAPACITY);
+    startTimes.reserve(CAPACITY);
+    durations.reserve(CAPACITY);
+    restChars.reserve(CAPACITY);
+    restColors.reserve(CAPACITY);
+}
+
+void ParticlePool::clear() {
+    time = 0;
+    xs.clear();
+    ys.clear();
+    startTimes.clear();
+    durations.clear();
+    restChars.clear();
+    restColors.clear();
+}
+
+bool ParticlePool::emit(int x, int y, int startMs, int durationMs, char restChar, ColorPair restColor) {
+    if (xs.size() >= CAPACITY) {
+        return false;
+    }
+    
+    xs.push_back(x);
+    ys.push_back(y);
+    startTimes.push_back(startMs);
+    durations.push_back(durationMs > 0 ? durationMs : 1);
+    restChars.push_back(restChar);
+    restColors.push_back(static_cast<uint8_t>(restColor));
+    return true;
+}
+
+void ParticlePool::advance(int elapsedMs) {
+    time += elapsedMs;
+}
+
+void ParticlePool::seek(int timeMs) {
+    time = timeMs;
+}
+
+void ParticlePool::render(Renderer& renderer) const {
+    int spark = time / SPARK_STEP_MS;
+    for (size_t i = 0; i < xs.size(); i++) {
+        int age = time - startTimes[i];
+        if (age <= 0) {
+            renderer.drawWorldChar(xs[i], ys[i], restChars[i], static_cast<ColorPair>(restColors[i]));
+            continue;
+        }
+        
+        // Burnt out
+        int duration = durations[i];
+        if (age >= duration) {
+            continue;
+        }
+        
+        // The ring grows over the burst and dims as it goes
+        const Ring& ring = RINGS[age * (MAX_RADIUS + 1) / duration];
+        ColorPair color = age * 10 < duration * 3 ? ColorPair::EXPLOSION_BRIGHT :
+                          age * 10 < duration * 6 ? ColorPair::EXPLOSION_MEDIUM : ColorPair::EXPLOSION_DARK;
+        for (int k = 0; k < ring.count; k++) {
+            char ch = SPARKS[(i + k + spark) % SPARK_COUNT];
+            renderer.drawWorldChar(xs[i] + ring.offsets[k].dx, ys[i] + ring.offsets[k].dy, ch, color);
+        }
+    }
+}
+
+size_t ParticlePool::size() const {
+    return xs.size();
+}
+
+int ParticlePool::getTime() const {
+    return time;
+}
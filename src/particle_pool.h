@@ -0,0 +1,57 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include "renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Short-lived effects on a shared timeline, such as a snake blowing up.
+//
+// Each particle sits on a world cell showing its resting look until its
+// start time, then bursts into a ring that grows to MAX_RADIUS cells and
+// fades over its duration. The ring cells come from fixed offset tables,
+// and the sparks from a fixed pattern that shifts as time passes, so a
+// frame is a pass over the particles with no square roots or random
+// numbers. The timeline only moves when advance() says how much time the
+// frame took, so nothing ever waits on it.
+//
+// Particles are kept as parallel arrays with room for CAPACITY reserved up
+// front and kept by clear(), so emitting never allocates.
+class ParticlePool {
+public:
+    static const size_t CAPACITY = 16384;
+    static const int MAX_RADIUS = 2;
+    
+    ParticlePool();
+    
+    // Drop every particle and go back to the start of the timeline
+    void clear();
+    
+    // Add a particle at world cell (x, y) that shows `restChar` until
+    // `startMs` into the timeline and then bursts for `durationMs`. False,
+    // and nothing added, once the pool is full.
+    bool emit(int x, int y, int startMs, int durationMs, char restChar, ColorPair restColor);
+    
+    // Move the timeline on by the time a frame took, or jump to a point on it
+    void advance(int elapsedMs);
+    void seek(int timeMs);
+    
+    // Draw every live particle through the renderer's viewport
+    void render(Renderer& renderer) const;
+    
+    size_t size() const;
+    int getTime() const;
+    
+private:
+    int time;  // Milliseconds since clear()
+    
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<int> startTimes;
+    std::vector<int> durations;
+    std::vector<char> restChars;
+    std::vector<uint8_t> restColors;
+};
+
+#endif // PARTICLE_POOL_H
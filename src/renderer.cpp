@@ -1,78 +1,551 @@
 #include "renderer.h"
+#include "spectator_broadcast.h"
+#include "trace_recorder.h"
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <vector>
 #include <iostream>
 #include <string>
-#include <thread>
 #include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+const char SYNC_BEGIN[] = "\033[?2026h";  // Hold the screen until SYNC_END
+const char SYNC_END[] = "\033[?2026l";
+const int MAX_SCREEN_SIZE = 1000;  // Largest width or height taken from a terminal
+const char TRANSPARENT = '\0';     // Overlay cell that shows the screen below
+
+// Bumped by SIGWINCH; each renderer compares it with what it has seen
+std::atomic<unsigned> terminalResizes(0);
 
 Renderer::Renderer() 
     : width(0), 
       height(0), 
-      initialized(false) {
+      viewX(0),
+      viewY(0),
+      initialized(false),
+      outputFd(STDOUT_FILENO),
+      resizesSeen(0),
+      target(&buffer),
+      drawingLayer(Layer::COUNT),
+      frameWaiting(false),
+      renderThreadRunning(false),
+      droppedFrames(0),
+      broadcast(nullptr) {
+    wakePipe[0] = wakePipe[1] = -1;
 }
 
 Renderer::~Renderer() {
     cleanup();
 }
 
+void Renderer::setOutput(int fd) {
+    outputFd = fd;
+}
+
+void Renderer::setBroadcast(SpectatorBroadcast* spectators) {
+    broadcast = spectators;
+}
+
 void Renderer::initialize(int w, int h) {
+    // Fill the terminal if there is one
+    resizesSeen = terminalResizes;
+    int terminalWidth = 0;
+    int terminalHeight = 0;
+    if (getTerminalSize(outputFd, terminalWidth, terminalHeight)) {
+        w = std::min(terminalWidth, MAX_SCREEN_SIZE);
+        h = std::min(terminalHeight, MAX_SCREEN_SIZE);
+    }
+    resize(w, h);
+    
+    // The render thread keeps a frame in `latest` whenever the terminal falls
+    // behind. Make room for it before that thread starts, so the first time
+    // it happens mid-game does not allocate.
+    latest.reserve(width, height);
+    
+    // Set up console: switch to the alternate screen if there is one,
+    // clear it and hide cursor. The first frame is drawn in full.
+    features = detectTerminalFeatures(outputFd);
+    output.open(outputFd);
+    output.writeNow(features.alternateScreen ? "\033[?1049h\033[2J\033[?25l" : "\033[2J\033[?25l");
+    shown.resize(0, 0);
+    frameWaiting = false;
+    
+    initialized = true;
+}
+
+void Renderer::resize(int w, int h) {
     width = w;
     height = h;
+    buffer.resize(width, height);
+    std::fill(buffer.chars.begin(), buffer.chars.end(), ' ');
     
-    // Create and initialize the buffer
-    buffer.resize(height, std::vector<char>(width, ' '));
-    clearBuffer();
+    // Cached layers are drawn again at the new size
+    for (LayerCells& layer : layers) {
+        layer.cells.resize(width, height);
+        layer.cached = false;
+        layer.inFrame = false;
+    }
+}
+
+void Renderer::noteTerminalResized() {
+    terminalResizes++;
+}
+
+bool Renderer::updateSize() {
+    unsigned resizes = terminalResizes;
+    if (resizes == resizesSeen) {
+        return false;
+    }
+    resizesSeen = resizes;
     
-    // Set up console
-    std::cout << "\033[2J"; // Clear screen
-    std::cout << "\033[?25l"; // Hide cursor
+    int w = 0;
+    int h = 0;
+    if (!getTerminalSize(outputFd, w, h)) {
+        return false;
+    }
+    w = std::min(w, MAX_SCREEN_SIZE);
+    h = std::min(h, MAX_SCREEN_SIZE);
+    if (w == width && h == height) {
+        return false;
+    }
     
-    initialized = true;
+    resize(w, h);
+    return true;
+}
+
+void Renderer::Cells::resize(int w, int h) {
+    reserve(w, h);
+    chars.resize(static_cast<size_t>(w) * h);
+    width = w;
+    height = h;
+}
+
+void Renderer::Cells::reserve(int w, int h) {
+    size_t size = static_cast<size_t>(w) * h;
+    if (size > chars.capacity()) {
+        chars.reserve(size + size / 2);
+    }
+}
+
+void Renderer::Cells::copyFrom(const Cells& other) {
+    resize(other.width, other.height);
+    std::copy(other.chars.begin(), other.chars.end(), chars.begin());
 }
 
 void Renderer::cleanup() {
+    // Let the last frame out before the cursor comes back
+    stopRenderThread();
+    
     if (initialized) {
-        // Restore cursor
-        std::cout << "\033[?25h";
+        // Show the newest frame, restore cursor and the user's own screen
+        if (frameWaiting) {
+            formatFrame(latest);
+            output.writeNow(frame);
+            frameWaiting = false;
+        }
+        output.writeNow(features.alternateScreen ? "\033[?25h\033[?1049l" : "\033[?25h");
+        output.restore();
         initialized = false;
     }
 }
 
-void Renderer::clearBuffer() {
-    // Clear the buffer with spaces
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            buffer[y][x] = ' ';
+void Renderer::startRenderThread() {
+    if (renderThreadRunning || pipe(wakePipe) < 0) {
+        return;
+    }
+    
+    for (int fd : wakePipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    
+    // Signals are for the game's own thread: they interrupt its wait, and
+    // cleanup from a handler joins this thread
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGHUP);
+    sigaddset(&blocked, SIGQUIT);
+    sigaddset(&blocked, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    
+    renderThreadRunning = true;
+    renderThread = std::thread(&Renderer::renderLoop, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+void Renderer::stopRenderThread() {
+    if (!renderThreadRunning) {
+        return;
+    }
+    
+    renderThreadRunning = false;
+    char wake = 0;
+    ssize_t ignored = ::write(wakePipe[1], &wake, 1);
+    (void)ignored;
+    renderThread.join();
+    
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+uint64_t Renderer::getDroppedFrames() const {
+    return droppedFrames;
+}
+
+void Renderer::renderLoop() {
+    if (TraceRecorder::isEnabled()) {
+        TraceRecorder::setThreadName("render");
+    }
+    
+    while (true) {
+        // Wait for a new frame, or for the terminal to take more of the
+        // current one
+        pollfd fds[2];
+        fds[0].fd = wakePipe[0];
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = output.hasPendingBytes() ? output.getDescriptor() : -1;
+        fds[1].events = POLLOUT;
+        fds[1].revents = 0;
+        bool waiting = frameWaiting || output.hasPendingBytes();
+        ::poll(fds, 2, waiting ? output.getRetryMs() : -1);
+        
+        // One wakeup covers every frame published so far
+        char drain[64];
+        while (::read(wakePipe[0], drain, sizeof(drain)) > 0) {
+        }
+        
+        pumpOutput();
+        
+        bool stopping = !renderThreadRunning;
+        if (frames.update()) {
+            presentFrame(frames.getReadBuffer());
+        }
+        if (stopping) {
+            return;
         }
     }
 }
 
+Renderer::LayerCells& Renderer::getLayer(Layer layer) {
+    return layers[static_cast<int>(layer)];
+}
+
+void Renderer::emptyLayer(Layer layer) {
+    // The background is opaque, so it can be copied as it is
+    std::vector<char>& chars = getLayer(layer).cells.chars;
+    std::fill(chars.begin(), chars.end(), layer == Layer::BACKGROUND ? ' ' : TRANSPARENT);
+}
+
 void Renderer::clear() {
-    clearBuffer();
+    std::fill(buffer.chars.begin(), buffer.chars.end(), ' ');
+    for (LayerCells& layer : layers) {
+        layer.inFrame = false;
+    }
+    target = &buffer;
+    drawingLayer = Layer::COUNT;
+}
+
+bool Renderer::beginLayer(Layer which, const LayerKey& key) {
+    LayerCells& layer = getLayer(which);
+    layer.inFrame = true;
+    if (layer.cached && layer.key == key) {
+        finishLayer(which);
+        return false;
+    }
+    
+    emptyLayer(which);
+    layer.key = key;
+    layer.cached = true;
+    target = &layer.cells;
+    drawingLayer = which;
+    return true;
+}
+
+bool Renderer::patchLayer(Layer which, const LayerKey& key) {
+    LayerCells& layer = getLayer(which);
+    if (!layer.cached || !(layer.key == key)) {
+        return false;
+    }
+    
+    layer.inFrame = true;
+    target = &layer.cells;
+    drawingLayer = which;
+    return true;
+}
+
+void Renderer::invalidateLayer(Layer which) {
+    getLayer(which).cached = false;
+}
+
+void Renderer::scrollLayer(Layer which, int dx, int dy) {
+    Cells& cells = getLayer(which).cells;
+    char blank = which == Layer::BACKGROUND ? ' ' : TRANSPARENT;
+    int keepWidth = width - std::abs(dx);
+    int keepHeight = height - std::abs(dy);
+    if (keepWidth <= 0 || keepHeight <= 0) {
+        emptyLayer(which);
+        return;
+    }
+    
+    // Move each row that stays in view, reading rows before they are
+    // overwritten, and blank the columns that scrolled in
+    int fromX = std::max(dx, 0);
+    int toX = std::max(-dx, 0);
+    for (int i = 0; i < keepHeight; i++) {
+        int y = dy >= 0 ? i : height - 1 - i;
+        char* row = cells.row(y);
+        std::memmove(row + toX, cells.row(y + dy) + fromX, keepWidth);
+        std::fill(row, row + toX, blank);
+        std::fill(row + toX + keepWidth, row + width, blank);
+    }
+    
+    // Blank the rows that scrolled in
+    int firstBlank = dy >= 0 ? keepHeight : 0;
+    std::fill(cells.row(firstBlank), cells.row(firstBlank) + static_cast<size_t>(std::abs(dy)) * width, blank);
+}
+
+void Renderer::endLayer() {
+    if (drawingLayer != Layer::COUNT) {
+        finishLayer(drawingLayer);
+    }
+    target = &buffer;
+    drawingLayer = Layer::COUNT;
+}
+
+void Renderer::finishLayer(Layer which) {
+    LayerCells& layer = getLayer(which);
+    if (which == Layer::BACKGROUND) {
+        std::memcpy(buffer.chars.data(), layer.cells.chars.data(), buffer.chars.size());
+        return;
+    }
+    
+    // Note the rows the overlay covers once, when it has just been drawn
+    if (target == &layer.cells) {
+        layer.firstRow = height;
+        layer.endRow = 0;
+        for (int y = 0; y < height; y++) {
+            const char* row = layer.cells.row(y);
+            if (std::any_of(row, row + width, [](char ch) { return ch != TRANSPARENT; })) {
+                layer.firstRow = std::min(layer.firstRow, y);
+                layer.endRow = y + 1;
+            }
+        }
+    }
+}
+
+void Renderer::mergeOverlay() {
+    const LayerCells& overlay = getLayer(Layer::OVERLAY);
+    if (!overlay.inFrame || overlay.firstRow >= overlay.endRow) {
+        return;
+    }
+    
+    const char* in = overlay.cells.row(overlay.firstRow);
+    char* out = buffer.row(overlay.firstRow);
+    size_t size = static_cast<size_t>(overlay.endRow - overlay.firstRow) * width;
+    for (size_t i = 0; i < size; i++) {
+        out[i] = in[i] != TRANSPARENT ? in[i] : out[i];
+    }
+}
+
+void Renderer::flushOutput() {
+    if (initialized && !renderThreadRunning) {
+        pumpOutput();
+    }
+}
+
+int Renderer::getOutputWaitMs() const {
+    if (renderThreadRunning || (!frameWaiting && !output.hasPendingBytes())) {
+        return -1;
+    }
+    return output.getRetryMs();
+}
+
+void Renderer::pumpOutput() {
+    if (frameWaiting && output.isReady()) {
+        formatFrame(latest);
+        if (!frame.empty()) {
+            output.submit(frame);
+        }
+        frameWaiting = false;
+    } else {
+        output.flush();
+    }
 }
 
 void Renderer::refresh() {
-    // Move cursor to top-left corner
-    std::cout << "\033[H";
+    mergeOverlay();
+    if (!renderThreadRunning) {
+        presentFrame(buffer);
+        return;
+    }
     
-    // Render the buffer
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            std::cout << buffer[y][x];
+    // Copy the screen into the free slot (big enough already after the
+    // first frame) and wake the render thread
+    frames.getWriteBuffer().copyFrom(buffer);
+    
+    if (!frames.publish()) {
+        droppedFrames++;
+    }
+    
+    char wake = 0;
+    ssize_t ignored = ::write(wakePipe[1], &wake, 1);
+    (void)ignored;
+}
+
+void Renderer::presentFrame(const Cells& cells) {
+    TRACE_SCOPE("Renderer::presentFrame");
+    
+    // A frame the terminal never got to is replaced by this one
+    if (frameWaiting) {
+        droppedFrames++;
+    }
+    
+    if (output.isReady()) {
+        formatFrame(cells);
+        if (!frame.empty()) {
+            output.submit(frame);
+        }
+        frameWaiting = false;
+    } else {
+        // Keep it until the terminal has room
+        latest.copyFrom(cells);
+        frameWaiting = true;
+    }
+    
+    // Viewers get every frame, whatever the terminal's speed
+    if (broadcast) {
+        broadcastFrame(cells);
+    }
+}
+
+void Renderer::formatFrame(const Cells& cells) {
+    // Rows that differ from what the terminal has, each behind a cursor
+    // move, all in one buffer so the frame goes out in as few writes as the
+    // terminal allows. An unchanged screen sends nothing at all; a new size
+    // starts from a cleared screen.
+    frame.clear();
+    bool full = shown.width != cells.width || shown.height != cells.height;
+    if (full) {
+        shown.resize(cells.width, cells.height);
+    }
+    
+    for (int y = 0; y < cells.height; ++y) {
+        const char* row = cells.row(y);
+        char* shownRow = shown.row(y);
+        if (!full && std::equal(row, row + cells.width, shownRow)) {
+            continue;
+        }
+        
+        if (frame.empty()) {
+            if (features.synchronizedOutput) {
+                frame.append(SYNC_BEGIN, sizeof(SYNC_BEGIN) - 1);
+            }
+            if (full) {
+                frame += "\033[2J";
+            }
+        }
+        appendCursorMove(frame, 0, y);
+        frame.append(row, cells.width);
+        std::copy(row, row + cells.width, shownRow);
+    }
+    
+    if (!frame.empty() && features.synchronizedOutput) {
+        frame.append(SYNC_END, sizeof(SYNC_END) - 1);
+    }
+}
+
+namespace {
+    const int MAX_DIFF_GAP = 4;  // Unchanged cells rewritten rather than jumped over
+    
+    // Reuse a frame buffer once every viewer is done with it
+    std::string& takeFrame(std::shared_ptr<std::string>& frame) {
+        if (!frame || frame.use_count() > 1) {
+            frame = std::make_shared<std::string>();
+        }
+        frame->clear();
+        return *frame;
+    }
+}
+
+void Renderer::broadcastFrame(const Cells& cells) {
+    broadcast->acceptViewers();
+    if (broadcast->getViewerCount() == 0) {
+        return;
+    }
+    
+    // After a resize every viewer's screen is redrawn from clear
+    std::string& diff = takeFrame(diffFrame);
+    if (sentBuffer.width != cells.width || sentBuffer.height != cells.height) {
+        sentBuffer.resize(cells.width, cells.height);
+        std::fill(sentBuffer.chars.begin(), sentBuffer.chars.end(), '\0');
+        diff.assign("\033[2J");
+    }
+    
+    // Changed runs of each row, each behind a cursor move. Short unchanged
+    // gaps are rewritten because that is cheaper than another jump.
+    int w = cells.width;
+    for (int y = 0; y < cells.height; ++y) {
+        const char* row = cells.row(y);
+        const char* sent = sentBuffer.row(y);
+        
+        int x = 0;
+        while (x < w) {
+            if (row[x] == sent[x]) {
+                x++;
+                continue;
+            }
+            
+            int end = x + 1;
+            for (int i = end; i < w && i - end < MAX_DIFF_GAP; ++i) {
+                if (row[i] != sent[i]) {
+                    end = i + 1;
+                }
+            }
+            
+            appendCursorMove(diff, x, y);
+            diff.append(row + x, row + end);
+            x = end;
         }
-        std::cout << "\n";
     }
     
-    // Flush output
-    std::cout.flush();
+    // Full redraw, only when a viewer has just joined or fell behind
+    bool needsKeyframe = broadcast->needsKeyframe();
+    if (needsKeyframe) {
+        std::string& key = takeFrame(keyFrame);
+        key.assign("\033[?25l\033[2J");
+        for (int y = 0; y < cells.height; ++y) {
+            appendCursorMove(key, 0, y);
+            key.append(cells.row(y), w);
+        }
+    }
+    
+    broadcast->publish(diff.empty() ? SpectatorBroadcast::FrameData() : diffFrame,
+                       needsKeyframe ? keyFrame : SpectatorBroadcast::FrameData());
+    
+    std::copy(cells.chars.begin(), cells.chars.end(), sentBuffer.chars.begin());
+}
+
+void Renderer::appendCursorMove(std::string& out, int x, int y) {
+    out += "\033[";
+    out += std::to_string(y + 1);
+    out += ';';
+    out += std::to_string(x + 1);
+    out += 'H';
 }
 
 void Renderer::drawChar(int x, int y, char ch, ColorPair colorPair) {
     // Ensure coordinates are within bounds
     if (x >= 0 && x < width && y >= 0 && y < height) {
-        buffer[y][x] = ch;
+        target->row(y)[x] = ch;
     }
     
     // ColorPair is not used in this implementation but kept for interface compatibility
@@ -85,7 +558,7 @@ void Renderer::drawText(int x, int y, const std::string& text, ColorPair colorPa
         for (size_t i = 0; i < text.length(); ++i) {
             // Since i is unsigned, we don't need to check if x + i >= 0
             if (x + static_cast<int>(i) < width && x >= 0) {
-                buffer[y][x + i] = text[i];
+                target->row(y)[x + i] = text[i];
             }
         }
     }
@@ -94,6 +567,20 @@ void Renderer::drawText(int x, int y, const std::string& text, ColorPair colorPa
     (void)colorPair;
 }
 
+void Renderer::drawText(int x, int y, const char* text, ColorPair colorPair) {
+    // Same as above for text formatted into a fixed buffer, which needs no
+    // std::string (and no heap allocation) to draw
+    if (y >= 0 && y < height) {
+        for (size_t i = 0; text[i] != '\0'; ++i) {
+            if (x + static_cast<int>(i) < width && x >= 0) {
+                target->row(y)[x + i] = text[i];
+            }
+        }
+    }
+    
+    (void)colorPair;
+}
+
 void Renderer::drawBorder() {
     // Draw horizontal borders
     for (int x = 0; x < width; ++x) {
@@ -134,6 +621,66 @@ void Renderer::drawRect(int x, int y, int w, int h, ColorPair colorPair) {
     drawChar(x + w - 1, y + h - 1, '+', colorPair);
 }
 
+void Renderer::setViewport(int originX, int originY) {
+    viewX = originX;
+    viewY = originY;
+}
+
+int Renderer::getViewX() const {
+    return viewX;
+}
+
+int Renderer::getViewY() const {
+    return viewY;
+}
+
+int Renderer::getWidth() const {
+    return width;
+}
+
+int Renderer::getHeight() const {
+    return height;
+}
+
+char Renderer::getChar(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return ' ';
+    }
+    return buffer.row(y)[x];
+}
+
+void Renderer::drawWorldChar(int x, int y, char ch, ColorPair colorPair) {
+    drawChar(x - viewX, y - viewY, ch, colorPair);
+}
+
+void Renderer::drawWorldBorder(int worldWidth, int worldHeight) {
+    // Only walk the part of each edge that is on screen
+    int startX = std::max(viewX, 0);
+    int endX = std::min(viewX + width, worldWidth);
+    int startY = std::max(viewY, 0);
+    int endY = std::min(viewY + height, worldHeight);
+    
+    for (int x = startX; x < endX; ++x) {
+        drawWorldChar(x, 0, '-', ColorPair::BORDER);
+        drawWorldChar(x, worldHeight - 1, '-', ColorPair::BORDER);
+    }
+    
+    for (int y = startY; y < endY; ++y) {
+        drawWorldChar(0, y, '|', ColorPair::BORDER);
+        drawWorldChar(worldWidth - 1, y, '|', ColorPair::BORDER);
+    }
+    
+    // Draw corners
+    drawWorldChar(0, 0, '+', ColorPair::BORDER);
+    drawWorldChar(worldWidth - 1, 0, '+', ColorPair::BORDER);
+    drawWorldChar(0, worldHeight - 1, '+', ColorPair::BORDER);
+    drawWorldChar(worldWidth - 1, worldHeight - 1, '+', ColorPair::BORDER);
+}
+
+char* Renderer::getDrawingRow(int y) {
+    return target->row(y);
+}
+
 void Renderer::initializeColors() {
     // No colors needed for the console version
 }
@@ -1,10 +1,18 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include "terminal_output.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
+class SpectatorBroadcast;
+
 enum class ColorPair {
     DEFAULT,
     BORDER,
@@ -25,32 +33,226 @@ enum class ColorPair {
     EXPLOSION_DARK,
     DEATH,
     DEATH_DARK,
+    OBSTACLE,
+    RIVAL_BODY,
     COUNT  // Keep this last for counting
 };
 
+// Cached parts of the screen, kept between frames. Whatever moves is drawn
+// onto the screen itself, above the background and below the overlay.
+enum class Layer {
+    BACKGROUND,  // Scenery that rarely changes, such as the border
+    OVERLAY,     // Score line and menu text
+    COUNT        // Keep this last for counting
+};
+
+// What a cached layer was drawn from; the layer is drawn again when any of
+// these values differ from last time
+struct LayerKey {
+    static const int SIZE = 6;
+    int values[SIZE];
+    
+    LayerKey(int a = 0, int b = 0, int c = 0, int d = 0, int e = 0, int f = 0) {
+        values[0] = a;
+        values[1] = b;
+        values[2] = c;
+        values[3] = d;
+        values[4] = e;
+        values[5] = f;
+    }
+    
+    bool operator==(const LayerKey& other) const {
+        for (int i = 0; i < SIZE; i++) {
+            if (values[i] != other.values[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
 class Renderer {
 public:
     Renderer();
     ~Renderer();
     
+    // Frames go to `fd` (standard output by default), which is made
+    // non-blocking between initialize() and cleanup(). While the terminal is
+    // still busy with earlier frames, only the newest one is kept, so the
+    // screen never falls more than a frame behind the game.
+    //
+    // Where the terminal supports them (see detectTerminalFeatures), the
+    // game runs on the alternate screen and each frame is one synchronized
+    // update. Only rows that changed since the terminal's last frame are
+    // sent.
+    void setOutput(int fd);
+    
+    // Also send every frame to the broadcast's viewers, encoded once as the
+    // cells that changed since the previous frame
+    void setBroadcast(SpectatorBroadcast* broadcast);
+    
+    // The screen takes the terminal's size if the output is a terminal,
+    // `width` x `height` otherwise
     void initialize(int width, int height);
     void cleanup();
     
+    // Change the screen size. The screen is one block of cells with room to
+    // spare, so sizes up to the largest seen so far allocate nothing; the
+    // next frame is drawn in full.
+    void resize(int width, int height);
+    
+    // Called from a SIGWINCH handler: every renderer looks up its terminal's
+    // size again before its next frame
+    static void noteTerminalResized();
+    
+    // Take up a size change noted since the last call; true if the screen
+    // now has a different size. Outputs that are not terminals keep theirs.
+    bool updateSize();
+    
+    // Write frames from a thread of our own. refresh() then only copies the
+    // finished screen into a triple buffer and returns, so a slow terminal
+    // never holds up the caller; frames the terminal cannot keep up with are
+    // skipped and counted. Call after initialize().
+    void startRenderThread();
+    uint64_t getDroppedFrames() const;
+    
+    // clear() starts a frame with a blank screen and no cached layers;
+    // refresh() merges the overlay over the screen and shows the result
     void clear();
     void refresh();
     
+    // Put a cached layer into this frame. True if it has to be drawn again
+    // because `key` or the screen size changed; it is then empty and drawing
+    // goes to it until endLayer(). An unchanged layer is used as it is. The
+    // background is copied under the screen in one go, so begin it straight
+    // after clear(), before drawing anything else.
+    bool beginLayer(Layer layer, const LayerKey& key);
+    void endLayer();
+    
+    // Open a cached layer that is still drawn from `key` without emptying
+    // it, to draw over just the cells that changed; false if it has to be
+    // drawn in full with beginLayer() instead. Ends with endLayer().
+    bool patchLayer(Layer layer, const LayerKey& key);
+    
+    // Make the next beginLayer() draw the layer again whatever its key
+    void invalidateLayer(Layer layer);
+    
+    // Move a cached layer's cells along with a viewport that moved by
+    // (dx, dy). The cells that scroll into view are left empty to be drawn.
+    void scrollLayer(Layer layer, int dx, int dy);
+    
+    // Without the render thread: write more of the current frame, or the
+    // newest held-back one once the terminal has room for it
+    void flushOutput();
+    
+    // Milliseconds until flushOutput() has work to do, or -1 if nothing is
+    // waiting (or the render thread takes care of it)
+    int getOutputWaitMs() const;
+    
     void drawChar(int x, int y, char ch, ColorPair colorPair = ColorPair::DEFAULT);
     void drawText(int x, int y, const std::string& text, ColorPair colorPair = ColorPair::DEFAULT);
+    void drawText(int x, int y, const char* text, ColorPair colorPair = ColorPair::DEFAULT);
     void drawBorder();
     void drawRect(int x, int y, int width, int height, ColorPair colorPair = ColorPair::DEFAULT);
     
+    // World-space drawing: the viewport origin is the world cell shown in the
+    // top-left corner of the screen, and anything outside the screen is culled
+    void setViewport(int originX, int originY);
+    int getViewX() const;
+    int getViewY() const;
+    int getWidth() const;
+    int getHeight() const;
+    
+    // What the last refresh() put on the screen at (x, y); ' ' outside it
+    char getChar(int x, int y) const;
+    void drawWorldChar(int x, int y, char ch, ColorPair colorPair = ColorPair::DEFAULT);
+    void drawWorldBorder(int worldWidth, int worldHeight);
+    
+    // Row `y` of whatever is being drawn to (the screen or an open layer),
+    // getWidth() cells long, for code that fills whole rows at once
+    char* getDrawingRow(int y);
+    
 private:
     int width;
     int height;
+    int viewX;
+    int viewY;
     bool initialized;
-    std::vector<std::vector<char>> buffer;
+    int outputFd;
+    unsigned resizesSeen;  // Resize notes already taken up
+    
+    // A screen's characters, row after row in one block
+    struct Cells {
+        int width;
+        int height;
+        std::vector<char> chars;
+        
+        Cells() : width(0), height(0) {}
+        
+        // Keeps the block; grows it with headroom only when it must
+        void resize(int w, int h);
+        void copyFrom(const Cells& other);
+        
+        // Room for a w x h screen (with the same headroom), left empty
+        void reserve(int w, int h);
+        
+        char* row(int y) {
+            return chars.data() + static_cast<size_t>(y) * width;
+        }
+        const char* row(int y) const {
+            return chars.data() + static_cast<size_t>(y) * width;
+        }
+    };
+    
+    // A cached layer. The overlay holds TRANSPARENT where nothing was
+    // drawn, and only its rows from `firstRow` to `endRow` are merged.
+    struct LayerCells {
+        Cells cells;
+        LayerKey key;
+        bool cached;   // `cells` were drawn from `key` at the current size
+        bool inFrame;  // Part of the frame being drawn
+        int firstRow;
+        int endRow;
+        
+        LayerCells() : cached(false), inFrame(false), firstRow(0), endRow(0) {}
+    };
+    
+    Cells buffer;       // The screen
+    LayerCells layers[static_cast<int>(Layer::COUNT)];
+    Cells* target;      // Where drawing goes: the screen or a layer
+    Layer drawingLayer;
+    std::string frame;  // Reused output buffer, written in one go
+    TerminalOutput output;
+    TerminalFeatures features;
+    Cells shown;        // Screen as the terminal has it (empty: unknown)
+    Cells latest;       // Newest screen, while the terminal has no room for it
+    bool frameWaiting;
+    
+    // Render thread: finished screens are handed over through `frames`, and
+    // a byte on the wake pipe tells the thread to look
+    TripleBuffer<Cells> frames;
+    std::thread renderThread;
+    std::atomic<bool> renderThreadRunning;
+    int wakePipe[2];
+    std::atomic<uint64_t> droppedFrames;
+    
+    // Spectators
+    SpectatorBroadcast* broadcast;
+    Cells sentBuffer;  // Screen as the viewers last saw it
+    std::shared_ptr<std::string> diffFrame;
+    std::shared_ptr<std::string> keyFrame;
     
-    void clearBuffer();
+    LayerCells& getLayer(Layer layer);
+    void emptyLayer(Layer layer);
+    void finishLayer(Layer layer);
+    void mergeOverlay();
+    void presentFrame(const Cells& cells);
+    void formatFrame(const Cells& cells);
+    void pumpOutput();
+    void renderLoop();
+    void stopRenderThread();
+    void broadcastFrame(const Cells& cells);
+    void appendCursorMove(std::string& out, int x, int y);
     void initializeColors();
 };
 
@@ -0,0 +1,119 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+// Double-ended queue in one block that wraps around.
+//
+// std::deque allocates and frees a block every few hundred bytes as
+// elements move through it, even when its length stays the same. Here a
+// queue that gains at one end and loses at the other allocates nothing
+// once its block is big enough; the block only grows (doubling) when the
+// queue gets longer than it has ever been or than reserve() made room for,
+// and clear() keeps it.
+template <typename T>
+class RingBuffer {
+public:
+    RingBuffer()
+        : head(0),
+          count(0) {
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    bool empty() const {
+        return count == 0;
+    }
+    
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+    
+    // Make room for `capacity` elements up front, so the queue can get that
+    // long without allocating
+    void reserve(size_t capacity) {
+        if (capacity > slots.size()) {
+            moveTo(capacity);
+        }
+    }
+    
+    // Element `i` counted from the front
+    T& operator[](size_t i) {
+        return slots[wrap(head + i)];
+    }
+    const T& operator[](size_t i) const {
+        return slots[wrap(head + i)];
+    }
+    
+    T& front() {
+        return slots[head];
+    }
+    const T& front() const {
+        return slots[head];
+    }
+    
+    T& back() {
+        return (*this)[count - 1];
+    }
+    const T& back() const {
+        return (*this)[count - 1];
+    }
+    
+    void pushFront(const T& value) {
+        makeRoom();
+        head = head == 0 ? slots.size() - 1 : head - 1;
+        slots[head] = value;
+        count++;
+    }
+    
+    void pushBack(const T& value) {
+        makeRoom();
+        slots[wrap(head + count)] = value;
+        count++;
+    }
+    
+    void popFront() {
+        head = wrap(head + 1);
+        count--;
+    }
+    
+    void popBack() {
+        count--;
+    }
+    
+private:
+    static const size_t MIN_CAPACITY = 16;
+    
+    std::vector<T> slots;
+    size_t head;   // Slot of the front element
+    size_t count;
+    
+    // Slot for a position up to one lap past the end of the block
+    size_t wrap(size_t i) const {
+        return i >= slots.size() ? i - slots.size() : i;
+    }
+    
+    void makeRoom() {
+        if (count < slots.size()) {
+            return;
+        }
+        
+        moveTo(slots.size() < MIN_CAPACITY ? MIN_CAPACITY : slots.size() * 2);
+    }
+    
+    // Move into a block of `capacity` slots, front first
+    void moveTo(size_t capacity) {
+        std::vector<T> bigger(capacity);
+        for (size_t i = 0; i < count; i++) {
+            bigger[i] = (*this)[i];
+        }
+        slots.swap(bigger);
+        head = 0;
+    }
+};
+
+#endif // RING_BUFFER_H
@@ -6,84 +6,264 @@ Snake::Snake()
       queuedDirection(Direction::NONE),
       growing(false),
       growthAmount(0),
-      moveProgress(0.0f) {
+      moveProgress(0.0f),
+      grid(nullptr),
+      ownerId(0),
+      collisionOwner(WorldGrid::NO_OWNER),
+      swallowedItem(WorldGrid::NO_ITEM),
+      selfCollided(false),
+      compactBody(false) {
 }
 
-void Snake::initialize(int startX, int startY) {
+void Snake::setGrid(WorldGrid* worldGrid, int owner) {
+    grid = worldGrid;
+    ownerId = owner;
+}
+
+void Snake::setCompactBody(bool enabled) {
+    if (enabled == compactBody) {
+        return;
+    }
+    
+    // Drop the body held in the old representation
+    if (grid) {
+        forEachSegment([this](int x, int y) {
+            grid->clearSnake(x, y, ownerId);
+        });
+    }
     body.clear();
+    packedBody.clear();
+    
+    compactBody = enabled;
+}
+
+void Snake::initialize(int startX, int startY, Direction direction) {
+    // Give the old body's cells back to the grid
+    if (grid) {
+        forEachSegment([this](int x, int y) {
+            grid->clearSnake(x, y, ownerId);
+        });
+    }
+    
+    // The body trails behind the head, away from where it is heading
+    PackedBody::Step code;
+    switch (direction) {
+        case Direction::UP:    code = PackedBody::STEP_UP;    break;
+        case Direction::DOWN:  code = PackedBody::STEP_DOWN;  break;
+        case Direction::LEFT:  code = PackedBody::STEP_LEFT;  break;
+        default:               code = PackedBody::STEP_RIGHT; direction = Direction::RIGHT; break;
+    }
+    int dx = PackedBody::STEP_DX[code];
+    int dy = PackedBody::STEP_DY[code];
+    
+    body.clear();
+    packedBody.reset(startX - 2 * dx, startY - 2 * dy);
     
     // Create initial snake with 3 segments
     for (int i = 0; i < 3; i++) {
+        if (compactBody) {
+            // Grow from the tail towards the head
+            if (i > 0) {
+                packedBody.pushHead(code);
+            }
+            if (grid) {
+                grid->setSnake(startX - (2 - i) * dx, startY - (2 - i) * dy, ownerId);
+            }
+            continue;
+        }
+        
         SnakeSegment segment;
-        segment.x = startX - i;
-        segment.y = startY;
-        segment.direction = Direction::RIGHT;
-        body.push_back(segment);
+        segment.x = startX - i * dx;
+        segment.y = startY - i * dy;
+        body.pushBack(segment);
+        
+        if (grid) {
+            grid->setSnake(startX - i * dx, startY - i * dy, ownerId);
+        }
     }
     
-    currentDirection = Direction::RIGHT;
+    currentDirection = direction;
     queuedDirection = Direction::NONE;
     growing = false;
     growthAmount = 0;
     moveProgress = 0.0f;
+    collisionOwner = WorldGrid::NO_OWNER;
+    swallowedItem = WorldGrid::NO_ITEM;
+    selfCollided = false;
+}
+
+void Snake::reserve(size_t segments) {
+    if (compactBody) {
+        packedBody.reserve(segments);
+    } else {
+        body.reserve(segments);
+    }
 }
 
 void Snake::update() {
     // Increment movement progress for smooth animation
     moveProgress += MOVE_SPEED / 60.0f;  // Assuming ~60 frames per second
+    swallowedItem = WorldGrid::NO_ITEM;
     
     // If we've reached the next cell, update the snake position
     if (moveProgress >= 1.0f) {
         moveProgress = 0.0f;
-        
-        // Apply queued direction change if valid
-        if (queuedDirection != Direction::NONE) {
-            if (isValidDirectionChange(currentDirection, queuedDirection)) {
-                currentDirection = queuedDirection;
-            }
-            queuedDirection = Direction::NONE;
+        step();
+    }
+}
+
+void Snake::step() {
+    // Apply queued direction change if valid
+    if (queuedDirection != Direction::NONE) {
+        if (isValidDirectionChange(currentDirection, queuedDirection)) {
+            currentDirection = queuedDirection;
         }
-        
-        // Move snake body
-        SnakeSegment newHead = body.front();
-        
-        // Update head position based on direction
-        switch (currentDirection) {
-            case Direction::UP:
-                newHead.y--;
-                break;
-            case Direction::DOWN:
-                newHead.y++;
-                break;
-            case Direction::LEFT:
-                newHead.x--;
-                break;
-            case Direction::RIGHT:
-                newHead.x++;
-                break;
-            default:
-                break;
+        queuedDirection = Direction::NONE;
+    }
+    swallowedItem = WorldGrid::NO_ITEM;
+    
+    if (compactBody) {
+        moveCompact();
+        return;
+    }
+    
+    // Move snake body
+    SnakeSegment newHead = body.front();
+    
+    // Update head position based on direction
+    switch (currentDirection) {
+        case Direction::UP:
+            newHead.y--;
+            break;
+        case Direction::DOWN:
+            newHead.y++;
+            break;
+        case Direction::LEFT:
+            newHead.x--;
+            break;
+        case Direction::RIGHT:
+            newHead.x++;
+            break;
+        default:
+            break;
+    }
+    
+    // Remove tail if not growing
+    if (growing) {
+        growthAmount--;
+        if (growthAmount <= 0) {
+            growing = false;
+        }
+    } else {
+        if (grid) {
+            grid->clearSnake(static_cast<int>(body.back().x), static_cast<int>(body.back().y), ownerId);
+        }
+        body.popBack();
+    }
+    
+    // The tail has already left its cell, as in the list check
+    if (grid) {
+        occupyHead(static_cast<int>(newHead.x), static_cast<int>(newHead.y));
+    }
+    
+    body.pushFront(newHead);
+}
+
+void Snake::moveCompact() {
+    int dx = 0, dy = 0;
+    PackedBody::Step code;
+    
+    switch (currentDirection) {
+        case Direction::UP:    code = PackedBody::STEP_UP;    break;
+        case Direction::DOWN:  code = PackedBody::STEP_DOWN;  break;
+        case Direction::LEFT:  code = PackedBody::STEP_LEFT;  break;
+        default:               code = PackedBody::STEP_RIGHT; break;
+    }
+    dx = PackedBody::STEP_DX[code];
+    dy = PackedBody::STEP_DY[code];
+    
+    // Remove tail if not growing
+    if (growing) {
+        growthAmount--;
+        if (growthAmount <= 0) {
+            growing = false;
+        }
+    } else {
+        if (grid) {
+            grid->clearSnake(packedBody.getTailX(), packedBody.getTailY(), ownerId);
+        }
+        packedBody.popTail();
+    }
+    
+    // The packed body has no per-segment coordinates to search, so
+    // self-collision always comes from the occupancy grid
+    int headX = packedBody.getHeadX() + dx;
+    int headY = packedBody.getHeadY() + dy;
+    
+    if (grid) {
+        occupyHead(headX, headY);
+    }
+    
+    packedBody.pushHead(code);
+}
+
+void Snake::occupyHead(int headX, int headY) {
+    // One lookup tells us whose body (if anyone's) the head ran into
+    CellType hit = grid->get(headX, headY);
+    collisionOwner = grid->getOwner(headX, headY);
+    selfCollided = collisionOwner == ownerId;
+    
+    // Never take over an occupied cell: the obstacle or the other snake keeps
+    // it, so collision checks by the game still see what was hit. An item is
+    // eaten, so the head takes its cell and remembers which one it was.
+    if (hit == CellType::ITEM) {
+        swallowedItem = grid->getItem(headX, headY);
+    }
+    if (hit == CellType::EMPTY || hit == CellType::ITEM) {
+        grid->setSnake(headX, headY, ownerId);
+    }
+}
+
+bool Snake::removeTail(int maxSegments) {
+    for (int i = 0; i < maxSegments && getLength() > 0; i++) {
+        if (grid) {
+            grid->clearSnake(getTailX(), getTailY(), ownerId);
         }
         
-        newHead.direction = currentDirection;
-        body.push_front(newHead);
-        
-        // Remove tail if not growing
-        if (growing) {
-            growthAmount--;
-            if (growthAmount <= 0) {
-                growing = false;
+        if (compactBody) {
+            if (packedBody.size() > 1) {
+                packedBody.popTail();
+            } else {
+                packedBody.clear();
             }
         } else {
-            body.pop_back();
+            body.popBack();
         }
     }
     
-    // Update segment positions for smooth animation
-    updateSegmentPositions();
+    return getLength() == 0;
 }
 
 void Snake::render(Renderer& renderer) {
+    if (grid) {
+        renderFromGrid(renderer);
+        return;
+    }
+    
+    if (compactBody) {
+        // Walk the packed body, decoding it a word at a time
+        size_t index = 0;
+        size_t length = getLength();
+        forEachSegment([&](int x, int y) {
+            char ch = (index == 0) ? getHeadChar() : (index == length - 1 ? '*' : 'o');
+            ColorPair color = (index == 0) ? ColorPair::SNAKE_HEAD :
+                              (index % 2 == 0 ? ColorPair::SNAKE_BODY_1 : ColorPair::SNAKE_BODY_2);
+            renderer.drawWorldChar(x, y, ch, color);
+            index++;
+        });
+        return;
+    }
+    
     // Draw each snake segment
     for (size_t i = 0; i < body.size(); i++) {
         const auto& segment = body[i];
@@ -122,13 +302,7 @@ void Snake::render(Renderer& renderer) {
         char ch;
         if (i == 0) {
             // Head character based on direction
-            switch (currentDirection) {
-                case Direction::UP:    ch = '^'; break;
-                case Direction::DOWN:  ch = 'v'; break;
-                case Direction::LEFT:  ch = '<'; break;
-                case Direction::RIGHT: ch = '>'; break;
-                default:               ch = 'O'; break;
-            }
+            ch = getHeadChar();
         } else if (i == body.size() - 1) {
             // Tail character
             ch = '*';
@@ -147,61 +321,40 @@ void Snake::render(Renderer& renderer) {
             color = ColorPair::SNAKE_BODY_2;
         }
         
-        renderer.drawChar(static_cast<int>(displayX), static_cast<int>(displayY), ch, color);
+        renderer.drawWorldChar(static_cast<int>(displayX), static_cast<int>(displayY), ch, color);
     }
 }
 
-void Snake::renderDeath(Renderer& renderer, int frame, int maxFrames) {
-    // Death animation - explosion effect
-    const float progress = static_cast<float>(frame) / maxFrames;
+void Snake::renderFromGrid(Renderer& renderer) {
+    // The body cells are drawn from the shared grid by its owner, which
+    // keeps them between frames (see Game::drawWorldLayer), so only the
+    // tail and head markers are left to draw here
     
-    for (size_t i = 0; i < body.size(); i++) {
-        const auto& segment = body[i];
-        
-        // Only process segments that should be visible in this frame
-        float segmentDelay = static_cast<float>(i) / body.size() * 0.5f;
-        float segmentProgress = progress - segmentDelay;
-        
-        if (segmentProgress <= 0) {
-            // Segment hasn't started exploding yet - render normally
+    int tailX = getTailX();
+    int tailY = getTailY();
+    renderer.drawWorldChar(tailX, tailY, '*',
+                           ((tailX + tailY) & 1) ? ColorPair::SNAKE_BODY_2 : ColorPair::SNAKE_BODY_1);
+    renderer.drawWorldChar(getHeadX(), getHeadY(), getHeadChar(), ColorPair::SNAKE_HEAD);
+}
+
+void Snake::emitDeath(ParticlePool& particles, const GridRect& area, int durationMs) const {
+    // Each segment starts to burst a little after the one before it, the
+    // tail halfway through, and bursts for the rest of the time
+    const size_t length = getLength();
+    const int lastStart = durationMs / 2;
+    size_t i = 0;
+    
+    forEachSegment([&](int segmentX, int segmentY) {
+        if (segmentX >= area.x && segmentX < area.x + area.width &&
+            segmentY >= area.y && segmentY < area.y + area.height) {
+            int start = static_cast<int>(static_cast<uint64_t>(i) * lastStart / length);
             char ch = (i == 0) ? 'X' : 'x';
-            ColorPair color = (i == 0) ? ColorPair::SNAKE_HEAD : 
+            ColorPair color = (i == 0) ? ColorPair::SNAKE_HEAD :
                              (i % 2 == 0 ? ColorPair::SNAKE_BODY_1 : ColorPair::SNAKE_BODY_2);
-            
-            renderer.drawChar(static_cast<int>(segment.x), static_cast<int>(segment.y), ch, color);
-        } else if (segmentProgress < 1.0f) {
-            // Segment is exploding
-            const int explosionRadius = static_cast<int>(segmentProgress * 3);
-            
-            // Draw explosion particles
-            for (int dy = -explosionRadius; dy <= explosionRadius; dy++) {
-                for (int dx = -explosionRadius; dx <= explosionRadius; dx++) {
-                    // Create circular explosion shape
-                    float distance = std::sqrt(dx * dx + dy * dy);
-                    if (distance <= explosionRadius && distance >= explosionRadius - 1.0f) {
-                        int x = static_cast<int>(segment.x) + dx;
-                        int y = static_cast<int>(segment.y) + dy;
-                        
-                        // Choose explosion character
-                        char explChar;
-                        if (rand() % 3 == 0) explChar = '*';
-                        else if (rand() % 2 == 0) explChar = '+';
-                        else explChar = '.';
-                        
-                        ColorPair color;
-                        float intensity = 1.0f - segmentProgress;
-                        
-                        if (intensity > 0.7f) color = ColorPair::EXPLOSION_BRIGHT;
-                        else if (intensity > 0.4f) color = ColorPair::EXPLOSION_MEDIUM;
-                        else color = ColorPair::EXPLOSION_DARK;
-                        
-                        renderer.drawChar(x, y, explChar, color);
-                    }
-                }
-            }
+            particles.emit(segmentX, segmentY, start, durationMs - start, ch, color);
         }
-        // If segmentProgress >= 1.0, the segment has fully exploded and disappears
-    }
+        i++;
+    });
 }
 
 void Snake::changeDirection(Direction newDirection) {
@@ -209,29 +362,31 @@ void Snake::changeDirection(Direction newDirection) {
     queuedDirection = newDirection;
 }
 
-bool Snake::checkFoodCollision(const Food& food) {
-    // Check if head overlaps with food
-    int headX = getHeadX();
-    int headY = getHeadY();
-    
-    return (headX == food.getX() && headY == food.getY());
+int Snake::checkFoodCollision() const {
+    return swallowedItem;
 }
 
 bool Snake::checkSelfCollision() {
+    // The grid already answered this when the head moved
+    if (grid) {
+        return selfCollided;
+    }
+    
     // Check if head collides with any other segment
     int headX = getHeadX();
     int headY = getHeadY();
     
     // Start from the 4th segment (index 3) to avoid false collisions
     // with segments that are too close to the head
-    for (size_t i = 3; i < body.size(); i++) {
-        if (static_cast<int>(body[i].x) == headX && 
-            static_cast<int>(body[i].y) == headY) {
-            return true;
+    size_t index = 0;
+    bool collided = false;
+    forEachSegment([&](int x, int y) {
+        if (index++ >= 3 && x == headX && y == headY) {
+            collided = true;
         }
-    }
+    });
     
-    return false;
+    return collided;
 }
 
 void Snake::grow() {
@@ -240,21 +395,61 @@ void Snake::grow() {
 }
 
 bool Snake::containsPosition(int x, int y) const {
-    for (const auto& segment : body) {
-        if (static_cast<int>(segment.x) == x && static_cast<int>(segment.y) == y) {
-            return true;
-        }
+    if (grid) {
+        return grid->getOwner(x, y) == ownerId;
     }
     
-    return false;
+    bool found = false;
+    forEachSegment([&](int segmentX, int segmentY) {
+        if (segmentX == x && segmentY == y) {
+            found = true;
+        }
+    });
+    
+    return found;
 }
 
 int Snake::getHeadX() const {
-    return static_cast<int>(body.front().x);
+    return compactBody ? packedBody.getHeadX() : static_cast<int>(body.front().x);
 }
 
 int Snake::getHeadY() const {
-    return static_cast<int>(body.front().y);
+    return compactBody ? packedBody.getHeadY() : static_cast<int>(body.front().y);
+}
+
+int Snake::getCollisionOwner() const {
+    return collisionOwner;
+}
+
+int Snake::getId() const {
+    return ownerId;
+}
+
+int Snake::getTailX() const {
+    return compactBody ? packedBody.getTailX() : static_cast<int>(body.back().x);
+}
+
+int Snake::getTailY() const {
+    return compactBody ? packedBody.getTailY() : static_cast<int>(body.back().y);
+}
+
+size_t Snake::getLength() const {
+    return compactBody ? packedBody.size() : body.size();
+}
+
+Direction Snake::getDirection() const {
+    return currentDirection;
+}
+
+char Snake::getHeadChar() const {
+    // Head character based on direction
+    switch (currentDirection) {
+        case Direction::UP:    return '^';
+        case Direction::DOWN:  return 'v';
+        case Direction::LEFT:  return '<';
+        case Direction::RIGHT: return '>';
+        default:               return 'O';
+    }
 }
 
 Direction Snake::getOppositeDirection(Direction dir) const {
@@ -271,29 +466,3 @@ bool Snake::isValidDirectionChange(Direction current, Direction newDir) const {
     // Can't reverse direction directly
     return newDir != getOppositeDirection(current);
 }
-
-void Snake::updateSegmentPositions() {
-    // This method provides the smooth animation effect
-    // by interpolating between integer positions
-    for (size_t i = 1; i < body.size(); i++) {
-        SnakeSegment& prev = body[i-1];
-        SnakeSegment& curr = body[i];
-        
-        // Interpolate positions for smooth movement
-        float dx = prev.x - curr.x;
-        float dy = prev.y - curr.y;
-        
-        // If distance is more than 1.5, there's a gap - probably a wrap-around situation
-        if (std::abs(dx) > 1.5f || std::abs(dy) > 1.5f) {
-            // Don't interpolate in this case
-            continue;
-        }
-        
-        // Update segment direction based on relative position to previous segment
-        if (std::abs(dx) > std::abs(dy)) {
-            curr.direction = (dx > 0) ? Direction::RIGHT : Direction::LEFT;
-        } else if (std::abs(dy) > 0) {
-            curr.direction = (dy > 0) ? Direction::DOWN : Direction::UP;
-        }
-    }
-}
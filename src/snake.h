@@ -2,9 +2,11 @@
 #define SNAKE_H
 
 #include <vector>
-#include <deque>
-#include "food.h"
 #include "renderer.h"
+#include "world_grid.h"
+#include "particle_pool.h"
+#include "packed_body.h"
+#include "ring_buffer.h"
 
 enum class Direction {
     NONE,
@@ -17,35 +19,101 @@ enum class Direction {
 struct SnakeSegment {
     float x;
     float y;
-    Direction direction;
 };
 
 class Snake {
 public:
     Snake();
     
-    void initialize(int startX, int startY);
+    // Keep the snake's cells marked in a shared grid under `owner`. Self- and
+    // snake-to-snake collision checks then become O(1) lookups instead of
+    // body scans. With a grid, render() only draws the head and tail; the
+    // body is drawn from the grid by whoever owns it.
+    void setGrid(WorldGrid* worldGrid, int owner = 0);
+    
+    // Store the body as 2-bit steps instead of a coordinate per segment.
+    // Meant for huge boards; needs a grid for collision checks. The current
+    // body is dropped, so call initialize() afterwards.
+    void setCompactBody(bool enabled);
+    
+    // Start over with three segments, the head at (startX, startY) heading
+    // in `direction` and the body trailing behind it
+    void initialize(int startX, int startY, Direction direction = Direction::RIGHT);
     void update();
+    
+    // Room for `segments` before the body has to allocate as it grows. Kept
+    // across initialize(); applies to the storage chosen by setCompactBody().
+    void reserve(size_t segments);
+    
+    // Move one cell now, regardless of the animation timer. The network
+    // server steps every snake once per fixed tick.
+    void step();
+    
     void render(Renderer& renderer);
-    void renderDeath(Renderer& renderer, int frame, int maxFrames);
+    
+    // Blow the snake up: one particle per segment inside `area`, the head
+    // first and the tail last, all burst within `durationMs`. Segments
+    // outside `area` are never seen, so a very long snake costs no more per
+    // frame than the part of it on screen.
+    void emitDeath(ParticlePool& particles, const GridRect& area, int durationMs) const;
+    
     void changeDirection(Direction newDirection);
-    bool checkFoodCollision(const Food& food);
+    
+    // Pool slot of the item the head moved onto on its last move this
+    // update (with a grid attached), or WorldGrid::NO_ITEM. The grid told us
+    // when the head moved, so this costs the same with any number of items.
+    int checkFoodCollision() const;
+    
     bool checkSelfCollision();
     void grow();
     
+    // Drop up to `maxSegments` from the tail; true once nothing is left.
+    // Used to clear away dead snakes a little at a time.
+    bool removeTail(int maxSegments);
+    
     bool containsPosition(int x, int y) const;
     
     // Getters
+    int getId() const;
+    
+    // Owner of the snake cell the head ran into on its last move (with a
+    // grid attached), or WorldGrid::NO_OWNER
+    int getCollisionOwner() const;
+    
     int getHeadX() const;
     int getHeadY() const;
+    int getTailX() const;
+    int getTailY() const;
+    size_t getLength() const;
+    Direction getDirection() const;
+    
+    // Call fn(x, y) for every segment from head to tail
+    template <typename Fn>
+    void forEachSegment(Fn fn) const {
+        if (compactBody) {
+            packedBody.forEachFromHead(fn);
+            return;
+        }
+        
+        for (size_t i = 0; i < body.size(); i++) {
+            fn(static_cast<int>(body[i].x), static_cast<int>(body[i].y));
+        }
+    }
     
 private:
-    std::deque<SnakeSegment> body;
+    RingBuffer<SnakeSegment> body;  // Allocation-free as the snake moves
+    PackedBody packedBody;  // Used instead of `body` in compact mode
     Direction currentDirection;
     Direction queuedDirection;
     bool growing;
     int growthAmount;
     float moveProgress;  // 0.0 to 1.0, for smooth animation
+    WorldGrid* grid;     // Optional occupancy grid, not owned
+    int ownerId;         // Id stored in the grid for this snake's cells
+    int collisionOwner;
+    int swallowedItem;   // Item slot under the head after the last move
+    bool selfCollided;   // Set by update() when a grid is attached
+    bool compactBody;
     
     // Animation settings
     static constexpr float MOVE_SPEED = 8.0f;  // segments per second
@@ -54,7 +122,10 @@ private:
     // Helper methods
     Direction getOppositeDirection(Direction dir) const;
     bool isValidDirectionChange(Direction current, Direction newDir) const;
-    void updateSegmentPositions();
+    void moveCompact();
+    void occupyHead(int headX, int headY);
+    void renderFromGrid(Renderer& renderer);
+    char getHeadChar() const;
 };
 
 #endif // SNAKE_H
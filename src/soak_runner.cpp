@@ -0,0 +1,223 @@
+#include "soak_runner.h"
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <unistd.h>
+
+const int IDLE_FRAME_MS = 10;         // Clock step on screens that only wait for keys
+const double REPORT_INTERVAL_S = 10.0;  // Seconds between progress lines
+const int MAX_REPORTED_VIOLATIONS = 20;  // Printed in full; the rest are only counted
+
+// Chances out of 10000 per frame of play
+const uint32_t PAUSE_CHANCE = 20;
+const uint32_t PROFILER_CHANCE = 20;
+const uint32_t QUIT_CHANCE = 1;
+const uint32_t RANDOM_TURN_CHANCE = 1500;  // Otherwise the snake heads for the nearest item
+
+const int MENU_KEYS[] = {'w', 's', 'a', 'd', '\n'};
+const int GAME_OVER_KEYS[] = {'w', 's', 'x', 'x', '\n'};  // Enter also skips the death animation
+const int PAUSED_KEYS[] = {'p', 'q', 'w', 'x'};
+const int DIRECTION_KEYS[] = {'w', 'a', 's', 'd'};
+
+namespace {
+    template <size_t N>
+    int pickKey(utils::Random& random, const int (&keys)[N]) {
+        return keys[random.nextBelow(N)];
+    }
+    
+    double peakRssMegabytes() {
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0.0;
+        }
+        return usage.ru_maxrss / 1024.0;  // Kilobytes on Linux
+    }
+}
+
+SoakRunner::SoakRunner(const GameOptions& gameOptions, int games)
+    : options(gameOptions),
+      games(games),
+      devNull(-1),
+      running(0),
+      gamesPlayed(0),
+      restarts(0),
+      frames(0),
+      ticks(0),
+      violations(0) {
+    
+    options.headless = true;
+    if (options.seed == 0) {
+        options.seed = static_cast<unsigned int>(std::time(nullptr));
+    }
+    random.reseed(options.seed);
+    
+    devNull = ::open("/dev/null", O_WRONLY);
+    if (devNull < 0) {
+        throw std::runtime_error("Cannot open /dev/null");
+    }
+}
+
+SoakRunner::~SoakRunner() {
+    if (devNull >= 0) {
+        ::close(devNull);
+    }
+}
+
+bool SoakRunner::run() {
+    running = 1;
+    std::printf("Soak test: %d games, seed %u\n", games, options.seed);
+    std::fflush(stdout);
+    
+    typedef std::chrono::steady_clock WallClock;
+    WallClock::time_point start = WallClock::now();
+    WallClock::time_point lastReport = start;
+    
+    std::unique_ptr<Game> game(new Game(options, devNull));
+    uint64_t ticksBefore = 0;  // Ticks of the games already finished with
+    GameState previous = game->getState();
+    int roundScore = 0;
+    
+    while (running && gamesPlayed < games) {
+        game->runFrame();
+        frames++;
+        ticks = ticksBefore + game->getTickCount();
+        
+        // Quitting from a menu ends the whole game; start a fresh one
+        if (!game->isRunning()) {
+            ticksBefore = ticks;
+            restarts++;
+            game.reset(new Game(options, devNull));
+            previous = game->getState();
+            roundScore = 0;
+            continue;
+        }
+        
+        // A round starts from the main menu or the game over screen, and
+        // ends on the game over screen
+        GameState state = game->getState();
+        if (state == GameState::PLAYING && (previous == GameState::MENU || previous == GameState::GAME_OVER)) {
+            roundScore = 0;
+        }
+        if (state == GameState::GAME_OVER && previous != GameState::GAME_OVER) {
+            gamesPlayed++;
+        }
+        
+        const char* violation = game->checkInvariants();
+        if (!violation && game->getScore() < roundScore) {
+            violation = "score went down";
+        }
+        if (violation) {
+            if (violations < MAX_REPORTED_VIOLATIONS) {
+                std::printf("Invariant broken in game %d at tick %llu (frame %llu): %s\n", gamesPlayed + 1,
+                            static_cast<unsigned long long>(game->getTickCount()),
+                            static_cast<unsigned long long>(frames), violation);
+                std::fflush(stdout);
+            }
+            violations++;
+        }
+        roundScore = game->getScore();
+        previous = state;
+        
+        // Jump straight to the next time the screen would change by itself
+        pressKeys(*game);
+        int delay = game->getFrameDelayMs();
+        game->advanceClock(delay >= 0 ? delay : IDLE_FRAME_MS);
+        
+        WallClock::time_point now = WallClock::now();
+        if (std::chrono::duration<double>(now - lastReport).count() >= REPORT_INTERVAL_S) {
+            report("progress", std::chrono::duration<double>(now - start).count());
+            lastReport = now;
+        }
+    }
+    
+    report("done", std::chrono::duration<double>(WallClock::now() - start).count());
+    return violations == 0;
+}
+
+void SoakRunner::stop() {
+    running = 0;
+}
+
+void SoakRunner::pressKeys(Game& game) {
+    switch (game.getState()) {
+        case GameState::INTRO:
+            // Any key leaves the intro once it has finished
+            game.pressKey(pickKey(random, MENU_KEYS));
+            break;
+        
+        case GameState::MENU:
+            game.pressKey(pickKey(random, MENU_KEYS));
+            break;
+        
+        case GameState::PLAYING: {
+            uint32_t roll = random.nextBelow(10000);
+            if (roll < PAUSE_CHANCE) {
+                game.pressKey('p');
+            } else if (roll < PAUSE_CHANCE + PROFILER_CHANCE) {
+                game.pressKey('f');
+            } else if (roll < PAUSE_CHANCE + PROFILER_CHANCE + QUIT_CHANCE) {
+                game.pressKey('q');
+            } else {
+                game.pressKey(chooseDirectionKey(game));
+            }
+            break;
+        }
+        
+        case GameState::PAUSED:
+            game.pressKey(pickKey(random, PAUSED_KEYS));
+            break;
+        
+        case GameState::GAME_OVER:
+            game.pressKey(pickKey(random, GAME_OVER_KEYS));
+            break;
+        
+        case GameState::QUIT:
+            break;
+    }
+}
+
+int SoakRunner::chooseDirectionKey(const Game& game) {
+    if (random.nextBelow(10000) < RANDOM_TURN_CHANCE) {
+        return pickKey(random, DIRECTION_KEYS);
+    }
+    
+    // The nearest item, power-ups included
+    const ItemPool& items = game.getItems();
+    const Snake& player = game.getPlayer();
+    int dx = 0, dy = 0;
+    int best = INT_MAX;
+    for (size_t i = 0; i < items.size(); i++) {
+        int slot = static_cast<int>(i);
+        int itemDx = items.getX(slot) - player.getHeadX();
+        int itemDy = items.getY(slot) - player.getHeadY();
+        if (std::abs(itemDx) + std::abs(itemDy) < best) {
+            best = std::abs(itemDx) + std::abs(itemDy);
+            dx = itemDx;
+            dy = itemDy;
+        }
+    }
+    
+    // Along whichever axis still has a distance to go, picked at random
+    // when both do; turning back on itself is ignored by the snake
+    bool horizontal = dy == 0 || (dx != 0 && random.nextBelow(2) == 0);
+    if (horizontal) {
+        return dx > 0 ? 'd' : 'a';
+    }
+    return dy > 0 ? 's' : 'w';
+}
+
+void SoakRunner::report(const char* label, double seconds) const {
+    double rate = seconds > 0.0 ? ticks / seconds : 0.0;
+    std::printf("Soak %s: %d/%d games, %d restarts, %llu frames, %llu ticks in %.1f s (%.0f ticks/s), "
+                "peak RSS %.1f MB, %llu invariant violations\n",
+                label, gamesPlayed, games, restarts, static_cast<unsigned long long>(frames),
+                static_cast<unsigned long long>(ticks), seconds, rate, peakRssMegabytes(),
+                static_cast<unsigned long long>(violations));
+    std::fflush(stdout);
+}
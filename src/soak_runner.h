@@ -0,0 +1,54 @@
+#ifndef SOAK_RUNNER_H
+#define SOAK_RUNNER_H
+
+#include "game.h"
+#include "utils.h"
+#include <csignal>
+#include <cstdint>
+
+// Plays many games back to back as fast as they will go (`snake --soak N`).
+//
+// Each Game is headless: its frames are formatted as usual but written to
+// /dev/null, its keys are chosen at random from the seed (steering towards
+// the food more often than not, with the odd pause, quit and profiler
+// toggle), and its clock jumps straight to the next time the screen would
+// change. Every screen of the real state machine is visited, from the intro
+// to the game over menu. After every frame the board is checked
+// (Game::checkInvariants(), and a score that never goes down within a
+// round); progress, ticks per second and peak RSS are printed every few
+// seconds, so the run can be left going for hours to catch slow leaks and
+// games that get slower the longer they last.
+class SoakRunner {
+public:
+    // A seed of 0 in `options` is replaced with one from the time, which is
+    // printed so a failing run can be repeated
+    SoakRunner(const GameOptions& options, int games);
+    ~SoakRunner();
+    
+    // Play until `games` rounds have ended or stop() is called; false if
+    // any invariant was broken
+    bool run();
+    
+    // Safe to call from a signal handler
+    void stop();
+    
+private:
+    GameOptions options;
+    int games;
+    int devNull;
+    utils::Random random;
+    volatile std::sig_atomic_t running;
+    
+    // Totals over every Game so far
+    int gamesPlayed;  // Rounds that reached the game over screen
+    int restarts;     // Games quit from a menu and started again
+    uint64_t frames;
+    uint64_t ticks;
+    uint64_t violations;
+    
+    void pressKeys(Game& game);
+    int chooseDirectionKey(const Game& game);
+    void report(const char* label, double seconds) const;
+};
+
+#endif // SOAK_RUNNER_H
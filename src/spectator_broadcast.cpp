@@ -0,0 +1,177 @@
+#include "spectator_broadcast.h"
+#include "net_socket.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+const size_t MAX_VIEWER_BACKLOG = 64 * 1024;  // Queued bytes before a viewer is skipped ahead
+const int MAX_IOVECS = 64;                    // Frames handed to one sendmsg() call
+
+SpectatorBroadcast::SpectatorBroadcast()
+    : listener(-1),
+      viewerCount(0),
+      bytesSent(0),
+      keyframesSent(0) {
+}
+
+SpectatorBroadcast::~SpectatorBroadcast() {
+    close();
+}
+
+void SpectatorBroadcast::open(const std::string& path) {
+    close();
+    listener = listenUnix(path);
+    socketPath = path;
+}
+
+void SpectatorBroadcast::close() {
+    for (auto& viewer : viewers) {
+        ::close(viewer.fd);
+    }
+    viewers.clear();
+    viewerCount = 0;
+    
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+        listener = -1;
+    }
+}
+
+bool SpectatorBroadcast::isOpen() const {
+    return listener >= 0;
+}
+
+void SpectatorBroadcast::acceptViewers() {
+    if (listener < 0) {
+        return;
+    }
+    
+    int fd;
+    while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        
+        Viewer viewer;
+        viewer.fd = fd;
+        viewer.offset = 0;
+        viewer.queuedBytes = 0;
+        viewer.needsKeyframe = true;
+        viewer.failed = false;
+        viewers.push_back(std::move(viewer));
+    }
+    
+    viewerCount = static_cast<int>(viewers.size());
+}
+
+bool SpectatorBroadcast::needsKeyframe() const {
+    for (const auto& viewer : viewers) {
+        if (viewer.needsKeyframe) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SpectatorBroadcast::publish(const FrameData& diff, const FrameData& keyframe) {
+    for (auto& viewer : viewers) {
+        // Only whole frames are dropped, so a viewer that was skipped ahead
+        // picks up at a clean point in the stream
+        const FrameData& frame = viewer.needsKeyframe ? keyframe : diff;
+        if (frame && !frame->empty()) {
+            viewer.queue.push_back(frame);
+            viewer.queuedBytes += frame->size();
+            if (viewer.needsKeyframe) {
+                viewer.needsKeyframe = false;
+                keyframesSent++;
+            }
+        }
+        
+        flush(viewer);
+        
+        if (viewer.queuedBytes > MAX_VIEWER_BACKLOG) {
+            dropBacklog(viewer);
+        }
+    }
+    
+    // Forget viewers that went away
+    for (const auto& viewer : viewers) {
+        if (viewer.failed) {
+            ::close(viewer.fd);
+        }
+    }
+    viewers.erase(std::remove_if(viewers.begin(), viewers.end(), [](const Viewer& viewer) {
+        return viewer.failed;
+    }), viewers.end());
+    viewerCount = static_cast<int>(viewers.size());
+}
+
+int SpectatorBroadcast::getViewerCount() const {
+    return viewerCount;
+}
+
+size_t SpectatorBroadcast::getBytesSent() const {
+    return bytesSent;
+}
+
+int SpectatorBroadcast::getKeyframesSent() const {
+    return keyframesSent;
+}
+
+void SpectatorBroadcast::flush(Viewer& viewer) {
+    while (!viewer.queue.empty()) {
+        // Point straight into the shared frames; nothing is copied
+        iovec parts[MAX_IOVECS];
+        int count = 0;
+        for (auto it = viewer.queue.begin(); it != viewer.queue.end() && count < MAX_IOVECS; ++it, ++count) {
+            size_t skip = count == 0 ? viewer.offset : 0;
+            parts[count].iov_base = const_cast<char*>((*it)->data() + skip);
+            parts[count].iov_len = (*it)->size() - skip;
+        }
+        
+        msghdr message = msghdr();
+        message.msg_iov = parts;
+        message.msg_iovlen = count;
+        
+        // MSG_NOSIGNAL: a viewer closing its end must not kill the game
+        ssize_t result = sendmsg(viewer.fd, &message, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                viewer.failed = true;
+            }
+            return;
+        }
+        
+        size_t written = static_cast<size_t>(result);
+        bytesSent += written;
+        viewer.queuedBytes -= written;
+        
+        // Release every frame that went out completely
+        written += viewer.offset;
+        while (!viewer.queue.empty() && written >= viewer.queue.front()->size()) {
+            written -= viewer.queue.front()->size();
+            viewer.queue.pop_front();
+        }
+        viewer.offset = written;
+        
+        if (viewer.offset > 0) {
+            // The socket is full; try again next frame
+            return;
+        }
+    }
+}
+
+void SpectatorBroadcast::dropBacklog(Viewer& viewer) {
+    // A half-written frame has to be finished or the terminal would be left
+    // in the middle of an escape sequence
+    size_t keep = viewer.offset > 0 ? 1 : 0;
+    
+    while (viewer.queue.size() > keep) {
+        viewer.queuedBytes -= viewer.queue.back()->size();
+        viewer.queue.pop_back();
+    }
+    
+    viewer.needsKeyframe = true;
+}
@@ -0,0 +1,74 @@
+#ifndef SPECTATOR_BROADCAST_H
+#define SPECTATOR_BROADCAST_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Sends a game's screen to any number of watchers (`snake --broadcast PATH`,
+// watched with `snake --watch PATH`).
+//
+// The Renderer encodes each frame's changes once into a shared buffer and
+// hands it to publish(). Every viewer just queues another reference to that
+// buffer, and its queue is written straight from the shared buffers with a
+// single gathering sendmsg(), so adding a viewer adds a system call, not
+// another encoding or copy.
+//
+// Viewers never slow the game down. One that cannot keep up has its backlog
+// dropped and waits for the next keyframe (a full redraw), which the
+// Renderer only encodes on frames where some viewer is waiting for one.
+class SpectatorBroadcast {
+public:
+    typedef std::shared_ptr<const std::string> FrameData;
+    
+    SpectatorBroadcast();
+    ~SpectatorBroadcast();
+    
+    // Start listening on a Unix socket at `path`, replacing any stale socket
+    // file there; throws std::runtime_error on failure
+    void open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    
+    // Take every waiting connection; new viewers start with a keyframe
+    void acceptViewers();
+    
+    // True if some viewer needs a keyframe with the next frame
+    bool needsKeyframe() const;
+    
+    // Queue the frame for every viewer and write as much as each socket
+    // takes. `keyframe` goes to viewers waiting for one and `diff` to the
+    // rest; either may be null.
+    void publish(const FrameData& diff, const FrameData& keyframe);
+    
+    // Safe to read from any thread, e.g. for a HUD while a render thread
+    // does the broadcasting
+    int getViewerCount() const;
+    
+    size_t getBytesSent() const;
+    int getKeyframesSent() const;
+    
+private:
+    struct Viewer {
+        int fd;
+        std::deque<FrameData> queue;
+        size_t offset;         // Bytes of queue.front() already written
+        size_t queuedBytes;
+        bool needsKeyframe;
+        bool failed;
+    };
+    
+    int listener;
+    std::string socketPath;
+    std::vector<Viewer> viewers;
+    std::atomic<int> viewerCount;
+    size_t bytesSent;
+    int keyframesSent;
+    
+    void flush(Viewer& viewer);
+    void dropBacklog(Viewer& viewer);
+};
+
+#endif // SPECTATOR_BROADCAST_H
@@ -0,0 +1,271 @@
+#include "terminal_output.h"
+#include "trace_recorder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const int DEFAULT_RETRY_MS = 5;           // Before the drain rate is known
+const int MAX_RETRY_MS = 100;
+const double MIN_SAMPLE_SECONDS = 0.005;
+const double RATE_WINDOW_SECONDS = 0.5;   // Shortest span measured as one sample
+const double RATE_SMOOTHING = 0.25;       // Weight of each new throughput sample
+const double RATE_PROBE = 0.01;           // Estimated rate growth per second held back
+const double RATE_MARGIN = 0.85;          // Share of the estimate counted on, so
+                                          // errors drain the queue, not fill it
+const size_t MAX_QUEUE_ESTIMATE = 65536;  // Typical pipe and pty buffer
+const int WRITE_NOW_TIMEOUT_MS = 1000;    // Give up on a terminal that takes nothing
+
+TerminalFeatures detectTerminalFeatures(int fd) {
+    TerminalFeatures features;
+    
+    bool vtLike = false;
+    struct stat info;
+    if (isatty(fd)) {
+        const char* term = std::getenv("TERM");
+        vtLike = term && *term && std::strcmp(term, "dumb") != 0;
+    } else if (fstat(fd, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        vtLike = true;
+    }
+    
+    features.alternateScreen = vtLike;
+    features.synchronizedOutput = vtLike;
+    return features;
+}
+
+bool getTerminalSize(int fd, int& width, int& height) {
+    struct winsize size;
+    if (ioctl(fd, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0) {
+        return false;
+    }
+    width = size.ws_col;
+    height = size.ws_row;
+    return true;
+}
+
+TerminalOutput::TerminalOutput()
+    : fd(-1),
+      savedFlags(-1),
+      offset(0),
+      frameSize(0),
+      kernelQueued(0),
+      queueVisible(false),
+      queueCapacity(0),
+      heldBack(false),
+      sampleTime(Clock::now()),
+      bytesPerSecond(0.0),
+      blocked(false),
+      windowOpen(false),
+      windowStart(sampleTime),
+      windowBytes(0) {
+}
+
+void TerminalOutput::open(int descriptor) {
+    restore();
+    fd = descriptor;
+    pending.clear();
+    offset = 0;
+    kernelQueued = 0;
+    blocked = false;
+    windowOpen = false;
+    
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) {
+        savedFlags = flags;
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+void TerminalOutput::restore() {
+    if (fd >= 0 && savedFlags >= 0) {
+        fcntl(fd, F_SETFL, savedFlags);
+    }
+    savedFlags = -1;
+}
+
+int TerminalOutput::getDescriptor() const {
+    return fd;
+}
+
+bool TerminalOutput::isReady() {
+    flush();
+    sampleQueue();
+    if (offset < pending.size()) {
+        return false;
+    }
+    
+    // Without a reported queue or a measured rate yet, write until the
+    // kernel refuses, which is what measures the rate
+    if (!queueVisible && bytesPerSecond <= 0.0) {
+        return true;
+    }
+    
+    // Let a new frame in once less than a whole one is still on its way
+    if (kernelQueued < std::max(frameSize, static_cast<size_t>(1))) {
+        return true;
+    }
+    heldBack = true;
+    return false;
+}
+
+void TerminalOutput::submit(std::string& frame) {
+    // Swap rather than copy; the caller gets the old buffer back to reuse
+    pending.swap(frame);
+    offset = 0;
+    frameSize = pending.size();
+    flush();
+}
+
+void TerminalOutput::flush() {
+    while (offset < pending.size()) {
+        TRACE_SCOPE("write");
+        ssize_t result = ::write(fd, pending.data() + offset, pending.size() - offset);
+        if (result > 0) {
+            offset += static_cast<size_t>(result);
+            kernelQueued += static_cast<size_t>(result);
+            windowBytes += static_cast<size_t>(result);
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            blocked = true;
+            measureWindow();
+            return;
+        } else {
+            // The other end is gone; nothing more will get through
+            offset = pending.size();
+            break;
+        }
+    }
+    blocked = false;
+}
+
+void TerminalOutput::writeNow(const std::string& data) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(WRITE_NOW_TIMEOUT_MS);
+    
+    // Finish the frame in progress first so escape sequences are not split
+    std::string tail = data;
+    if (offset < pending.size()) {
+        tail = pending.substr(offset) + data;
+    }
+    pending.swap(tail);
+    offset = 0;
+    
+    while (true) {
+        flush();
+        if (offset >= pending.size() || Clock::now() >= deadline) {
+            break;
+        }
+        
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        ::poll(&pfd, 1, MAX_RETRY_MS);
+    }
+    
+    pending.clear();
+    offset = 0;
+}
+
+bool TerminalOutput::hasPendingBytes() const {
+    return offset < pending.size();
+}
+
+int TerminalOutput::getRetryMs() const {
+    if (bytesPerSecond <= 0.0) {
+        return DEFAULT_RETRY_MS;
+    }
+    
+    // Time for our own bytes and the kernel's excess over one frame to drain
+    double excess = static_cast<double>(pending.size() - offset);
+    if (kernelQueued >= frameSize) {
+        excess += static_cast<double>(kernelQueued - frameSize) + 1.0;
+    }
+    
+    int ms = static_cast<int>(excess * 1000.0 / (bytesPerSecond * RATE_MARGIN)) + 1;
+    return std::max(1, std::min(ms, MAX_RETRY_MS));
+}
+
+double TerminalOutput::getBytesPerSecond() const {
+    return bytesPerSecond;
+}
+
+size_t TerminalOutput::queryKernelQueue() const {
+#ifdef TIOCOUTQ
+    // Bytes written but not yet taken by the other side (sockets; ptys
+    // always say 0)
+    int queued = 0;
+    if (ioctl(fd, TIOCOUTQ, &queued) == 0 && queued > 0) {
+        return static_cast<size_t>(queued);
+    }
+#endif
+    return 0;
+}
+
+void TerminalOutput::sampleQueue() {
+    auto now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - sampleTime).count();
+    if (seconds < MIN_SAMPLE_SECONDS) {
+        return;
+    }
+    sampleTime = now;
+    
+    size_t reported = queryKernelQueue();
+    if (reported > 0) {
+        queueVisible = true;
+    }
+    
+    if (queueVisible) {
+        // What left a queue that never ran dry shows what the link takes
+        if (kernelQueued > reported && reported > 0) {
+            addRateSample(static_cast<double>(kernelQueued - reported) / seconds);
+        }
+        kernelQueued = reported;
+        return;
+    }
+    
+    // Frames were held back on the estimate alone and the kernel has not
+    // refused anything, so the link may take more than the estimate says
+    if (heldBack && !blocked) {
+        bytesPerSecond *= 1.0 + RATE_PROBE * seconds;
+    }
+    heldBack = false;
+    
+    // Drain the estimate at the measured rate; a refused write means the
+    // queue is as full as it gets
+    double drained = bytesPerSecond * RATE_MARGIN * seconds;
+    kernelQueued = drained < kernelQueued ? kernelQueued - static_cast<size_t>(drained) : 0;
+    kernelQueued = std::min(kernelQueued, MAX_QUEUE_ESTIMATE);
+    if (blocked) {
+        queueCapacity = std::max(queueCapacity, kernelQueued);
+        kernelQueued = queueCapacity;
+    }
+}
+
+void TerminalOutput::measureWindow() {
+    if (queueVisible) {
+        return;
+    }
+    
+    auto now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - windowStart).count();
+    if (windowOpen && seconds < RATE_WINDOW_SECONDS) {
+        return;
+    }
+    if (windowOpen) {
+        addRateSample(static_cast<double>(windowBytes) / seconds);
+    }
+    
+    windowOpen = true;
+    windowStart = now;
+    windowBytes = 0;
+}
+
+void TerminalOutput::addRateSample(double rate) {
+    bytesPerSecond = bytesPerSecond > 0.0 ? bytesPerSecond + RATE_SMOOTHING * (rate - bytesPerSecond) : rate;
+}
@@ -0,0 +1,103 @@
+#ifndef TERMINAL_OUTPUT_H
+#define TERMINAL_OUTPUT_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Escape sequences worth sending beyond plain cursor movement
+struct TerminalFeatures {
+    bool alternateScreen;     // ?1049: play on a screen of our own and give
+                              // the user's back on exit
+    bool synchronizedOutput;  // ?2026: show each frame at once, not as it
+                              // trickles in
+    
+    TerminalFeatures() : alternateScreen(false), synchronizedOutput(false) {}
+};
+
+// What the terminal behind `fd` supports, judged from TERM for a tty. A
+// socket is taken to lead to an `--attach` client's terminal; pipes and
+// files get neither feature. Terminals ignore private modes they do not
+// know, so this only needs to rule out the ones that are not VT-like.
+TerminalFeatures detectTerminalFeatures(int fd);
+
+// Size of the terminal behind `fd` in characters; false if it is not one
+bool getTerminalSize(int fd, int& width, int& height);
+
+// Non-blocking frame writer that keeps the screen close to real time.
+//
+// Over a slow link, blocking writes let whole seconds of frames pile up in
+// kernel buffers while the player's keys take effect immediately. This
+// writer only accepts a new frame once the previous one has left our own
+// queue and less than one frame is still waiting in the kernel. Callers
+// keep just their newest frame while it is busy, so whatever reaches the
+// screen is never much more than a frame behind.
+//
+// Sockets report their kernel queue (TIOCOUTQ). Ptys and pipes do not, so
+// there the queue is estimated from what was written and the drain rate,
+// which is measured between writes the kernel refuses and probed upwards
+// slowly while frames wait on the estimate alone. The drain rate also tells
+// the caller how long to wait before trying again; the frame rate therefore
+// follows the link's throughput.
+class TerminalOutput {
+public:
+    TerminalOutput();
+    
+    // Write to `fd` from now on; it is made non-blocking until restore()
+    void open(int fd);
+    void restore();
+    int getDescriptor() const;
+    
+    // True if a new frame can go out now without piling up behind others
+    bool isReady();
+    
+    // Start writing a frame (only when isReady()); takes its contents
+    void submit(std::string& frame);
+    
+    // Write more of the current frame
+    void flush();
+    
+    // Write `data` right away, waiting for earlier output first. Only for
+    // the few bytes that set up or restore the terminal.
+    void writeNow(const std::string& data);
+    
+    // True while part of the current frame is still in our own queue
+    bool hasPendingBytes() const;
+    
+    // Milliseconds until isReady() is worth asking again
+    int getRetryMs() const;
+    
+    // Measured bytes per second reaching the terminal (0 until known)
+    double getBytesPerSecond() const;
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    int fd;
+    int savedFlags;     // -1 if the descriptor's flags were not changed
+    std::string pending;
+    size_t offset;      // Bytes of `pending` already written
+    size_t frameSize;   // Size of the last frame, the allowed kernel backlog
+    
+    // Kernel queue and throughput
+    size_t kernelQueued;   // Reported, or estimated if not queueVisible
+    bool queueVisible;     // The descriptor has reported a queue
+    size_t queueCapacity;  // Estimated queue size when writes are refused
+    bool heldBack;         // isReady() said no since the last sample
+    Clock::time_point sampleTime;
+    double bytesPerSecond;
+    
+    // The queue was full at both of two refused writes, so whatever it
+    // accepted in between, with or without pauses, is what drained from it
+    bool blocked;          // The last write was refused
+    bool windowOpen;       // Measuring since `windowStart`
+    Clock::time_point windowStart;
+    size_t windowBytes;
+    
+    size_t queryKernelQueue() const;
+    void sampleQueue();
+    void measureWindow();
+    void addRateSample(double rate);
+};
+
+#endif // TERMINAL_OUTPUT_H
@@ -0,0 +1,158 @@
+#include "trace_recorder.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    
+    struct TraceEvent {
+        const char* name;
+        uint64_t ticks;  // From readTicks()
+        char phase;      // 'B' or 'E', as in the trace format
+    };
+    
+    // One thread's events. Only its own thread writes; `written` is
+    // published with release so writeJson() sees complete events.
+    struct ThreadTrace {
+        std::vector<TraceEvent> events;
+        std::atomic<uint64_t> written;
+        const char* threadName;
+        int threadId;
+        
+        ThreadTrace(int id)
+            : events(TraceRecorder::EVENTS_PER_THREAD),
+              written(0),
+              threadName(nullptr),
+              threadId(id) {
+        }
+    };
+    
+    // Every thread that has recorded, kept to the end of the process so a
+    // thread's events outlive it
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadTrace>> threads;
+    
+    // Clock readings when tracing started, to turn ticks into time
+    std::atomic<uint64_t> originTicks(0);
+    std::atomic<uint64_t> originNs(0);
+    
+    thread_local ThreadTrace* threadTrace = nullptr;
+    
+    uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count());
+    }
+    
+    // The CPU's time stamp counter where there is one: reading the steady
+    // clock costs more than the rest of an event put together, and the
+    // counter runs at a constant rate on anything recent. Ticks are scaled
+    // to nanoseconds against the steady clock when the trace is written.
+    uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return nowNs();
+#endif
+    }
+    
+    // This thread's ring, registered the first time it is needed
+    ThreadTrace& getThreadTrace() {
+        if (!threadTrace) {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            threads.emplace_back(new ThreadTrace(static_cast<int>(threads.size()) + 1));
+            threadTrace = threads.back().get();
+        }
+        return *threadTrace;
+    }
+    
+    void record(const char* name, char phase) {
+        ThreadTrace& trace = getThreadTrace();
+        uint64_t index = trace.written.load(std::memory_order_relaxed);
+        TraceEvent& event = trace.events[index & (TraceRecorder::EVENTS_PER_THREAD - 1)];
+        event.name = name;
+        event.ticks = readTicks();
+        event.phase = phase;
+        trace.written.store(index + 1, std::memory_order_release);
+    }
+}
+
+std::atomic<bool> TraceRecorder::enabled(false);
+
+void TraceRecorder::start() {
+    originTicks = readTicks();
+    originNs = nowNs();
+    enabled = true;
+}
+
+void TraceRecorder::stop() {
+    enabled = false;
+}
+
+void TraceRecorder::begin(const char* name) {
+    record(name, 'B');
+}
+
+void TraceRecorder::end(const char* name) {
+    record(name, 'E');
+}
+
+void TraceRecorder::setThreadName(const char* name) {
+    getThreadTrace().threadName = name;
+}
+
+bool TraceRecorder::writeJson(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    int pid = static_cast<int>(getpid());
+    uint64_t origin = originTicks;
+    uint64_t elapsedTicks = readTicks() - origin;
+    uint64_t elapsedNs = nowNs() - originNs;
+    double usPerTick = elapsedTicks > 0 ? elapsedNs / 1000.0 / elapsedTicks : 0.0;
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    bool first = true;
+    for (const auto& trace : threads) {
+        if (trace->threadName) {
+            file << (first ? "\n" : ",\n")
+                 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << trace->threadId
+                 << ",\"args\":{\"name\":\"" << trace->threadName << "\"}}";
+            first = false;
+        }
+        
+        // Only the newest events are left in a ring that has wrapped; ends
+        // whose begins were overwritten would close the wrong scopes
+        uint64_t written = trace->written.load(std::memory_order_acquire);
+        uint64_t oldest = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+        int depth = 0;
+        for (uint64_t i = oldest; i < written; i++) {
+            const TraceEvent& event = trace->events[i & (EVENTS_PER_THREAD - 1)];
+            if (event.phase == 'E' && depth == 0) {
+                continue;
+            }
+            depth += event.phase == 'B' ? 1 : -1;
+            
+            // Timestamps are in microseconds
+            double ts = event.ticks >= origin ? (event.ticks - origin) * usPerTick : 0.0;
+            file << (first ? "\n" : ",\n")
+                 << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"ts\":" << ts
+                 << ",\"pid\":" << pid << ",\"tid\":" << trace->threadId << "}";
+            first = false;
+        }
+    }
+    
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,74 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Built out along with the frame timers by `make PROFILING=0`
+#ifndef SNAKE_PROFILING
+#define SNAKE_PROFILING 1
+#endif
+
+// Begin/end events for a Chrome or Perfetto timeline (chrome://tracing,
+// ui.perfetto.dev), kept cheap enough to leave on while playing.
+//
+// Each thread records into its own ring of events, allocated the first
+// time it records anything, so recording takes no lock: a time stamp
+// counter read and three stores. When a ring is full the oldest events are overwritten.
+// Nothing is formatted until writeJson().
+class TraceRecorder {
+public:
+    static const size_t EVENTS_PER_THREAD = 1 << 16;  // Must be a power of two
+    
+    static void start();
+    static void stop();
+    
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    
+    // `name` must be a string literal (or live as long): only the pointer
+    // is kept. Names are written to JSON as they are, so no quotes.
+    static void begin(const char* name);
+    static void end(const char* name);
+    
+    // Label the calling thread's track in the timeline
+    static void setThreadName(const char* name);
+    
+    // Every thread's events as Chrome trace JSON; false if the file could
+    // not be written. Call once the other threads have stopped recording.
+    static bool writeJson(const std::string& path);
+    
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records a begin event now and the matching end event when it goes out of
+// scope, if tracing was on when it started
+class TraceScope {
+public:
+    explicit TraceScope(const char* scopeName)
+        : name(TraceRecorder::isEnabled() ? scopeName : nullptr) {
+        if (name) {
+            TraceRecorder::begin(name);
+        }
+    }
+    
+    ~TraceScope() {
+        if (name) {
+            TraceRecorder::end(name);
+        }
+    }
+    
+private:
+    const char* name;
+};
+
+#if SNAKE_PROFILING
+#define TRACE_SCOPE(name) TraceScope traceScope(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_RECORDER_H
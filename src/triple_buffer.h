@@ -0,0 +1,64 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one producer thread to one consumer thread without
+// locks or waiting on either side.
+//
+// There are three slots: the producer fills its own, the consumer reads its
+// own, and the third holds the latest published value. publish() and
+// update() swap a private slot with that shared one in a single atomic
+// exchange, so the consumer always gets the newest value and a value that
+// is replaced before anyone reads it is simply dropped.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : shared(1),
+          writeIndex(0),
+          readIndex(2) {
+    }
+    
+    // Producer: the slot to fill next. It keeps its old contents, so large
+    // values can be overwritten in place without reallocating.
+    T& getWriteBuffer() {
+        return slots[writeIndex];
+    }
+    
+    // Producer: make the write slot the latest value. Returns false if the
+    // value it replaces was never read (a dropped frame).
+    bool publish() {
+        uint8_t previous = shared.exchange(static_cast<uint8_t>(writeIndex | FRESH), std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+        return !(previous & FRESH);
+    }
+    
+    // Consumer: take the latest value if there is a new one
+    bool update() {
+        if (!(shared.load(std::memory_order_acquire) & FRESH)) {
+            return false;
+        }
+        
+        uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+    
+    // Consumer: the value taken by the last successful update()
+    const T& getReadBuffer() const {
+        return slots[readIndex];
+    }
+    
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t FRESH = 0x04;  // Published and not read yet
+    
+    T slots[3];
+    std::atomic<uint8_t> shared;  // Index of the shared slot, plus FRESH
+    uint8_t writeIndex;
+    uint8_t readIndex;
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -2,10 +2,48 @@
 #define UTILS_H
 
 #include <cstdlib>
+#include <cstdint>
 #include <ctime>
 #include <string>
 
 namespace utils {
+    // Small seeded generator (xorshift64*) for reproducible content such as
+    // procedural levels. Unlike std::rand it has no global state.
+    class Random {
+    public:
+        explicit Random(uint64_t seed = 1) {
+            reseed(seed);
+        }
+        
+        void reseed(uint64_t seed) {
+            // SplitMix64 scramble so that nearby seeds give unrelated streams
+            seed += 0x9E3779B97F4A7C15ULL;
+            seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+            state = (seed ^ (seed >> 31)) | 1;
+        }
+        
+        uint32_t next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return static_cast<uint32_t>((state * 0x2545F4914F6CDD1DULL) >> 32);
+        }
+        
+        // Uniform value in [0, bound) without a division
+        uint32_t nextBelow(uint32_t bound) {
+            return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >> 32);
+        }
+        
+        // Uniform value in [0.0, 1.0)
+        float nextFloat() {
+            return (next() >> 8) * (1.0f / 16777216.0f);
+        }
+        
+    private:
+        uint64_t state;
+    };
+    
     // Random number generator between min and max (inclusive)
     inline int randomInt(int min, int max) {
         return min + (std::rand() % (max - min + 1));
@@ -0,0 +1,349 @@
+#include "virtual_terminal.h"
+#include <algorithm>
+#include <cstring>
+
+const char ESC = '\033';
+const int TAB_WIDTH = 8;
+const int MAX_PARAM_VALUE = 100000;  // Larger numbers are clamped, not overflowed
+
+VirtualTerminal::VirtualTerminal(int w, int h)
+    : width(0),
+      height(0),
+      alternate(false),
+      cursorX(0),
+      cursorY(0),
+      wrapPending(false),
+      savedX(0),
+      savedY(0),
+      cursorVisible(true),
+      synchronized(false),
+      state(ParseState::GROUND),
+      paramCount(0),
+      privateMode(false),
+      unknownForm(false) {
+    resize(w, h);
+}
+
+void VirtualTerminal::resize(int w, int h) {
+    w = std::max(w, 1);
+    h = std::max(h, 1);
+    for (std::vector<char>* screen : {&mainCells, &alternateCells}) {
+        std::vector<char> resized(static_cast<size_t>(w) * h, ' ');
+        for (int y = 0; y < std::min(h, height); y++) {
+            std::copy(screen->begin() + static_cast<size_t>(y) * width,
+                      screen->begin() + static_cast<size_t>(y) * width + std::min(w, width),
+                      resized.begin() + static_cast<size_t>(y) * w);
+        }
+        screen->swap(resized);
+    }
+    
+    width = w;
+    height = h;
+    cursorX = std::min(cursorX, width - 1);
+    cursorY = std::min(cursorY, height - 1);
+    wrapPending = false;
+}
+
+void VirtualTerminal::feed(const std::string& data) {
+    feed(data.data(), data.size());
+}
+
+void VirtualTerminal::feed(const char* data, size_t size) {
+    stats.bytes += size;
+    
+    for (size_t i = 0; i < size; i++) {
+        char ch = data[i];
+        switch (state) {
+            case ParseState::GROUND:
+                if (ch == ESC) {
+                    state = ParseState::ESCAPE;
+                } else if (ch == '\r') {
+                    cursorX = 0;
+                    wrapPending = false;
+                } else if (ch == '\n' || ch == '\v' || ch == '\f') {
+                    lineFeed();
+                } else if (ch == '\b') {
+                    moveTo(cursorX - 1, cursorY);
+                } else if (ch == '\t') {
+                    moveTo((cursorX / TAB_WIDTH + 1) * TAB_WIDTH, cursorY);
+                } else if (static_cast<unsigned char>(ch) >= ' ' && ch != '\177') {
+                    print(ch);
+                }
+                // Any other control character (such as a bell) changes nothing
+                break;
+            
+            case ParseState::ESCAPE:
+                state = ParseState::GROUND;
+                if (ch == '[') {
+                    state = ParseState::CSI;
+                    paramCount = 0;
+                    params[0] = 0;
+                    privateMode = false;
+                    unknownForm = false;
+                    break;
+                }
+                
+                stats.escapeSequences++;
+                if (ch == '7') {
+                    savedX = cursorX;
+                    savedY = cursorY;
+                } else if (ch == '8') {
+                    moveTo(savedX, savedY);
+                    stats.cursorMoves++;
+                } else {
+                    stats.unsupported++;
+                }
+                break;
+            
+            case ParseState::CSI:
+                if (ch >= '0' && ch <= '9') {
+                    if (paramCount == 0) {
+                        paramCount = 1;
+                    }
+                    int& value = params[paramCount - 1];
+                    value = std::min(value * 10 + (ch - '0'), MAX_PARAM_VALUE);
+                } else if (ch == ';') {
+                    // An empty first parameter still counts as one
+                    if (paramCount == 0) {
+                        paramCount = 1;
+                    }
+                    if (paramCount < MAX_PARAMS) {
+                        params[paramCount++] = 0;
+                    } else {
+                        unknownForm = true;
+                    }
+                } else if (ch == '?' && paramCount == 0) {
+                    privateMode = true;
+                } else if (ch >= '@' && ch <= '~') {
+                    state = ParseState::GROUND;
+                    stats.escapeSequences++;
+                    if (unknownForm) {
+                        stats.unsupported++;
+                    } else {
+                        executeCsi(ch);
+                    }
+                } else if (ch == ESC) {
+                    // A sequence cut short by the next one
+                    stats.escapeSequences++;
+                    stats.unsupported++;
+                    state = ParseState::ESCAPE;
+                } else {
+                    // Intermediate bytes and other markers
+                    unknownForm = true;
+                }
+                break;
+        }
+    }
+}
+
+int VirtualTerminal::getWidth() const {
+    return width;
+}
+
+int VirtualTerminal::getHeight() const {
+    return height;
+}
+
+char VirtualTerminal::getChar(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return ' ';
+    }
+    return cells()[static_cast<size_t>(y) * width + x];
+}
+
+std::string VirtualTerminal::getRow(int y) const {
+    if (y < 0 || y >= height) {
+        return std::string();
+    }
+    const char* row = cells().data() + static_cast<size_t>(y) * width;
+    return std::string(row, row + width);
+}
+
+int VirtualTerminal::getCursorX() const {
+    return cursorX;
+}
+
+int VirtualTerminal::getCursorY() const {
+    return cursorY;
+}
+
+bool VirtualTerminal::isCursorVisible() const {
+    return cursorVisible;
+}
+
+bool VirtualTerminal::isAlternateScreen() const {
+    return alternate;
+}
+
+bool VirtualTerminal::isSynchronized() const {
+    return synchronized;
+}
+
+const TerminalStats& VirtualTerminal::getStats() const {
+    return stats;
+}
+
+void VirtualTerminal::resetStats() {
+    stats = TerminalStats();
+}
+
+std::vector<char>& VirtualTerminal::cells() {
+    return alternate ? alternateCells : mainCells;
+}
+
+const std::vector<char>& VirtualTerminal::cells() const {
+    return alternate ? alternateCells : mainCells;
+}
+
+void VirtualTerminal::print(char ch) {
+    if (wrapPending) {
+        cursorX = 0;
+        lineFeed();
+    }
+    
+    cells()[static_cast<size_t>(cursorY) * width + cursorX] = ch;
+    stats.printed++;
+    if (cursorX == width - 1) {
+        wrapPending = true;
+    } else {
+        cursorX++;
+    }
+}
+
+void VirtualTerminal::lineFeed() {
+    wrapPending = false;
+    if (cursorY < height - 1) {
+        cursorY++;
+        return;
+    }
+    
+    // Scroll everything up a line
+    std::vector<char>& screen = cells();
+    std::memmove(screen.data(), screen.data() + width, static_cast<size_t>(height - 1) * width);
+    eraseCells(0, height - 1, width);
+}
+
+void VirtualTerminal::moveTo(int x, int y) {
+    cursorX = std::max(0, std::min(x, width - 1));
+    cursorY = std::max(0, std::min(y, height - 1));
+    wrapPending = false;
+}
+
+void VirtualTerminal::eraseCells(int x, int y, int count) {
+    size_t start = static_cast<size_t>(y) * width + x;
+    std::fill(cells().begin() + start, cells().begin() + start + count, ' ');
+}
+
+void VirtualTerminal::executeCsi(char command) {
+    if (privateMode) {
+        if (command == 'h' || command == 'l') {
+            for (int i = 0; i < std::max(paramCount, 1); i++) {
+                setMode(params[i], command == 'h');
+            }
+        } else {
+            stats.unsupported++;
+        }
+        return;
+    }
+    
+    int mode = paramCount > 0 ? params[0] : 0;
+    switch (command) {
+        case 'H':
+        case 'f':
+            moveTo(getParam(1, 1) - 1, getParam(0, 1) - 1);
+            stats.cursorMoves++;
+            break;
+        case 'A':
+            moveTo(cursorX, cursorY - getParam(0, 1));
+            stats.cursorMoves++;
+            break;
+        case 'B':
+            moveTo(cursorX, cursorY + getParam(0, 1));
+            stats.cursorMoves++;
+            break;
+        case 'C':
+            moveTo(cursorX + getParam(0, 1), cursorY);
+            stats.cursorMoves++;
+            break;
+        case 'D':
+            moveTo(cursorX - getParam(0, 1), cursorY);
+            stats.cursorMoves++;
+            break;
+        case 'G':
+            moveTo(getParam(0, 1) - 1, cursorY);
+            stats.cursorMoves++;
+            break;
+        case 'd':
+            moveTo(cursorX, getParam(0, 1) - 1);
+            stats.cursorMoves++;
+            break;
+        case 'J':
+            // Below the cursor, above it, or the whole screen
+            stats.clears++;
+            if (mode == 0) {
+                eraseCells(cursorX, cursorY, width - cursorX);
+                for (int y = cursorY + 1; y < height; y++) {
+                    eraseCells(0, y, width);
+                }
+            } else if (mode == 1) {
+                for (int y = 0; y < cursorY; y++) {
+                    eraseCells(0, y, width);
+                }
+                eraseCells(0, cursorY, cursorX + 1);
+            } else if (mode == 2 || mode == 3) {
+                std::fill(cells().begin(), cells().end(), ' ');
+            } else {
+                stats.unsupported++;
+            }
+            break;
+        case 'K':
+            stats.clears++;
+            if (mode == 0) {
+                eraseCells(cursorX, cursorY, width - cursorX);
+            } else if (mode == 1) {
+                eraseCells(0, cursorY, cursorX + 1);
+            } else if (mode == 2) {
+                eraseCells(0, cursorY, width);
+            } else {
+                stats.unsupported++;
+            }
+            break;
+        case 'm':
+            // Colours and attributes are not kept
+            break;
+        default:
+            stats.unsupported++;
+            break;
+    }
+}
+
+void VirtualTerminal::setMode(int mode, bool on) {
+    switch (mode) {
+        case 25:
+            cursorVisible = on;
+            break;
+        case 1049:
+            // The cursor is saved on the way in and put back on the way out,
+            // and the alternate screen starts out blank
+            if (on && !alternate) {
+                savedX = cursorX;
+                savedY = cursorY;
+                alternate = true;
+                std::fill(alternateCells.begin(), alternateCells.end(), ' ');
+            } else if (!on && alternate) {
+                alternate = false;
+                moveTo(savedX, savedY);
+            }
+            break;
+        case 2026:
+            synchronized = on;
+            break;
+        default:
+            stats.unsupported++;
+            break;
+    }
+}
+
+int VirtualTerminal::getParam(int index, int defaultValue) const {
+    return index < paramCount && params[index] > 0 ? params[index] : defaultValue;
+}
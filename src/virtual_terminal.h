@@ -0,0 +1,99 @@
+#ifndef VIRTUAL_TERMINAL_H
+#define VIRTUAL_TERMINAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a stretch of terminal output cost
+struct TerminalStats {
+    uint64_t bytes;
+    uint64_t escapeSequences;
+    uint64_t cursorMoves;     // Absolute and relative cursor positioning
+    uint64_t printed;         // Characters written into cells
+    uint64_t clears;          // Erase-display and erase-line sequences
+    uint64_t unsupported;     // Sequences this terminal does not understand
+    
+    TerminalStats() : bytes(0), escapeSequences(0), cursorMoves(0), printed(0), clears(0), unsupported(0) {}
+};
+
+// A screen rebuilt from terminal output, without a terminal.
+//
+// Understands what the renderer and spectator broadcasts send (cursor
+// positioning, erasing, the alternate screen, synchronized output and
+// cursor visibility) plus the usual controls, and counts what each stretch
+// of output cost, so output size can be measured and the rebuilt screen
+// checked against what was meant to be shown. Colours and other attributes
+// are accepted and ignored; the screen holds characters only. Writing in
+// the last column wraps on the next character, as xterm does.
+class VirtualTerminal {
+public:
+    VirtualTerminal(int width, int height);
+    
+    // Keep the top-left of both screens, as a terminal window does
+    void resize(int width, int height);
+    
+    void feed(const char* data, size_t size);
+    void feed(const std::string& data);
+    
+    int getWidth() const;
+    int getHeight() const;
+    char getChar(int x, int y) const;
+    std::string getRow(int y) const;
+    
+    int getCursorX() const;
+    int getCursorY() const;
+    bool isCursorVisible() const;
+    bool isAlternateScreen() const;
+    
+    // Inside a synchronized update (between ?2026h and ?2026l)
+    bool isSynchronized() const;
+    
+    // Counts since the last resetStats()
+    const TerminalStats& getStats() const;
+    void resetStats();
+    
+private:
+    enum class ParseState {
+        GROUND,
+        ESCAPE,  // After ESC
+        CSI      // After ESC [
+    };
+    
+    static const int MAX_PARAMS = 16;
+    
+    int width;
+    int height;
+    std::vector<char> mainCells;
+    std::vector<char> alternateCells;
+    bool alternate;
+    int cursorX;
+    int cursorY;
+    bool wrapPending;  // The last column was just written
+    int savedX;
+    int savedY;
+    bool cursorVisible;
+    bool synchronized;
+    
+    ParseState state;
+    int params[MAX_PARAMS];
+    int paramCount;
+    bool privateMode;  // CSI ? ...
+    bool unknownForm;  // Parameters or markers this terminal does not take
+    
+    TerminalStats stats;
+    
+    std::vector<char>& cells();
+    const std::vector<char>& cells() const;
+    
+    void print(char ch);
+    void lineFeed();
+    void moveTo(int x, int y);
+    void eraseCells(int x, int y, int count);
+    void executeCsi(char command);
+    void setMode(int mode, bool on);
+    int getParam(int index, int defaultValue) const;
+};
+
+#endif // VIRTUAL_TERMINAL_H
@@ -0,0 +1,229 @@
+#include "world_grid.h"
+#include "utils.h"
+
+const int EMPTY_CELL_PROBES = 64;  // Random tries before scanning for an empty cell
+
+DamageList::DamageList(size_t maxCells)
+    : capacity(maxCells),
+      all(false) {
+    cells.reserve(capacity);
+}
+
+void DamageList::add(int x, int y) {
+    if (all) {
+        return;
+    }
+    if (cells.size() >= capacity) {
+        addAll();
+        return;
+    }
+    
+    GridPoint cell = {x, y};
+    cells.push_back(cell);
+}
+
+void DamageList::addAll() {
+    all = true;
+    cells.clear();
+}
+
+void DamageList::clear() {
+    all = false;
+    cells.clear();
+}
+
+bool DamageList::isAll() const {
+    return all;
+}
+
+const std::vector<GridPoint>& DamageList::getCells() const {
+    return cells;
+}
+
+WorldGrid::WorldGrid()
+    : cachedKey(0),
+      cachedChunk(nullptr),
+      damage(nullptr) {
+}
+
+CellType WorldGrid::get(int x, int y) const {
+    const Chunk* chunk = findChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+    
+    if (!chunk) {
+        return CellType::EMPTY;
+    }
+    
+    return typeOf(chunk->cells[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)]);
+}
+
+int WorldGrid::getOwner(int x, int y) const {
+    const Chunk* chunk = findChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+    
+    if (!chunk) {
+        return NO_OWNER;
+    }
+    
+    return ownerOf(chunk->cells[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)]);
+}
+
+void WorldGrid::set(int x, int y, CellType type) {
+    // Clearing a cell never needs a chunk
+    uint16_t* cell = cellFor(x, y, type != CellType::EMPTY);
+    
+    if (cell) {
+        write(cell, x, y, (type == CellType::OBSTACLE) ? OBSTACLE_VALUE : EMPTY_VALUE);
+    }
+}
+
+void WorldGrid::setSnake(int x, int y, int owner) {
+    write(cellFor(x, y, true), x, y, static_cast<uint16_t>(SNAKE_BASE + owner));
+}
+
+void WorldGrid::clearSnake(int x, int y, int owner) {
+    uint16_t* cell = cellFor(x, y, false);
+    
+    if (cell && *cell == SNAKE_BASE + owner) {
+        write(cell, x, y, EMPTY_VALUE);
+    }
+}
+
+int WorldGrid::getItem(int x, int y) const {
+    const Chunk* chunk = findChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+    
+    if (!chunk) {
+        return NO_ITEM;
+    }
+    
+    return itemOf(chunk->cells[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)]);
+}
+
+void WorldGrid::setItem(int x, int y, int slot) {
+    write(cellFor(x, y, true), x, y, static_cast<uint16_t>(ITEM_BASE + slot));
+}
+
+void WorldGrid::clearItem(int x, int y, int slot) {
+    uint16_t* cell = cellFor(x, y, false);
+    
+    if (cell && *cell == ITEM_BASE + slot) {
+        write(cell, x, y, EMPTY_VALUE);
+    }
+}
+
+void WorldGrid::clear() {
+    if (damage && !chunks.empty()) {
+        damage->addAll();
+    }
+    
+    chunks.clear();
+    cachedKey = 0;
+    cachedChunk = nullptr;
+}
+
+void WorldGrid::reserve(const GridRect& area) {
+    if (area.width <= 0 || area.height <= 0) {
+        return;
+    }
+    
+    for (int y = area.y >> CHUNK_SHIFT; y <= (area.y + area.height - 1) >> CHUNK_SHIFT; y++) {
+        for (int x = area.x >> CHUNK_SHIFT; x <= (area.x + area.width - 1) >> CHUNK_SHIFT; x++) {
+            cellFor(x << CHUNK_SHIFT, y << CHUNK_SHIFT, true);
+        }
+    }
+}
+
+void WorldGrid::setDamageList(DamageList* list) {
+    damage = list;
+}
+
+void WorldGrid::write(uint16_t* cell, int x, int y, uint16_t value) {
+    if (damage && *cell != value) {
+        damage->add(x, y);
+    }
+    *cell = value;
+}
+
+bool WorldGrid::findEmptyCell(const GridRect& area, GridPoint& cell) const {
+    if (area.width <= 0 || area.height <= 0) {
+        return false;
+    }
+    
+    for (int attempt = 0; attempt < EMPTY_CELL_PROBES; attempt++) {
+        int x = utils::randomInt(area.x, area.x + area.width - 1);
+        int y = utils::randomInt(area.y, area.y + area.height - 1);
+        if (get(x, y) == CellType::EMPTY) {
+            cell.x = x;
+            cell.y = y;
+            return true;
+        }
+    }
+    
+    // Row by row from a random cell, wrapping around to the top
+    int64_t cells = static_cast<int64_t>(area.width) * area.height;
+    int64_t start = static_cast<int64_t>(utils::randomInt(0, area.height - 1)) * area.width +
+                    utils::randomInt(0, area.width - 1);
+    for (int64_t i = 0; i < cells; i++) {
+        int64_t index = (start + i) % cells;
+        int x = area.x + static_cast<int>(index % area.width);
+        int y = area.y + static_cast<int>(index / area.width);
+        if (get(x, y) == CellType::EMPTY) {
+            cell.x = x;
+            cell.y = y;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t WorldGrid::getChunkCount() const {
+    return chunks.size();
+}
+
+size_t WorldGrid::getMemoryUsage() const {
+    return chunks.size() * sizeof(Chunk);
+}
+
+uint16_t* WorldGrid::cellFor(int x, int y, bool allocate) {
+    int chunkX = x >> CHUNK_SHIFT;
+    int chunkY = y >> CHUNK_SHIFT;
+    Chunk* chunk = findChunk(chunkX, chunkY);
+    
+    if (!chunk) {
+        if (!allocate) {
+            return nullptr;
+        }
+        
+        // Value-initialised, so every cell starts out empty
+        chunk = new Chunk();
+        
+        uint64_t key = chunkKey(chunkX, chunkY);
+        chunks[key].reset(chunk);
+        cachedKey = key;
+        cachedChunk = chunk;
+    }
+    
+    return &chunk->cells[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)];
+}
+
+uint64_t WorldGrid::chunkKey(int chunkX, int chunkY) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(chunkY)) << 32) |
+           static_cast<uint32_t>(chunkX);
+}
+
+WorldGrid::Chunk* WorldGrid::findChunk(int chunkX, int chunkY) const {
+    uint64_t key = chunkKey(chunkX, chunkY);
+    
+    if (cachedChunk && key == cachedKey) {
+        return cachedChunk;
+    }
+    
+    auto it = chunks.find(key);
+    Chunk* chunk = (it != chunks.end()) ? it->second.get() : nullptr;
+    
+    // Only cache hits so a later allocation of this chunk is not shadowed
+    if (chunk) {
+        cachedKey = key;
+        cachedChunk = chunk;
+    }
+    
+    return chunk;
+}
@@ -0,0 +1,186 @@
+#ifndef WORLD_GRID_H
+#define WORLD_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// What occupies a cell of the world
+enum class CellType {
+    EMPTY = 0,
+    OBSTACLE,
+    SNAKE,
+    ITEM
+};
+
+struct GridRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+struct GridPoint {
+    int x;
+    int y;
+};
+
+// Cells that changed since the list was last cleared, so a picture of the
+// world can be brought up to date by redrawing just those. Past its
+// capacity the list stops recording single cells and only notes that
+// anything may have changed, as after a new level.
+class DamageList {
+public:
+    static const size_t DEFAULT_CAPACITY = 1024;
+    
+    explicit DamageList(size_t capacity = DEFAULT_CAPACITY);
+    
+    void add(int x, int y);
+    void addAll();
+    void clear();
+    
+    // True if the cells are not all known and everything must be redrawn
+    bool isAll() const;
+    const std::vector<GridPoint>& getCells() const;
+    
+private:
+    std::vector<GridPoint> cells;  // Reserved up front; never grows
+    size_t capacity;
+    bool all;
+};
+
+// Sparse grid for worlds much larger than the screen.
+//
+// Cells are stored in fixed-size square chunks that are only allocated the
+// first time a non-empty value is written to them, so memory grows with the
+// area the game has actually touched rather than with the world size. Reads
+// from untouched chunks return CellType::EMPTY.
+//
+// Snake cells also record which snake owns them, so several snakes can share
+// one grid and tell their own body from someone else's in a single lookup.
+// Item cells likewise record the item's slot in its pool, so whatever is
+// lying on a cell is found without searching the pool.
+class WorldGrid {
+public:
+    static const int CHUNK_SHIFT = 6;
+    static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;  // 64x64 cells per chunk
+    static const int CHUNK_MASK = CHUNK_SIZE - 1;
+    
+    WorldGrid();
+    
+    static const int NO_OWNER = -1;
+    static const int NO_ITEM = -1;
+    static const int MAX_ITEMS = 0x4000;  // Item slots that fit in a cell
+    
+    CellType get(int x, int y) const;
+    
+    // Owner id of a snake cell, or NO_OWNER for anything else
+    int getOwner(int x, int y) const;
+    
+    // Set a cell to EMPTY or OBSTACLE
+    void set(int x, int y, CellType type);
+    
+    // Mark a cell as part of snake `owner`, or clear it if `owner` still holds it
+    void setSnake(int x, int y, int owner);
+    void clearSnake(int x, int y, int owner);
+    
+    // Pool slot of the item in a cell, or NO_ITEM for anything else
+    int getItem(int x, int y) const;
+    
+    // Mark a cell as holding item `slot`, or clear it if it still holds it
+    void setItem(int x, int y, int slot);
+    void clearItem(int x, int y, int slot);
+    
+    // Release every chunk
+    void clear();
+    
+    // Allocate every chunk overlapping `area` now, so writes inside it never
+    // allocate later
+    void reserve(const GridRect& area);
+    
+    // A random empty cell inside `area`, or false if there is none. Random
+    // probes find one quickly on an open board; a nearly full area falls
+    // back to checking each cell once from a random starting point.
+    bool findEmptyCell(const GridRect& area, GridPoint& cell) const;
+    
+    // Note every cell whose contents change in `damage` (not owned), or
+    // stop noting changes if it is null
+    void setDamageList(DamageList* damage);
+    
+    size_t getChunkCount() const;
+    size_t getMemoryUsage() const;
+    
+    // Call fn(x, y, type, owner) for every non-empty cell inside `rect`. Cost
+    // depends on the rectangle's area, never on how big the world is.
+    template <typename Fn>
+    void forEachInRect(const GridRect& rect, Fn fn) const {
+        for (int y = rect.y; y < rect.y + rect.height; y++) {
+            int x = rect.x;
+            int endX = rect.x + rect.width;
+            
+            while (x < endX) {
+                // Walk the row one chunk-wide span at a time
+                int spanEnd = ((x >> CHUNK_SHIFT) + 1) << CHUNK_SHIFT;
+                if (spanEnd > endX) {
+                    spanEnd = endX;
+                }
+                
+                const Chunk* chunk = findChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+                if (chunk) {
+                    const uint16_t* row = &chunk->cells[(y & CHUNK_MASK) << CHUNK_SHIFT];
+                    for (int cx = x; cx < spanEnd; cx++) {
+                        uint16_t value = row[cx & CHUNK_MASK];
+                        if (value != EMPTY_VALUE) {
+                            fn(cx, y, typeOf(value), ownerOf(value));
+                        }
+                    }
+                }
+                
+                x = spanEnd;
+            }
+        }
+    }
+    
+private:
+    // Cell encoding: 0 empty, 1 obstacle, SNAKE_BASE + owner for snakes,
+    // ITEM_BASE + slot for items
+    static const uint16_t EMPTY_VALUE = 0;
+    static const uint16_t OBSTACLE_VALUE = 1;
+    static const uint16_t SNAKE_BASE = 2;
+    static const uint16_t ITEM_BASE = 0x10000 - MAX_ITEMS;
+    
+    struct Chunk {
+        uint16_t cells[CHUNK_SIZE * CHUNK_SIZE];
+    };
+    
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> chunks;
+    
+    // One-entry lookup cache; consecutive accesses are usually in one chunk
+    mutable uint64_t cachedKey;
+    mutable Chunk* cachedChunk;
+    
+    DamageList* damage;
+    
+    static uint64_t chunkKey(int chunkX, int chunkY);
+    Chunk* findChunk(int chunkX, int chunkY) const;
+    uint16_t* cellFor(int x, int y, bool allocate);
+    void write(uint16_t* cell, int x, int y, uint16_t value);
+    
+    static CellType typeOf(uint16_t value) {
+        return value == EMPTY_VALUE ? CellType::EMPTY :
+               value == OBSTACLE_VALUE ? CellType::OBSTACLE :
+               value >= ITEM_BASE ? CellType::ITEM : CellType::SNAKE;
+    }
+    
+    static int ownerOf(uint16_t value) {
+        return value >= SNAKE_BASE && value < ITEM_BASE ? value - SNAKE_BASE : NO_OWNER;
+    }
+    
+    static int itemOf(uint16_t value) {
+        return value >= ITEM_BASE ? value - ITEM_BASE : NO_ITEM;
+    }
+};
+
+#endif // WORLD_GRID_H
@@ -0,0 +1,52 @@
+#include "world_view.h"
+#include <algorithm>
+#include <cstring>
+
+void drawWorldView(Renderer& renderer, const WorldGrid& world,
+                   int worldWidth, int worldHeight, const std::vector<char>& ownerChars) {
+    const int width = renderer.getWidth();
+    const int height = renderer.getHeight();
+    const int viewX = renderer.getViewX();
+    const int viewY = renderer.getViewY();
+    const int ownerCount = static_cast<int>(ownerChars.size());
+    
+    // Screen columns the world covers, for the top and bottom edges
+    const int edgeBegin = std::max(-viewX, 0);
+    const int edgeEnd = std::min(worldWidth - viewX, width);
+    
+    // Screen columns of the left and right edges, if they are on screen
+    const int left = -viewX;
+    const int right = worldWidth - 1 - viewX;
+    const bool leftShown = left >= 0 && left < width;
+    const bool rightShown = right >= 0 && right < width;
+    
+    for (int y = 0; y < height; y++) {
+        char* row = renderer.getDrawingRow(y);
+        std::memset(row, ' ', width);
+        
+        int worldY = viewY + y;
+        if (worldY < 0 || worldY >= worldHeight) {
+            continue;
+        }
+        
+        bool edgeRow = worldY == 0 || worldY == worldHeight - 1;
+        if (edgeRow && edgeBegin < edgeEnd) {
+            std::memset(row + edgeBegin, '-', edgeEnd - edgeBegin);
+        }
+        if (leftShown) {
+            row[left] = edgeRow ? '+' : '|';
+        }
+        if (rightShown) {
+            row[right] = edgeRow ? '+' : '|';
+        }
+        
+        GridRect span = {viewX, worldY, width, 1};
+        world.forEachInRect(span, [&](int x, int, CellType type, int owner) {
+            char ch = type == CellType::OBSTACLE ? '#' :
+                      owner >= 0 && owner < ownerCount ? ownerChars[owner] : 0;
+            if (ch) {
+                row[x - viewX] = ch;
+            }
+        });
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef WORLD_VIEW_H
+#define WORLD_VIEW_H
+
+#include "renderer.h"
+#include "world_grid.h"
+#include <vector>
+
+// Draw the part of the world under the renderer's viewport into whatever
+// the renderer is drawing to, as Game keeps it in the background layer: the
+// world's border, obstacles as '#' and snake bodies as ownerChars[owner],
+// or nothing for an owner whose character is 0. Items pulse, so they are
+// left for drawing over the layer each frame.
+//
+// The screen is filled a row at a time straight into the renderer's
+// cells, with no per-cell call or bounds check.
+void drawWorldView(Renderer& renderer, const WorldGrid& world,
+                   int worldWidth, int worldHeight, const std::vector<char>& ownerChars);
+
+#endif // WORLD_VIEW_H